@@ -22,64 +22,183 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor Boston, MA 02110-1301,  USA
  */
 
+
 #include "clipboard.h"
 #include "cv_drawing.h"
 #include "selection.h"
 
+/* a paste still waiting after this many ms shows the busy cursor */
+#define BUSY_DELAY	150
+
+/* What was copied. The canvas is only copied server side, it is read
+ * back (and encoded by GTK) when somebody asks for it. */
+typedef struct {
+	GdkPixmap	*pixmap;
+	GdkPixbuf	*pixbuf;
+} ClipData;
+
+typedef struct {
+	gboolean	pending;
+	guint		busy_id;	/* timeout until the busy cursor      */
+	gboolean	busy;		/* the busy cursor is on              */
+} PasteData;
+
+static PasteData m_paste = { FALSE, 0, FALSE };
+
+/* what we offer while we own the clipboard, NULL once someone else does */
+static ClipData *m_owned = NULL;
+
+static void paste_pixbuf ( GdkPixbuf *pixbuf );
+
+static GdkPixbuf *
+clip_data_get_pixbuf ( ClipData *data )
+{
+	if ( data->pixbuf == NULL && data->pixmap != NULL )
+	{
+		gint w, h;
+
+		gdk_drawable_get_size ( data->pixmap, &w, &h );
+		data->pixbuf = gdk_pixbuf_get_from_drawable ( NULL, data->pixmap,
+		                                              gdk_drawable_get_colormap (data->pixmap),
+		                                              0, 0, 0, 0, w, h );
+		g_object_unref ( data->pixmap );
+		data->pixmap = NULL;
+		/*with alpha, our own pastes share it as it is*/
+		if ( data->pixbuf != NULL && !gdk_pixbuf_get_has_alpha ( data->pixbuf ) )
+		{
+			GdkPixbuf *rgba = gdk_pixbuf_add_alpha ( data->pixbuf, FALSE, 0, 0, 0 );
+			g_object_unref ( data->pixbuf );
+			data->pixbuf = rgba;
+		}
+	}
+	return data->pixbuf;
+}
+
+static void
+clipboard_get ( GtkClipboard *clipboard, GtkSelectionData *selection_data,
+                guint info, gpointer user_data )
+{
+	GdkPixbuf *pixbuf = clip_data_get_pixbuf ( user_data );
+
+	if ( GDK_IS_PIXBUF ( pixbuf ) )
+	{
+		gtk_selection_data_set_pixbuf ( selection_data, pixbuf );
+	}
+}
+
+static void
+clipboard_clear ( GtkClipboard *clipboard, gpointer user_data )
+{
+	ClipData *data = user_data;
+
+	if ( m_owned == data ) m_owned = NULL;
+	if ( data->pixmap != NULL ) g_object_unref ( data->pixmap );
+	if ( data->pixbuf != NULL ) g_object_unref ( data->pixbuf );
+	g_slice_free ( ClipData, data );
+}
+
 void 
 on_menu_copy_activate ( GtkMenuItem *menuitem, gpointer user_data )
 {
-    GdkPixbuf       *pixbuf;
     GtkClipboard    *clipboard;
-//    gp_canvas *cv = cv_get_canvas ();
+    GtkTargetList   *list;
+    GtkTargetEntry  *targets;
+    gint            n_targets;
+    ClipData        *data;
+    gp_canvas *cv = cv_get_canvas ();
 
     clipboard   =   gtk_clipboard_get_for_display (gdk_display_get_default (),
 	                                             GDK_SELECTION_CLIPBOARD);
 
     g_return_if_fail ( GTK_IS_CLIPBOARD(clipboard) );
 
+    data = g_slice_new0 (ClipData);
     if(gp_selection_query())
     {
-    	pixbuf = GDK_PIXBUF(gp_selection_get_pixbuf());
+    	data->pixbuf = GDK_PIXBUF(gp_selection_get_pixbuf());
     }
     else
     {
-	    pixbuf = cv_get_pixbuf ();
+    	GdkGC *gc;
+    	gint w, h;
+
+    	/* the canvas goes on changing: keep what it is now */
+    	gdk_drawable_get_size (cv->pixmap, &w, &h);
+    	data->pixmap = gdk_pixmap_new (cv->pixmap, w, h, -1);
+    	gdk_drawable_set_colormap (data->pixmap, gdk_drawable_get_colormap (cv->pixmap));
+    	gc = gdk_gc_new (data->pixmap);
+    	gdk_draw_drawable (data->pixmap, gc, cv->pixmap, 0, 0, 0, 0, w, h);
+    	g_object_unref (gc);
 	}
 
-    gtk_clipboard_set_image ( clipboard, pixbuf );
+    list = gtk_target_list_new (NULL, 0);
+    gtk_target_list_add_image_targets (list, 0, TRUE);
+    targets = gtk_target_table_new_from_list (list, &n_targets);
+    if ( gtk_clipboard_set_with_data ( clipboard, targets, n_targets,
+                                       clipboard_get, clipboard_clear, data ) )
+    {
+    	/* a clipboard manager may take it over when we quit */
+    	gtk_clipboard_set_can_store ( clipboard, NULL, 0 );
+    	m_owned = data;
+    }
+    else
+    {
+    	clipboard_clear ( clipboard, data );
+    }
+    gtk_target_table_free (targets, n_targets);
+    gtk_target_list_unref (list);
+}
+
+static gboolean
+paste_busy ( gpointer user_data )
+{
+	gp_canvas *cv = cv_get_canvas ();
+	GdkCursor *cursor = gdk_cursor_new ( GDK_WATCH );
+
+	gdk_window_set_cursor ( cv->toplevel->window, cursor );
+	gdk_cursor_unref ( cursor );
+	m_paste.busy_id = 0;
+	m_paste.busy = TRUE;
+	return FALSE;
+}
+
+static void
+paste_received ( GtkClipboard *clipboard, GdkPixbuf *pixbuf, gpointer user_data )
+{
+    gp_canvas *cv = cv_get_canvas ();
 
-    g_object_unref(pixbuf);
+    m_paste.pending = FALSE;
+    if ( m_paste.busy_id != 0 )
+    {
+    	g_source_remove ( m_paste.busy_id );
+    	m_paste.busy_id = 0;
+    }
+    if ( m_paste.busy )
+    {
+    	gdk_window_set_cursor ( cv->toplevel->window, NULL );
+    	m_paste.busy = FALSE;
+    }
+
+    g_return_if_fail ( GDK_IS_PIXBUF(pixbuf) );
+    paste_pixbuf ( pixbuf );
 }
 
-void 
-on_menu_paste_activate ( GtkMenuItem *menuitem, gpointer user_data )
+static void
+paste_pixbuf ( GdkPixbuf *pixbuf )
 {
-    GtkClipboard    *clipboard;
     gp_canvas *cv = cv_get_canvas ();
     GtkWidget *wid;
-    GdkPixbuf *tmp;
 
-    clipboard = gtk_clipboard_get_for_display (gdk_display_get_default (),
-	                                             GDK_SELECTION_CLIPBOARD);
-    
-    tmp = gtk_clipboard_wait_for_image ( clipboard );
-    
-    g_return_if_fail ( GDK_IS_PIXBUF(tmp) );
-    
 	/* Delete old selection if any */
     if(GDK_IS_PIXBUF ( cv->pb_clipboard ) )
     {
     	g_object_unref(cv->pb_clipboard);
     }
 
-    if(!gdk_pixbuf_get_has_alpha(tmp)){
-	    cv->pb_clipboard = gdk_pixbuf_add_alpha(tmp, FALSE, 0, 0, 0);
-	    g_object_unref(tmp);
-	}
-	else{
-		cv->pb_clipboard = tmp;
-	}
+    /* The selection adopts the pixels as they are, alpha is only
+     * added by the image if they have none. Whoever handed them over
+     * keeps its own reference. */
+	cv->pb_clipboard = g_object_ref (pixbuf);
     
     wid = GTK_WIDGET(g_object_get_data(G_OBJECT(cv->widget), "tool-rect-select"));
     /* The rect sel tool is not active, toggle it
@@ -102,5 +221,28 @@ on_menu_paste_activate ( GtkMenuItem *menuitem, gpointer user_data )
 		g_object_unref(cv->pb_clipboard);
 		cv->pb_clipboard = NULL;
 	}
+}
+
+void 
+on_menu_paste_activate ( GtkMenuItem *menuitem, gpointer user_data )
+{
+    GtkClipboard    *clipboard;
+
+    /* one at a time, the last one is still on its way */
+    if ( m_paste.pending ) return;
+
+    clipboard = gtk_clipboard_get_for_display (gdk_display_get_default (),
+	                                             GDK_SELECTION_CLIPBOARD);
+
+    if ( m_owned != NULL && clip_data_get_pixbuf ( m_owned ) != NULL )
+    {
+    	/* our own copy: share the pixels, no selection round trip */
+    	paste_pixbuf ( m_owned->pixbuf );
+    	return;
+    }
 
+    m_paste.pending = TRUE;
+    m_paste.busy_id = g_timeout_add ( BUSY_DELAY, paste_busy, NULL );
+    /* the main loop keeps running while the owner converts the image */
+    gtk_clipboard_request_image ( clipboard, paste_received, NULL );
 }
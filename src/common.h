@@ -57,8 +57,11 @@ typedef struct
 	GdkGC *			gc_bg_pencil;
 	gp_filled		filled;
 	gint			line_width;
+	GdkCapStyle		line_cap;
+	GdkJoinStyle	line_join;
 	gboolean		transparent;
 	GdkPixbuf		*pb_clipboard;
+	GdkRegion		*expose;		/* being repainted, NULL outside expose */
 } gp_canvas;
 
 /* Tool Type*/
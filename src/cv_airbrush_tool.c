@@ -23,14 +23,13 @@
 #endif
 */
 #include <gtk/gtk.h>
-#include <stdlib.h>
-#include <time.h>
 
 #include "cv_airbrush_tool.h"
 #include "gp_point_array.h"
 #include "undo.h"
 #include "file.h"
 #include "toolbar.h"
+#include "gp_stroke.h"
 
 
 /* mspaint's airbrushes widths are 25, 17, 9 */
@@ -43,14 +42,19 @@
  */
 #define NTIMES	10
 
-/* Get a random number from 0 to N. Thanks c-faq! */
-#define get_rnum(N) ((int)((double)rand() / ((double)(RAND_MAX)+(1))*(N)))
+/* Spray tick, about one frame. The number of dots per tick comes
+ * from the flow rate and the real elapsed time, not from the tick. */
+#define SPRAY_TICK		16
+#define SPRAY_MAX_DOTS	4096
 
-static void draw_airbrush(GdkDrawable *drawable);
-static gboolean timer_func(gpointer data);
-static gint pt_in_circle(gint center_x, gint center_y, gint radius, gint x, gint y);
+/* dots per second, mspaint sprays about NTIMES every 125 ms */
+static gint g_spray_flow = 80;
 
-static GdkPixmap *copy_pixmap(GdkPixmap *pixmap);
+static void spray(GdkDrawable *drawable, gint n);
+static void spray_tick(void);
+static void stop_timer(void);
+static gboolean timer_func(gpointer data);
+static inline guint32 spray_rand(void);
 
 /*Member functions*/
 static gboolean	button_press	( GdkEventButton *event );
@@ -59,7 +63,6 @@ static gboolean	button_motion	( GdkEventMotion *event );
 static void		draw			( void );
 static void		reset			( void );
 static void		destroy			( gpointer data  );
-static void		draw_in_pixmap	( GdkDrawable *drawable );
 static void     save_undo       ( void );
 
 
@@ -71,11 +74,14 @@ typedef struct {
     guint			button;
 	gboolean 		is_draw;
     GdkPoint		pt;		/* Location of mouse */
-    gboolean		ret;	/* Variable to control timer function */
+    guint			timer_id;	/* spray tick source */
+    GTimer *		timer;	/* time since the last tick */
+    gdouble			pending;	/* fraction of a dot left from the last tick */
+    guint32			seed;	/* xorshift state */
+    GdkPoint *		dots;	/* SPRAY_MAX_DOTS */
 	gint			diam;	/* Diameter of brush circle */
     gint			rad;	/* Radius of brush circle */
-    gint			x_min,y_min,x_max,y_max;
-    GdkPixmap *		pixmap;
+    gp_stroke *		backup;	/* canvas tiles under the stroke */
 } private_data;
 
 static private_data		*m_priv = NULL;
@@ -92,18 +98,19 @@ create_private_data( void )
         m_priv->is_draw	=	FALSE;
 		m_priv->diam	=	DIAMETER;
 		m_priv->rad		=	RADIUS;
+		m_priv->timer	=	g_timer_new ();
+		m_priv->seed	=	g_random_int () | 1;
+		m_priv->dots	=	g_new (GdkPoint, SPRAY_MAX_DOTS);
 	}
 }
 
 static void
 destroy_private_data( void )
 {
-    if(GDK_IS_PIXMAP(m_priv->pixmap))
-	{
-		g_object_unref(m_priv->pixmap);
-		m_priv->pixmap = NULL;
-	}
-
+    stop_timer();
+    gp_stroke_free(m_priv->backup);
+    g_timer_destroy(m_priv->timer);
+    g_free(m_priv->dots);
     g_free (m_priv);
 	m_priv = NULL;
 }
@@ -146,23 +153,17 @@ button_press ( GdkEventButton *event )
 		/* Offset so we draw right under mouse pointer */
 		m_priv->pt.x -= m_priv->rad;
 		m_priv->pt.y -= m_priv->rad;
-		
-		m_priv->x_min = m_priv->x_max = m_priv->pt.x;
-		m_priv->y_min = m_priv->y_max = m_priv->pt.y;
-		
-		if(GDK_IS_PIXMAP(m_priv->pixmap))
-		{
-			g_object_unref(m_priv->pixmap);
-			m_priv->pixmap = NULL;
-		}
 
-		/* Copy pixbuf before changes */
-		m_priv->pixmap = copy_pixmap(m_priv->cv->pixmap);
+		/* Canvas tiles are backed up as the spray reaches them */
+		gp_stroke_free(m_priv->backup);
+		m_priv->backup = gp_stroke_new(m_priv->cv);
 
-		draw_airbrush(m_priv->cv->pixmap);
-	
-		m_priv->ret = TRUE;
-		g_timeout_add(125, timer_func, NULL);
+		spray(m_priv->cv->pixmap, NTIMES);
+
+		stop_timer();
+		m_priv->pending = 0.0;
+		g_timer_start(m_priv->timer);
+		m_priv->timer_id = g_timeout_add(SPRAY_TICK, timer_func, NULL);
 		
 		//printf("airbrush button_press\n");
 
@@ -174,16 +175,17 @@ button_press ( GdkEventButton *event )
 static gboolean
 button_release ( GdkEventButton *event )
 {
-	/* Kill the timer */
-	m_priv->ret = FALSE;
-	
+	gboolean spraying = m_priv->timer_id != 0;
+	stop_timer();
+
 	if ( event->type == GDK_BUTTON_RELEASE )
 	{
 		if( m_priv->button == event->button )
 		{
 			if( m_priv->is_draw )
 			{
-				draw_in_pixmap (m_priv->cv->pixmap);
+				/* Spray what is due since the last tick */
+				if (spraying) spray_tick();
                 save_undo ();
 				file_set_unsave ();
 			}
@@ -220,8 +222,6 @@ button_motion ( GdkEventMotion *event )
 		/* Offset so we draw right under mouse pointer */
 		m_priv->pt.x -= m_priv->rad;
 		m_priv->pt.y -= m_priv->rad;
-		
-        gtk_widget_queue_draw ( m_priv->cv->widget );
 	}
 	return TRUE;
 }
@@ -229,10 +229,7 @@ button_motion ( GdkEventMotion *event )
 static void	
 draw ( void )
 {
-	if ( m_priv->is_draw )
-	{
-		draw_in_pixmap (m_priv->cv->pixmap);
-	}
+	/* The spray goes straight to the canvas pixmap on each tick */
 }
 
 
@@ -267,104 +264,88 @@ destroy ( gpointer data  )
 	g_print("airbrush tool destroy\n");
 }
 
-static void
-draw_in_pixmap ( GdkDrawable *drawable )
+/* xorshift32, plenty for placing dots and much cheaper than rand() */
+static inline guint32 spray_rand(void)
 {
-	draw_airbrush(drawable);
-	//printf("draw_in_pixmap ");
+	guint32 x = m_priv->seed;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return m_priv->seed = x;
 }
 
-static void draw_airbrush(GdkDrawable *drawable)
+/* Throw n dots at the square under the brush, keep the ones inside
+ * the circle and send them in one request. */
+static void spray(GdkDrawable *drawable, gint n)
 {
-	gint x, y, i;
-
-	if (m_priv->pt.x <= m_priv->x_min)
-		m_priv->x_min = m_priv->pt.x;
-	if (m_priv->pt.x > m_priv->x_max)
-		m_priv->x_max = m_priv->pt.x;
-	if (m_priv->pt.y <= m_priv->y_min)
-		m_priv->y_min = m_priv->pt.y;
-	if (m_priv->pt.y > m_priv->y_max)
-		m_priv->y_max = m_priv->pt.y;
-	
-	for(i = 0; i < NTIMES; i++)
+	GdkPoint *dots = m_priv->dots;
+	gint diam = m_priv->diam;
+	gint rad = m_priv->rad;
+	gint r2 = rad * rad;
+	gint count = 0;
+
+	if (n > SPRAY_MAX_DOTS) n = SPRAY_MAX_DOTS;
+	while (n-- > 0)
 	{
-		x = m_priv->pt.x + get_rnum(m_priv->diam);
-		y = m_priv->pt.y + get_rnum(m_priv->diam);
-
-		if(pt_in_circle(m_priv->pt.x + m_priv->rad,
-						m_priv->pt.y + m_priv->rad ,
-						m_priv->rad, x, y))
+		/* one random word gives both coordinates in [0, diam) */
+		guint32 r = spray_rand();
+		gint dx = (gint)(((r >> 16) * (guint32)diam) >> 16);
+		gint dy = (gint)(((r & 0xffff) * (guint32)diam) >> 16);
+		gint cx = dx - rad;
+		gint cy = dy - rad;
+
+		if (cx * cx + cy * cy <= r2)
 		{
-			gdk_draw_line(drawable, m_priv->gc, x, y, x, y);
+			dots[count].x = m_priv->pt.x + dx;
+			dots[count].y = m_priv->pt.y + dy;
+			count++;
 		}
 	}
+	if (count == 0) return;
+
+	gp_stroke_touch(m_priv->backup, m_priv->pt.x, m_priv->pt.y, diam, diam);
+	gdk_draw_points(drawable, m_priv->gc, dots, count);
+	gtk_widget_queue_draw_area(m_priv->cv->widget, m_priv->pt.x, m_priv->pt.y,
+	                           diam, diam);
 }
 
-static gboolean timer_func(gpointer data)
+static void spray_tick(void)
 {
-	/* Kill it before it draws anything else */
-	if(!m_priv->ret)
-	{
-		//printf("Debug: timer_func ");
-		return m_priv->ret;
-	}
-	
-	draw_airbrush(m_priv->cv->pixmap);
-	gtk_widget_queue_draw ( m_priv->cv->widget );
-	//printf("Debug: timer_func ");
+	gint n;
 
-	return m_priv->ret;
+	m_priv->pending += g_timer_elapsed(m_priv->timer, NULL) * g_spray_flow;
+	g_timer_start(m_priv->timer);
+	n = (gint)m_priv->pending;
+	m_priv->pending -= n;
+	spray(m_priv->cv->pixmap, n);
 }
 
-/* Test to see if a point is within a circle */
-static gint pt_in_circle(gint center_x, gint center_y, gint radius, gint x, gint y)
+static void stop_timer(void)
 {
-	gint square_dist;
+	if (m_priv->timer_id != 0)
+	{
+		g_source_remove(m_priv->timer_id);
+		m_priv->timer_id = 0;
+	}
+}
 
-	square_dist = ((center_x - x) * (center_x - x)) + ((center_y - y) * (center_y - y));
-	return square_dist <= (radius * radius);
+static gboolean timer_func(gpointer data)
+{
+	spray_tick();
+	return TRUE;
 }
 
 static void     
 save_undo ( void )
 {
-	gint w,h;
-	GdkRectangle rect;
-	
-	rect.x		=	m_priv->x_min;
-	rect.y		=	m_priv->y_min;
-	rect.width	=	m_priv->x_max - m_priv->x_min + m_priv->diam;
-	rect.height	=	m_priv->y_max - m_priv->y_min + m_priv->diam;
-
-	if (rect.x<0) rect.x = 0;
-	if (rect.y<0) rect.y = 0;
-	gdk_drawable_get_size ( m_priv->cv->pixmap, &w, &h );
-	if (rect.width>w) rect.width=w;
-	if (rect.height>h) rect.height=h;
-    
-    undo_add ( &rect, NULL, m_priv->pixmap, TOOL_AIRBRUSH);
-    
+    gp_stroke_save_undo ( m_priv->backup, TOOL_AIRBRUSH );
+    gp_stroke_free ( m_priv->backup );
+    m_priv->backup = NULL;
 	
 	g_print ("save_undo\n");
 }
 
-static GdkPixmap *copy_pixmap(GdkPixmap *pixmap)
+void on_spray_flow_value_changed(GtkRange *range, gpointer data)
 {
-	GdkPixmap *pixmap_copy = NULL;
-	gint w, h;
-
-	if(!GDK_IS_PIXMAP(pixmap)){
-		return NULL;
-	}
-	
-	gdk_drawable_get_size(GDK_DRAWABLE( pixmap ), &w, &h);
-	pixmap_copy = gdk_pixmap_new(GDK_DRAWABLE( pixmap ), w, h, -1);
-	gdk_draw_drawable (	pixmap_copy,
-		            	m_priv->cv->gc_fg,
-			            pixmap,
-			            0, 0,
-			            0, 0,
-			            w, h );
-	return pixmap_copy;
+	g_spray_flow = (gint)gtk_range_get_value(range);
 }
@@ -7,4 +7,7 @@
 
 gp_tool * tool_airbrush_init( gp_canvas * canvas );
 
+/* GUI CallBack */
+void on_spray_flow_value_changed(GtkRange *range, gpointer data);
+
 #endif
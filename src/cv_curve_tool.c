@@ -21,18 +21,22 @@
  #include <gtk/gtk.h>
 
 #include "cv_curve_tool.h"
+#include "cv_drawing.h"
 #include "file.h"
 #include "undo.h"
-#include "gp_point_array.h"
+#include "gp_shape.h"
+#include "gp_dab.h"
 
+/*
+ * A curve takes three drags: the first one lays the straight line
+ * between the end points, the next two place the control points.
+ */
 typedef enum{
 	GP_CURVE_DO_LINE,
 	GP_CURVE_DO_CURVE,
 	GP_CURVE_SET
 }GPCurveAction;
 
-void draw_bezier(GdkDrawable *drawable, GdkGC *gc, GdkPoint pt1, GdkPoint pt2, GdkPoint pt3);
-
 /*Member functions*/
 static gboolean	button_press	( GdkEventButton *event );
 static gboolean	button_release	( GdkEventButton *event );
@@ -40,8 +44,10 @@ static gboolean	button_motion	( GdkEventMotion *event );
 static void		draw			( void );
 static void		reset			( void );
 static void		destroy			( gpointer data  );
-static void		draw_in_pixmap	( GdkDrawable *drawable );
+static void		draw_in_pixmap	( GdkDrawable *drawable, GdkRegion *area );
 static void     save_undo       ( void );
+static void     update_shape    ( void );
+static void     set_point       ( gdouble x, gdouble y );
 
 
 /*private data*/
@@ -52,8 +58,10 @@ typedef struct {
 	GdkGC *			gcb;
 	guint			button;
 	gboolean 		is_draw;
-	GdkPoint		start, crv, end;
+	GdkPoint		start, c1, c2, end;
 	gint			action;
+	gp_span_list	*outline;
+	GdkRegion		*preview;
 } private_data;
 
 static private_data		*m_priv = NULL;
@@ -70,12 +78,15 @@ create_private_data( void )
 		m_priv->button	=	NONE_BUTTON;
 		m_priv->is_draw	=	FALSE;
         m_priv->action	=	GP_CURVE_DO_LINE;
+		m_priv->outline	=	gp_span_list_new ();
 	}
 }
 
 static void
 destroy_private_data( void )
 {
+	gp_span_list_free ( m_priv->outline );
+	if ( m_priv->preview != NULL ) gdk_region_destroy ( m_priv->preview );
 	g_free (m_priv);
 	m_priv = NULL;
 }
@@ -110,26 +121,22 @@ button_press ( GdkEventButton *event )
 			m_priv->gcb = m_priv->cv->gc_fg;
 		}
 		m_priv->is_draw = !m_priv->is_draw;
-		if( m_priv->is_draw ) m_priv->button = event->button;
-
-        switch(m_priv->action){
-        	case GP_CURVE_DO_LINE:
-        		m_priv->start.x = (gint)event->x;
-        		m_priv->start.y = (gint)event->y;
-        		m_priv->end = m_priv->start;
-				break;
-			case GP_CURVE_DO_CURVE:
-				m_priv->crv.x = (gint)event->x;
-        		m_priv->crv.y = (gint)event->y;
-				break;
-			case GP_CURVE_SET:
-				break;
-			default:
-				break;
-        }
-        
-		if( !m_priv->is_draw ) gtk_widget_queue_draw ( m_priv->cv->widget );
-		gtk_widget_queue_draw ( m_priv->cv->widget );
+		if( m_priv->is_draw )
+		{
+			m_priv->button = event->button;
+			if ( m_priv->action == GP_CURVE_DO_LINE )
+			{
+				m_priv->start.x = (gint)event->x;
+				m_priv->start.y = (gint)event->y;
+			}
+			set_point ( event->x, event->y );
+		}
+		else
+		{
+			/*second button cancels the whole curve*/
+			m_priv->action = GP_CURVE_DO_LINE;
+			cv_update_preview ( &m_priv->preview, NULL );
+		}
 	}
 	return TRUE;
 }
@@ -139,41 +146,30 @@ button_release ( GdkEventButton *event )
 {
 	if ( event->type == GDK_BUTTON_RELEASE )
 	{
-		if( m_priv->button == event->button )
+		if( m_priv->button == event->button && m_priv->is_draw )
 		{
-			if( m_priv->is_draw )
+			set_point ( event->x, event->y );
+			switch(m_priv->action)
 			{
-   	            switch(m_priv->action)
-   	            {
-        			case GP_CURVE_DO_LINE:
-        				m_priv->is_draw = TRUE;
-        				m_priv->end.x = (gint)event->x;
-        				m_priv->end.y = (gint)event->y;
-       			 		m_priv->action = GP_CURVE_DO_CURVE;
-       			 		m_priv->crv.x = (gint)event->x;
-        				m_priv->crv.y = (gint)event->y;
-						m_priv->is_draw = FALSE;
-						return TRUE;
-					case GP_CURVE_DO_CURVE:
-						m_priv->crv.x = (gint)event->x;
-        				m_priv->crv.y = (gint)event->y;
-        				m_priv->action = GP_CURVE_SET;
-						m_priv->is_draw = FALSE;
-						return TRUE;
-					case GP_CURVE_SET:
-						m_priv->crv.x = (gint)event->x;
-        				m_priv->crv.y = (gint)event->y;
-						save_undo ();
-						draw_in_pixmap (m_priv->cv->pixmap);
-						file_set_unsave ();
-            			m_priv->action = GP_CURVE_DO_LINE;
-						break;
-					default:
-						return TRUE;
-				}
+				case GP_CURVE_DO_LINE:
+					m_priv->c1 = m_priv->start;
+					m_priv->c2 = m_priv->end;
+					m_priv->action = GP_CURVE_DO_CURVE;
+					break;
+				case GP_CURVE_DO_CURVE:
+					m_priv->action = GP_CURVE_SET;
+					break;
+				case GP_CURVE_SET:
+					save_undo ();
+					draw_in_pixmap ( m_priv->cv->pixmap, NULL );
+					file_set_unsave ();
+					m_priv->action = GP_CURVE_DO_LINE;
+					cv_update_preview ( &m_priv->preview, NULL );
+					break;
+				default:
+					break;
 			}
-			gtk_widget_queue_draw ( m_priv->cv->widget );
-           	m_priv->is_draw = FALSE;
+			m_priv->is_draw = FALSE;
 		}
 	}
 	return TRUE;
@@ -184,21 +180,7 @@ button_motion ( GdkEventMotion *event )
 {
 	if( m_priv->is_draw )
 	{
-        switch(m_priv->action){
-      	  	case GP_CURVE_DO_LINE:
-      	  		m_priv->end.x = (gint)event->x;
-      	  		m_priv->end.y = (gint)event->y;
-				break;
-			case GP_CURVE_DO_CURVE:
-				m_priv->crv.x = (gint)event->x;
-        		m_priv->crv.y = (gint)event->y;
-				break;
-			case GP_CURVE_SET:
-				break;
-			default:
-				return TRUE;
-        }
-		gtk_widget_queue_draw ( m_priv->cv->widget );
+		set_point ( event->x, event->y );
 	}
 	return TRUE;
 }
@@ -206,9 +188,9 @@ button_motion ( GdkEventMotion *event )
 static void	
 draw ( void )
 {
-	if ( m_priv->is_draw )
+	if ( m_priv->is_draw || m_priv->action != GP_CURVE_DO_LINE )
 	{
-		draw_in_pixmap (m_priv->cv->drawing);
+		draw_in_pixmap ( m_priv->cv->drawing, m_priv->cv->expose );
 	}
 }
 
@@ -220,6 +202,8 @@ reset ( void )
 	gdk_window_set_cursor ( m_priv->cv->drawing, cursor );
 	gdk_cursor_unref( cursor );
 	m_priv->is_draw = FALSE;
+	m_priv->action = GP_CURVE_DO_LINE;
+	cv_update_preview ( &m_priv->preview, NULL );
 }
 
 static void 
@@ -229,88 +213,68 @@ destroy ( gpointer data  )
 	g_print("curve tool destroy\n");
 }
 
+/* move the point the current stage is dragging */
 static void
-draw_in_pixmap ( GdkDrawable *drawable )
+set_point ( gdouble x, gdouble y )
 {
-    switch(m_priv->action)
-    {
-       	case GP_CURVE_DO_LINE:
-       		gdk_draw_line(drawable, m_priv->gcf, m_priv->start.x, m_priv->start.y,
-       					  m_priv->end.x, m_priv->end.y);
+	switch(m_priv->action)
+	{
+		case GP_CURVE_DO_LINE:
+			m_priv->end.x = (gint)x;
+			m_priv->end.y = (gint)y;
 			break;
 		case GP_CURVE_DO_CURVE:
-			draw_bezier(drawable, m_priv->gcf, m_priv->start, m_priv->crv, m_priv->end);
+			/*both handles follow the first one, as in Paint*/
+			m_priv->c1.x = m_priv->c2.x = (gint)x;
+			m_priv->c1.y = m_priv->c2.y = (gint)y;
 			break;
 		case GP_CURVE_SET:
-			draw_bezier(drawable, m_priv->gcf, m_priv->start, m_priv->crv, m_priv->end);
+			m_priv->c2.x = (gint)x;
+			m_priv->c2.y = (gint)y;
 			break;
 		default:
-			break;
-    }
+			return;
+	}
+	update_shape ();
 }
 
-void draw_bezier(GdkDrawable *drawable, GdkGC *gc, GdkPoint pt1, GdkPoint pt2, GdkPoint pt3)
+static void
+update_shape ( void )
 {
-	gint x, y, x2, y2;
-	double t, t2;
-	
-	x2 = pt1.x;
-	y2 = pt1.y;
-	
-	for(t = 0.0; t < 1.0 + .02; t += .02)
+	GdkRectangle	clip;
+	GdkPoint		points[4];
+	gp_stroke_style	style;
+
+	points[0] = m_priv->start;
+	points[1] = m_priv->c1;
+	points[2] = m_priv->c2;
+	points[3] = m_priv->end;
+	cv_get_rect_size ( &clip );
+	gp_stroke_style_from_gc ( &style, m_priv->gcf );
+	if ( m_priv->action == GP_CURVE_DO_LINE )
 	{
-		t2 = t;
-
-		x = ((1 - t2) * (1 - t2)) *
-			pt1.x + 2 * t2 * (1 -t2) *
-			pt2.x + (t2 * t2) *
-			pt3.x ;
-
-		y = ((1 - t2) * (1 - t2)) *
-			pt1.y + 2 * t2 * (1 -t2) *
-			pt2.y + (t2 * t2) *
-			pt3.y ;
-
-		gdk_draw_line(drawable, gc, x, y, x2, y2);
-		
-		x2 = x; y2 = y;
+		points[1] = m_priv->end;
+		gp_shape_stroke_polyline ( m_priv->outline, &clip, points, 2, FALSE,
+		                           &style );
+	}
+	else
+	{
+		gp_shape_stroke_curve ( m_priv->outline, &clip, points, &style );
 	}
+	cv_update_preview ( &m_priv->preview,
+	                    gp_shape_damage ( NULL, m_priv->outline ) );
+}
 
+static void
+draw_in_pixmap ( GdkDrawable *drawable, GdkRegion *area )
+{
+	GdkColormap *colormap = gtk_widget_get_colormap ( m_priv->cv->widget );
+	gp_shape_render ( drawable, m_priv->cv->pixmap, m_priv->gcf, area, NULL, 0,
+	                  m_priv->outline, gp_dab_color_from_gc ( m_priv->gcf, colormap ) );
 }
 
 static void     
 save_undo ( void )
 {
-    GdkRectangle    rect;
-    GdkRectangle    rect_max;
-    GdkBitmap       *mask = NULL;
-	GdkGC	        *gc_mask;
-	gp_point_array  *pa;
-	GdkPoint		*points;
-
-    cv_get_rect_size ( &rect_max );
-    pa = gp_point_array_new ();
-    gp_point_array_append ( pa, m_priv->start.x, m_priv->start.y );
-    gp_point_array_append ( pa, m_priv->crv.x, m_priv->crv.y );
-    gp_point_array_append ( pa, m_priv->end.x, m_priv->end.y );
-    
-    gp_point_array_get_clipbox ( pa, &rect, m_priv->cv->line_width, &rect_max );
-        
-	undo_create_mask ( rect.width, rect.height, &mask, &gc_mask );
-	
-	gp_point_array_offset ( pa, -rect.x, -rect.y);
-	points = gp_point_array_data ( pa );
-
-	draw_bezier(mask, gc_mask, points[0], points[1], points[2]);
-
-	g_object_unref (gc_mask);
-	gp_point_array_free ( pa );
-
-    undo_add ( &rect, mask, NULL, TOOL_CURVE );
-    if ( mask != NULL ) g_object_unref (mask);
+	undo_add_shape ( NULL, m_priv->outline, TOOL_CURVE );
 }
-
-
-
-
-
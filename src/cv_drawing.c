@@ -37,6 +37,7 @@
 #include "cv_airbrush_tool.h"
 #include "cv_curve_tool.h"
 #include "cv_rect_select.h"
+#include "cv_free_select.h"
 #include "undo.h"
 #include "color-picker.h"
 #include "cv_eraser_tool.h"
@@ -71,6 +72,28 @@ cv_redraw ( void )
     gtk_widget_queue_draw (cv.widget);
 }
 
+/*
+ * Rubber-band previews: repaint where the shape was and where it is
+ * now. Takes ownership of damage, which replaces *preview.
+ */
+void
+cv_update_preview ( GdkRegion **preview, GdkRegion *damage )
+{
+    if ( *preview != NULL )
+    {
+        if ( cv.drawing != NULL )
+        {
+            gdk_window_invalidate_region ( cv.drawing, *preview, FALSE );
+        }
+        gdk_region_destroy ( *preview );
+    }
+    if ( damage != NULL && cv.drawing != NULL )
+    {
+        gdk_window_invalidate_region ( cv.drawing, damage, FALSE );
+    }
+    *preview = damage;
+}
+
 void
 cv_set_color_bg	( GdkColor *color )
 {
@@ -97,14 +120,29 @@ void
 cv_set_line_width	( gint width )
 {
 	gdk_gc_set_line_attributes ( cv.gc_fg, width, GDK_LINE_SOLID, 
-	                             GDK_CAP_ROUND, GDK_JOIN_ROUND );
+	                             cv.line_cap, cv.line_join );
 	gdk_gc_set_line_attributes ( cv.gc_bg, width, GDK_LINE_SOLID, 
-	                             GDK_CAP_ROUND, GDK_JOIN_ROUND );
+	                             cv.line_cap, cv.line_join );
 	gtk_widget_queue_draw ( cv.widget );
 	gdk_window_process_updates (gtk_widget_get_parent_window(cv.widget), FALSE);
 	cv.line_width = width;
 }
 
+/* the shape tools stroke with the caps and joins of the gc */
+void
+cv_set_line_cap ( GdkCapStyle cap )
+{
+	cv.line_cap = cap;
+	cv_set_line_width ( cv.line_width );
+}
+
+void
+cv_set_line_join ( GdkJoinStyle join )
+{
+	cv.line_join = join;
+	cv_set_line_width ( cv.line_width );
+}
+
 void
 cv_set_filled ( gp_filled filled )
 {
@@ -136,7 +174,7 @@ cv_set_tool ( gp_tool_enum tool )
 	        cv_tool = NULL;
             break;
         case TOOL_FREE_SELECT:
-	        cv_tool = NULL;
+	        cv_tool = tool_free_select_init ( &cv );
             break;
         case TOOL_RECT_SELECT:
 	        cv_tool = tool_rect_select_init ( &cv );
@@ -278,6 +316,8 @@ on_cv_drawing_realize (GtkWidget *widget, gpointer user_data)
 	cv.gc_fg_pencil	=	cv_create_new_gc( "cv_gc_fg_pencil" );
 	cv.gc_bg_pencil	=	cv_create_new_gc( "cv_gc_bg_pencil" );
 	cv.pixmap		=	NULL;
+	cv.line_cap		=	GDK_CAP_ROUND;
+	cv.line_join	=	GDK_JOIN_ROUND;
 	cv_set_color_fg ( &black_color );
 	cv_set_color_bg ( &white_color );
 	cv_set_line_width ( 1 );
@@ -366,30 +406,36 @@ on_cv_drawing_motion_notify_event (	GtkWidget      *widget,
 	return ret;
 }
 
-gboolean 
+gboolean
 on_cv_drawing_expose_event	(   GtkWidget	   *widget, 
 								GdkEventExpose *event,
                					gpointer       user_data )
 {
+	GdkRectangle	*rects;
+	gint			n_rects, i;
+	GdkGC			*gc;
+
 #if GTK_MAJOR_VERSION >= 2 && GTK_MINOR_VERSION >= 18
-    gdk_draw_drawable (	widget->window,
-                    	widget->style->fg_gc[gtk_widget_get_state(widget)],
-    	                cv.pixmap,
-    	                event->area.x, event->area.y,
-    	                event->area.x, event->area.y,
-    	                event->area.width, event->area.height);	
+	gc = widget->style->fg_gc[gtk_widget_get_state(widget)];
 #else
-	gdk_draw_drawable (	widget->window,
-                    	widget->style->fg_gc[GTK_WIDGET_STATE(widget)],
-    	                cv.pixmap,
-    	                event->area.x, event->area.y,
-    	                event->area.x, event->area.y,
-    	                event->area.width, event->area.height);
+	gc = widget->style->fg_gc[GTK_WIDGET_STATE(widget)];
 #endif
+	/*restore only what was damaged, not its bounding box*/
+	gdk_region_get_rectangles ( event->region, &rects, &n_rects );
+	for ( i = 0; i < n_rects; i++ )
+	{
+		gdk_draw_drawable (	widget->window, gc, cv.pixmap,
+		                    rects[i].x, rects[i].y,
+		                    rects[i].x, rects[i].y,
+		                    rects[i].width, rects[i].height );
+	}
+	g_free ( rects );
 
 	if ( cv_tool != NULL )
 	{
+		cv.expose = event->region;
 		cv_tool->draw();
+		cv.expose = NULL;
 	}
 
 	cv_resize_draw();
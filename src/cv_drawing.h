@@ -32,6 +32,8 @@
 void		cv_set_color_bg			( GdkColor *color );
 void		cv_set_color_fg			( GdkColor *color );
 void		cv_set_line_width		( gint width );
+void		cv_set_line_cap			( GdkCapStyle cap );
+void		cv_set_line_join		( GdkJoinStyle join );
 void		cv_set_filled			( gp_filled filled );
 void        cv_set_tool             ( gp_tool_enum tool );
 void		cv_resize_pixmap		(gint width, gint height);
@@ -41,6 +43,7 @@ gp_canvas * cv_get_canvas			( void );
 void        cv_get_rect_size        ( GdkRectangle *rectangle );
 void        cv_redraw               ( void );
 void        cv_set_transparent      ( gboolean transparent);
+void        cv_update_preview       ( GdkRegion **preview, GdkRegion *damage );
 
 
 /* GUI CallBacks */
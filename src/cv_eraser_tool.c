@@ -25,6 +25,8 @@
 #include "file.h"
 #include "gp-image.h"
 #include "toolbar.h"
+#include "gp_stroke.h"
+#include "gp_dab.h"
 
 #define ERASER_WIDTH	17
 #define ERASER_HEIGHT	17
@@ -39,6 +41,7 @@ typedef void (DrawEraserFunc)(GdkDrawable *drawable, int x, int y);
 static const double EPSILON = 0.00001;
 
 static gint m_last_eraser = GP_ERASER_RECT_TINY;
+static gint m_replace_tolerance = 0;	/* percent */
 
 static GdkPixbuf *g_pixbuf = NULL;
 
@@ -70,7 +73,6 @@ typedef struct {
 	gp_canvas *		cv;
 	GdkGC *			gc;
 	gint 			x0,y0;
-	gint			x_min,y_min,x_max,y_max;
 	guint			button;
 	gboolean 		is_draw;
 	double			spacing;        
@@ -79,7 +81,9 @@ typedef struct {
     DrawEraserFunc	*draw_eraser;
     GPEraserType	eraser_type;
     gint			width, height; /* eraser width & height */
-    GdkPixmap *		bg_pixmap;
+    gp_stroke *		backup;		/* canvas tiles under the stroke */
+    gboolean		replace;	/* right button: fg -> bg colour replace */
+    GArray *		dabs;		/* replace dab centers not yet applied */
     gint			xprev;
     gint			yprev;
 } private_data;
@@ -87,43 +91,10 @@ typedef struct {
 static private_data		*m_priv = NULL;
 
 static void
-destroy_background ( void )
+destroy_backup ( void )
 {
-    if (m_priv->bg_pixmap != NULL) 
-    {
-        g_object_unref (m_priv->bg_pixmap);
-        m_priv->bg_pixmap = NULL;
-    }
-}
-
-static void
-save_background ( void )
-{
-	gint w,h;
-    destroy_background ();
-	gdk_drawable_get_size ( m_priv->cv->pixmap, &w, &h );
-	m_priv->bg_pixmap = gdk_pixmap_new ( m_priv->cv->drawing, w, h, -1);
-	gdk_draw_drawable (	m_priv->bg_pixmap,
-		            	m_priv->cv->gc_fg,
-			            m_priv->cv->pixmap,
-			            0, 0,
-			            0, 0,
-			            w, h );
-}
-
-static void
-restore_background ( void )
-{
-    if ( m_priv->bg_pixmap != NULL )
-    {
-	    gdk_draw_drawable (	m_priv->cv->pixmap,
-		                	m_priv->cv->gc_fg,
-			                m_priv->bg_pixmap,
-			                0, 0,
-			                0, 0,
-			                -1, -1 );
-        destroy_background ();
-    }    
+    gp_stroke_free (m_priv->backup);
+    m_priv->backup = NULL;
 }
 
 static void
@@ -140,7 +111,8 @@ create_private_data( void )
 		m_priv->eraser_type	=	GP_ERASER_TYPE_RECTANGLE; /* change type here to test other eraseres */
 		m_priv->width		=	ERASER_WIDTH;
 		m_priv->height		=	ERASER_HEIGHT;
-        m_priv->bg_pixmap   =   NULL;
+        m_priv->backup      =   NULL;
+		m_priv->dabs		=	g_array_new (FALSE, FALSE, sizeof(GdkPoint));
 		
 		set_eraser_values(m_priv->eraser_type, m_last_eraser);
 	}
@@ -149,7 +121,8 @@ create_private_data( void )
 static void
 destroy_private_data( void )
 {
-    destroy_background ();
+    destroy_backup ();
+	g_array_free (m_priv->dabs, TRUE);
 	g_slice_free (private_data, m_priv);
 	m_priv = NULL;
 }
@@ -186,20 +159,19 @@ button_press ( GdkEventButton *event )
 		if( m_priv->is_draw )
 		{
 			m_priv->button = event->button;
-            save_background();
+			m_priv->replace = ( event->button == RIGHT_BUTTON );
+            destroy_backup ();
+            m_priv->backup = gp_stroke_new (m_priv->cv);
 		}
         else
         {
-            restore_background ();
+            gp_stroke_restore (m_priv->backup);
+            destroy_backup ();
         }
 		m_priv->drag.x = (gint)event->x;
 		m_priv->drag.y = (gint)event->y;
 		m_priv->x0 = m_priv->drag.x;
 		m_priv->y0 = m_priv->drag.y;
-        m_priv->x_min = G_MAXINT;
-        m_priv->x_max = G_MININT;
-		m_priv->y_min = G_MAXINT;
-        m_priv->y_max = G_MININT;
 
 		if( !m_priv->is_draw )
 		{
@@ -291,6 +263,7 @@ static void
 destroy ( gpointer data  )
 {
 	destroy_private_data ();
+	gp_dab_mask_cache_clear ();
 	if(GDK_IS_PIXBUF(g_pixbuf))
 	{
 		g_object_unref(g_pixbuf);
@@ -301,9 +274,32 @@ destroy ( gpointer data  )
 static void
 draw_in_pixmap ( GdkDrawable *drawable )
 {
+	g_array_set_size (m_priv->dabs, 0);
 	b_rush_interpolate(drawable, m_priv->draw_eraser, m_priv->x0, m_priv->y0);
 	m_priv->drag.x = m_priv->x0;
 	m_priv->drag.y = m_priv->y0;
+
+	if (m_priv->replace && m_priv->dabs->len > 0)
+	{
+		GdkColormap *colormap = gtk_widget_get_colormap (m_priv->cv->widget);
+		const gp_dab_mask *mask;
+		GdkRectangle rect;
+
+		mask = gp_dab_mask_get (
+		           ( m_priv->eraser_type == GP_ERASER_TYPE_ROUND ) ?
+		               GP_DAB_ROUND : GP_DAB_SQUARE,
+		           m_priv->width, m_priv->height, 100 );
+		rect = gp_dab_replace (drawable, m_priv->cv->gc_fg, mask,
+		                       gp_dab_color_from_gc (m_priv->cv->gc_fg_pencil, colormap),
+		                       gp_dab_color_from_gc (m_priv->cv->gc_bg_pencil, colormap),
+		                       m_replace_tolerance * 255 / 100,
+		                       (GdkPoint *)m_priv->dabs->data, m_priv->dabs->len);
+		if (rect.width > 0 && rect.height > 0)
+		{
+			gtk_widget_queue_draw_area (m_priv->cv->widget, rect.x, rect.y,
+			                            rect.width, rect.height);
+		}
+	}
 }
 
 /* Create a new cursor after bg color change */
@@ -362,12 +358,19 @@ b_rush_interpolate(GdkDrawable *drawable, DrawEraserFunc *draw_eraser_func, int
 			x = (int)(m_priv->drag.x + percent * dx);
 			y = (int)(m_priv->drag.y + percent * dy);
 
-		    if (m_priv->x_min>x)m_priv->x_min=x;
-		    if (m_priv->x_max<x)m_priv->x_max=x;
-		    if (m_priv->y_min>y)m_priv->y_min=y;
-		    if (m_priv->y_max<y)m_priv->y_max=y;
-            
-			draw_eraser_func(drawable, x, y);
+			gp_stroke_touch (m_priv->backup, x - m_priv->width / 2,
+			                 y - m_priv->height / 2,
+			                 m_priv->width + 1, m_priv->height + 1);
+
+			if (m_priv->replace)
+			{
+				GdkPoint p = { x, y };
+				g_array_append_val (m_priv->dabs, p);
+			}
+			else
+			{
+				draw_eraser_func(drawable, x, y);
+			}
 		}
 	 }
 	 m_priv->distance = final;
@@ -453,24 +456,8 @@ static GdkCursor *create_eraser_cursor(GPEraserType type)
 static void     
 save_undo ( void )
 {
-
-	gint w,h;
-	GdkRectangle rect;
-	
-	rect.x		=	m_priv->x_min - m_priv->width/2;
-	rect.y		=	m_priv->y_min - m_priv->height/2;
-	rect.width	=	m_priv->x_max - m_priv->x_min + m_priv->width;
-	rect.height	=	m_priv->y_max - m_priv->y_min + m_priv->height;
-
-	if (rect.x<0) rect.x = 0;
-	if (rect.y<0) rect.y = 0;
-	gdk_drawable_get_size ( m_priv->cv->pixmap, &w, &h );
-	if (rect.width>w) rect.width=w;
-	if (rect.height>h) rect.height=h;
-
-    undo_add ( &rect, NULL, m_priv->bg_pixmap, TOOL_ERASER);
-
-	
+    gp_stroke_save_undo (m_priv->backup, TOOL_ERASER);
+    destroy_backup ();
 	g_print ("save_undo\n");
 	
 }
@@ -565,3 +552,8 @@ static void set_eraser_size(GPEraserSize size)
 				return;
 		}
 }
+
+void on_eraser_tolerance_value_changed(GtkRange *range, gpointer data)
+{
+	m_replace_tolerance = (gint)gtk_range_get_value(range);
+}
@@ -37,4 +37,5 @@ typedef enum{
 gp_tool * tool_eraser_init ( gp_canvas * canvas );
 void notify_eraser_of_bg_color_change(void);
 void on_eraser_size_toggled(GtkWidget *widget, gpointer data);
+void on_eraser_tolerance_value_changed(GtkRange *range, gpointer data);
 #endif
@@ -37,6 +37,11 @@ static void		draw			( void );
 static void		reset			( void );
 static void		destroy			( gpointer data  );
 static void		save_undo		( void );
+static void		get_fill_style	( gp_fill_style *style, guint state );
+static GdkPixbuf *	create_hatch_pattern	( guint fg, guint bg );
+
+/* drags shorter than this are plain clicks */
+#define DRAG_THRESHOLD	3
 
 /*private data*/
 typedef struct {
@@ -44,9 +49,11 @@ typedef struct {
 	gp_canvas *		cv;
 	GdkGC *			gc;
 	gint 			x0,y0;
+	gint 			x1,y1;
 	guint			button;
 	gboolean 		is_draw;
 	guint			fill_color;
+	guint			other_color;
 	GdkRectangle	rect;
 	GdkPixmap *		pixmap;
 } private_data;
@@ -107,9 +114,13 @@ button_press ( GdkEventButton *event )
 		if( m_priv->is_draw ) m_priv->button = event->button;
 		m_priv->x0 = (gint)event->x;
 		m_priv->y0 = (gint)event->y;
+		m_priv->x1 = m_priv->x0;
+		m_priv->y1 = m_priv->y0;
 		if( !m_priv->is_draw ) gtk_widget_queue_draw ( m_priv->cv->widget );
 
 		m_priv->fill_color = get_fg_color_from_gc(m_priv->gc);
+		m_priv->other_color = get_fg_color_from_gc( 
+		        m_priv->gc == m_priv->cv->gc_fg ? m_priv->cv->gc_bg : m_priv->cv->gc_fg );
 	}
 	return TRUE;
 }
@@ -119,6 +130,7 @@ button_release ( GdkEventButton *event )
 {
 	GdkPixbuf *pixbuf;
 	gint width, height;
+	gp_fill_style style;
 
 	if ( event->type == GDK_BUTTON_RELEASE )
 	{
@@ -148,11 +160,15 @@ button_release ( GdkEventButton *event )
 					gdk_draw_pixbuf(m_priv->pixmap, m_priv->gc, pixbuf, 0, 0, 0, 0,
                                     -1, -1, GDK_RGB_DITHER_NONE, 0, 0);
 					
-					m_priv->rect = fill_draw( GDK_DRAWABLE( m_priv->cv->pixmap ), 
+					m_priv->x1 = (gint)event->x;
+					m_priv->y1 = (gint)event->y;
+					get_fill_style ( &style, event->state );
+					m_priv->rect = fill_draw_style( GDK_DRAWABLE( m_priv->cv->pixmap ), 
 				    	      m_priv->gc, 
-				    	      m_priv->fill_color, 
+				    	      &style, 
 				    	      m_priv->x0, 
 			    		      m_priv->y0);
+					if ( style.pattern != NULL ) g_object_unref ( style.pattern );
 					
 					g_object_unref(pixbuf);
 
@@ -174,7 +190,9 @@ button_motion ( GdkEventMotion *event )
 {
 	if( m_priv->is_draw )
 	{
-
+		m_priv->x1 = (gint)event->x;
+		m_priv->y1 = (gint)event->y;
+		gtk_widget_queue_draw ( m_priv->cv->widget );
 	}
 	return TRUE;
 }
@@ -182,31 +200,14 @@ button_motion ( GdkEventMotion *event )
 void	
 draw ( void )
 {
-	GdkPixbuf *pixbuf;
-
-	if ( m_priv->is_draw )
+	/* while dragging show the gradient vector, the fill itself *
+	 * is done on button release                               */
+	if ( m_priv->is_draw &&
+	     ( ABS(m_priv->x1 - m_priv->x0) >= DRAG_THRESHOLD ||
+	       ABS(m_priv->y1 - m_priv->y0) >= DRAG_THRESHOLD ) )
 	{
-		pixbuf = cv_get_pixbuf ( );
-		if(GDK_IS_PIXBUF(pixbuf))
-		{
-			if(!gdk_pixbuf_get_has_alpha (pixbuf))
-			{
-				GdkPixbuf *tmp ;
-
-				tmp = gdk_pixbuf_add_alpha( pixbuf, FALSE, 0, 0, 0 );
-				g_object_unref(pixbuf);
-				pixbuf = tmp;
-			}
-
-			fill_draw( GDK_DRAWABLE( m_priv->cv->pixmap ), 
-			          m_priv->gc, 
-			          m_priv->fill_color, 
-			          m_priv->x0, 
-			          m_priv->y0);
-			g_object_unref(pixbuf);
-
-			file_set_unsave ();
-		}
+		gdk_draw_line ( m_priv->cv->drawing, m_priv->gc,
+		                m_priv->x0, m_priv->y0, m_priv->x1, m_priv->y1 );
 	}
 }
 
@@ -250,6 +251,72 @@ guint get_fg_color_from_gc(GdkGC *gc)
 	return color;
 }
 
+/*
+ * Pick the fill style from the mouse gesture:
+ *   click              flat colour
+ *   drag               linear gradient along the drag
+ *   shift + drag       radial gradient, the drag is the radius
+ *   ctrl + click/drag  hatch pattern of both colours
+ */
+static void
+get_fill_style ( gp_fill_style *style, guint state )
+{
+	gboolean dragged = ABS(m_priv->x1 - m_priv->x0) >= DRAG_THRESHOLD ||
+	                   ABS(m_priv->y1 - m_priv->y0) >= DRAG_THRESHOLD;
+
+	style->color1	= m_priv->fill_color;
+	style->color2	= m_priv->other_color;
+	style->p0.x		= m_priv->x0;
+	style->p0.y		= m_priv->y0;
+	style->p1.x		= m_priv->x1;
+	style->p1.y		= m_priv->y1;
+	style->pattern	= NULL;
+
+	if ( state & GDK_CONTROL_MASK )
+	{
+		style->mode		= FILL_PATTERN;
+		style->pattern	= create_hatch_pattern ( m_priv->fill_color,
+		                                         m_priv->other_color );
+	}
+	else if ( !dragged )
+	{
+		style->mode		= FILL_FLAT;
+	}
+	else if ( state & GDK_SHIFT_MASK )
+	{
+		style->mode		= FILL_RADIAL;
+	}
+	else
+	{
+		style->mode		= FILL_LINEAR;
+	}
+}
+
+static GdkPixbuf *
+create_hatch_pattern ( guint fg, guint bg )
+{
+	GdkPixbuf	*pattern;
+	guchar		*pixels;
+	gint		rowstride, x, y;
+
+	pattern		= gdk_pixbuf_new ( GDK_COLORSPACE_RGB, TRUE, 8, 8, 8 );
+	pixels		= gdk_pixbuf_get_pixels ( pattern );
+	rowstride	= gdk_pixbuf_get_rowstride ( pattern );
+	for ( y = 0; y < 8; y++ )
+	{
+		for ( x = 0; x < 8; x++ )
+		{
+			guchar	*p		= pixels + y * rowstride + x * 4;
+			guint	color	= ( ((x + y) & 7) < 2 ) ? fg : bg;
+			p[0] = getr(color);
+			p[1] = getg(color);
+			p[2] = getb(color);
+			p[3] = geta(color);
+		}
+	}
+	return pattern;
+}
+
 static void     
 save_undo ( void )
 {
@@ -0,0 +1,398 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor Boston, MA 02110-1301,  USA
+ */
+ 
+#include <gtk/gtk.h>
+
+#include "cv_free_select.h"
+#include "cv_drawing.h"
+#include "gp_point_array.h"
+#include "gp_shape.h"
+#include "gp_mask.h"
+#include "pixbuf_util.h"
+
+#include "selection.h"
+
+/* tint of the area being enclosed, as the rectangle selection has */
+#define LASSO_TINT		col_rgba ( 0xB3, 0xE6, 0xFF, 0x4D )
+
+/* a click without dragging selects by colour */
+static gint     g_wand_tolerance    = 15;   /* percent */
+static gboolean g_wand_contiguous   = TRUE;
+
+/*private data*/
+typedef enum
+{
+	SEL_NONE,
+    SEL_WAITING,
+	SEL_DRAWING,
+    SEL_ACTION,
+} gp_sel_state;
+
+
+typedef struct {
+	gp_tool			tool;
+	gp_canvas       *cv;
+    gp_sel_state    state;
+    gp_point_array  *pa;        /* lasso path                       */
+    gp_span_list    *fill;      /* what the path encloses           */
+    gp_mask_op      op;         /* shift adds, ctrl subtracts       */
+    gp_mask         *base;      /* the selection being added to     */
+} private_data;
+
+
+/*Member functions*/
+
+static gboolean	button_press	( GdkEventButton *event );
+static gboolean	button_release	( GdkEventButton *event );
+static gboolean	button_motion	( GdkEventMotion *event );
+static void		reset			( void );
+static void		destroy			( gpointer data  );
+static void     set_cursor      ( GdkCursorType cursor_type );
+static void     add_point       ( GdkPoint *p );
+static void     change_cursor   ( GdkPoint *p );
+static gp_mask *select_color    ( GdkPoint *p );
+/* Draw functions */
+static void		draw			( void );
+static void     draw_lasso      ( void );
+
+
+static private_data		*m_priv = NULL;
+	
+static void
+create_private_data( void )
+{
+	if (m_priv == NULL)
+	{
+		m_priv = g_new0 (private_data,1);
+		m_priv->cv		    =	NULL;
+        m_priv->state       =   SEL_NONE;
+        m_priv->pa          =   gp_point_array_new ();
+        m_priv->fill        =   gp_span_list_new ();
+        m_priv->op          =   GP_MASK_REPLACE;
+        m_priv->base        =   NULL;
+	}
+}
+
+static void
+destroy_private_data( void )
+{
+    gp_selection_clear ();
+    gp_point_array_free ( m_priv->pa );
+    gp_span_list_free ( m_priv->fill );
+    gp_mask_free ( m_priv->base );
+	g_free (m_priv);
+	m_priv = NULL;
+}
+
+gp_tool * 
+tool_free_select_init ( gp_canvas * canvas )
+{
+    gp_selection_init ();
+	create_private_data ();
+	m_priv->cv					= canvas;
+	m_priv->tool.button_press	= button_press;
+	m_priv->tool.button_release	= button_release;
+	m_priv->tool.button_motion	= button_motion;
+	m_priv->tool.draw			= draw;
+	m_priv->tool.reset			= reset;
+	m_priv->tool.destroy		= destroy;
+	return &m_priv->tool;
+}
+
+static gboolean
+button_press ( GdkEventButton *event )
+{
+    GdkPoint p;
+    p.x = (gint)event->x;
+    p.y = (gint)event->y;
+	if ( event->type == GDK_BUTTON_PRESS )
+	{
+        gp_mask_op op = GP_MASK_REPLACE;
+
+        if ( event->state & GDK_SHIFT_MASK )
+        {
+            op = GP_MASK_ADD;
+        }
+        else if ( event->state & GDK_CONTROL_MASK )
+        {
+            op = GP_MASK_SUBTRACT;
+        }
+        if ( op == GP_MASK_REPLACE && gp_selection_start_action ( &p ) )
+        {
+            m_priv->state   =   SEL_ACTION;
+        }
+        else
+        {
+            gp_selection_set_floating ( TRUE );
+            gp_mask_free ( m_priv->base );
+            m_priv->base    =   NULL;
+            m_priv->op      =   op;
+            if ( op != GP_MASK_REPLACE && gp_selection_get_mask () != NULL )
+            {
+                m_priv->base = gp_mask_copy ( gp_selection_get_mask () );
+            }
+            gp_selection_set_active ( FALSE );
+            gp_selection_set_mask ( NULL, NULL, 0 );
+            gp_point_array_clear ( m_priv->pa );
+            add_point ( &p );
+            m_priv->state   =   SEL_DRAWING;
+        }
+        gp_selection_set_borders ( FALSE );
+		gtk_widget_queue_draw ( m_priv->cv->widget );
+	}
+    else
+    if ( event->type == GDK_2BUTTON_PRESS )
+    {
+        if ( gp_selection_start_action ( &p ) )
+        {
+            gp_selection_set_floating ( FALSE );
+        }        
+    }
+        
+	return TRUE;
+}
+
+
+static gboolean
+button_release ( GdkEventButton *event )
+{
+	if ( event->type == GDK_BUTTON_RELEASE )
+	{
+        if ( m_priv->state == SEL_DRAWING )
+        {
+            GdkPoint    p;
+            gp_mask     *mask = NULL;
+            gint        n;
+
+            p.x = (gint)event->x;
+            p.y = (gint)event->y;
+            add_point ( &p );
+            n = gp_point_array_size ( m_priv->pa );
+            if ( n == 1 )
+            {
+                mask = select_color ( &p );
+                n = 0;
+            }
+            else if ( n > 2 )
+            {
+                mask = gp_mask_new_from_spans ( m_priv->fill );
+            }
+            if ( m_priv->op != GP_MASK_REPLACE )
+            {
+                /*the path no longer outlines the result*/
+                gp_mask *result = gp_mask_combine ( m_priv->base, mask, m_priv->op );
+                gp_mask_free ( mask );
+                gp_mask_free ( m_priv->base );
+                m_priv->base = NULL;
+                mask = result;
+                n = 0;
+            }
+            if ( mask != NULL )
+            {
+                gp_selection_set_mask ( mask, gp_point_array_data ( m_priv->pa ), n );
+                gp_selection_set_active ( TRUE );
+            }
+        }
+        m_priv->state = SEL_WAITING;
+        gp_selection_set_borders ( TRUE );
+        gtk_widget_queue_draw ( m_priv->cv->widget );
+	}
+	return TRUE;
+}
+
+static gboolean
+button_motion ( GdkEventMotion *event )
+{
+    GdkPoint p;
+    p.x = (gint)event->x;
+    p.y = (gint)event->y;
+    switch ( m_priv->state )
+    {
+        case SEL_DRAWING:
+        {
+            add_point ( &p );
+            break;
+        }
+        case SEL_WAITING:
+        {
+            change_cursor ( &p );
+            break;
+        }
+        case SEL_ACTION:
+        {
+            gp_selection_do_action ( &p );
+            gtk_widget_queue_draw ( m_priv->cv->widget );
+            break;
+        }
+        default:
+            break;
+    }
+    return TRUE;
+}
+
+    
+static void	
+draw ( void )
+{
+    if ( m_priv->state == SEL_DRAWING )
+    {
+        draw_lasso ();
+    }
+    else
+    {
+        gp_selection_draw (NULL);
+    }
+}
+
+static void 
+reset ( void )
+{
+    set_cursor ( GDK_DOTBOX );
+}
+
+static void 
+destroy ( gpointer data  )
+{
+	g_print("free select tool destroy\n");
+	gp_selection_draw (m_priv->cv->pixmap);
+    gtk_widget_queue_draw ( m_priv->cv->widget );
+	destroy_private_data ();
+}
+
+
+static void 
+set_cursor ( GdkCursorType cursor_type )
+{
+    static GdkCursorType last_cursor = GDK_LAST_CURSOR;
+    if ( cursor_type != last_cursor )
+    {
+        GdkCursor *cursor = gdk_cursor_new ( cursor_type );
+	    g_assert(cursor);
+	    gdk_window_set_cursor ( m_priv->cv->drawing, cursor );
+	    gdk_cursor_unref( cursor );
+        last_cursor = cursor_type;
+    }
+}
+
+/*
+ * Extend the lasso and rasterize what it encloses again, the fill is
+ * what becomes the mask on release. The new point swaps the closing
+ * edge back to the first point for two edges through it, so on screen
+ * only the triangle between those three points changes.
+ */
+static void 
+add_point ( GdkPoint *p )
+{
+    GdkRectangle    rect;
+    gint            n = gp_point_array_size ( m_priv->pa );
+
+    cv_get_rect_size ( &rect );
+    p->x = CLAMP ( p->x, 0, rect.width - 1 );
+    p->y = CLAMP ( p->y, 0, rect.height - 1 );
+    if ( n > 0 )
+    {
+        GdkPoint        *points = gp_point_array_data ( m_priv->pa );
+        GdkPoint        *first  = &points[0];
+        GdkPoint        *last   = &points[n - 1];
+        GdkRectangle    area;
+
+        if ( last->x == p->x && last->y == p->y ) return;
+        /*one pixel more all around for the anti-aliased edges*/
+        area.x      = MIN ( MIN ( first->x, last->x ), p->x ) - 1;
+        area.y      = MIN ( MIN ( first->y, last->y ), p->y ) - 1;
+        area.width  = MAX ( MAX ( first->x, last->x ), p->x ) + 2 - area.x;
+        area.height = MAX ( MAX ( first->y, last->y ), p->y ) + 2 - area.y;
+        gdk_window_invalidate_rect ( m_priv->cv->drawing, &area, FALSE );
+    }
+    gp_point_array_append ( m_priv->pa, p->x, p->y );
+    gp_shape_fill_polygon ( m_priv->fill, &rect,
+                            gp_point_array_data ( m_priv->pa ),
+                            gp_point_array_size ( m_priv->pa ),
+                            GP_FILL_NONZERO );
+}
+
+static void
+draw_lasso ( void )
+{
+    gint8   dash_list[] = { 3, 3 };
+    GdkGC   *gc;
+
+    if ( m_priv->base != NULL )
+    {
+        gp_mask_fill ( m_priv->base, m_priv->cv->drawing, m_priv->cv->pixmap,
+                       m_priv->cv->gc_fg, m_priv->cv->expose,
+                       m_priv->base->x, m_priv->base->y,
+                       LASSO_TINT );
+    }
+    gp_shape_render ( m_priv->cv->drawing, m_priv->cv->pixmap, m_priv->cv->gc_fg,
+                      m_priv->cv->expose, m_priv->fill, LASSO_TINT, NULL, 0 );
+    if ( gp_point_array_size ( m_priv->pa ) < 2 ) return;
+
+    gc = gdk_gc_new ( m_priv->cv->widget->window );
+    gdk_gc_set_function ( gc, GDK_INVERT );
+    gdk_gc_set_dashes ( gc, 0, dash_list, 2 );
+    gdk_gc_set_line_attributes ( gc, 1, GDK_LINE_ON_OFF_DASH,
+                                 GDK_CAP_NOT_LAST, GDK_JOIN_ROUND );
+    gdk_draw_lines ( m_priv->cv->drawing, gc, gp_point_array_data ( m_priv->pa ),
+                     gp_point_array_size ( m_priv->pa ) );
+    g_object_unref ( gc );
+}
+
+static void 
+change_cursor ( GdkPoint *p )
+{
+    GdkCursorType cursor;
+    cursor = gp_selection_get_cursor ( p );
+    if ( cursor == GDK_BLANK_CURSOR ) 
+    {
+        set_cursor ( GDK_DOTBOX );
+    }
+    else
+    {
+        set_cursor ( cursor );
+    }
+}
+
+/* the magic wand: the pixels like the one clicked, all of them or
+ * only those the bucket fill would reach from there */
+static gp_mask *
+select_color ( GdkPoint *p )
+{
+    GdkRectangle    area;
+    gint            width, height;
+    guchar          *data;
+    gp_mask         *mask;
+
+    data = fill_select ( m_priv->cv->pixmap, p->x, p->y,
+                         g_wand_tolerance * 255 / 100, g_wand_contiguous, &area );
+    if ( data == NULL ) return NULL;
+    gdk_drawable_get_size ( m_priv->cv->pixmap, &width, &height );
+    mask = gp_mask_new_from_data ( data, width, &area );
+    g_free ( data );
+    return mask;
+}
+
+void
+on_wand_tolerance_value_changed ( GtkRange *range, gpointer data )
+{
+    g_wand_tolerance = (gint)gtk_range_get_value ( range );
+}
+
+void
+on_wand_contiguous_toggled ( GtkToggleButton *button, gpointer data )
+{
+    g_wand_contiguous = gtk_toggle_button_get_active ( button );
+}
@@ -28,7 +28,8 @@
 #include "cv_drawing.h"
 #include "file.h"
 #include "undo.h"
-#include "gp_point_array.h"
+#include "gp_shape.h"
+#include "gp_dab.h"
 
 
 
@@ -41,6 +42,8 @@ static void		draw			( void );
 static void		reset			( void );
 static void		destroy			( gpointer data  );
 static void     save_undo       ( void );
+static void     update_shape    ( void );
+static void     draw_in_pixmap  ( GdkDrawable *drawable, GdkRegion *area );
 
 /*private data*/
 typedef struct {
@@ -48,6 +51,8 @@ typedef struct {
 	gp_canvas *		cv;
 	GdkGC *			gc;
 	gint 			x0,y0,x1,y1;
+    gp_span_list    *outline;
+    GdkRegion       *preview;
 	guint			button;
 	gboolean 		is_draw;
 } private_data;
@@ -64,12 +69,15 @@ create_private_data( void )
 		m_priv->gc		=	NULL;
 		m_priv->button	=	0;
 		m_priv->is_draw	=	FALSE;
+        m_priv->outline =   gp_span_list_new ();
 	}
 }
 
 static void
 destroy_private_data( void )
 {
+    gp_span_list_free ( m_priv->outline );
+    if ( m_priv->preview != NULL ) gdk_region_destroy ( m_priv->preview );
 	g_slice_free (private_data, m_priv);
 	m_priv = NULL;
 }
@@ -111,6 +119,7 @@ button_press ( GdkEventButton *event )
 		}
 		m_priv->x0 = m_priv->x1 = (gint)event->x;
 		m_priv->y0 = m_priv->y1 = (gint)event->y;
+        update_shape ();
         gtk_widget_queue_draw ( m_priv->cv->widget );
 	}
 	return TRUE;
@@ -126,7 +135,7 @@ button_release ( GdkEventButton *event )
 			if( m_priv->is_draw )
              {
                 save_undo ();
-				gdk_draw_line ( m_priv->cv->pixmap, m_priv->gc, m_priv->x0, m_priv->y0, m_priv->x1, m_priv->y1 );
+				draw_in_pixmap ( m_priv->cv->pixmap, NULL );
 				file_set_unsave ();
     		}
 			gtk_widget_queue_draw ( m_priv->cv->widget );
@@ -143,7 +152,7 @@ button_motion ( GdkEventMotion *event )
 	{
 		m_priv->x1 = (gint)event->x;
 		m_priv->y1 = (gint)event->y;
-		gtk_widget_queue_draw ( m_priv->cv->widget );
+        update_shape ();
 	}
 	return TRUE;
 }
@@ -153,7 +162,7 @@ draw ( void )
 {
 	if ( m_priv->is_draw )
 	{
-        gdk_draw_line ( m_priv->cv->drawing, m_priv->gc, m_priv->x0, m_priv->y0, m_priv->x1, m_priv->y1 );
+        draw_in_pixmap ( m_priv->cv->drawing, m_priv->cv->expose );
 	}
 }
 
@@ -172,29 +181,36 @@ void destroy ( gpointer data  )
 	g_print("line tool destroy\n");
 }
 
+static void
+update_shape ( void )
+{
+    GdkRectangle    clip;
+    GdkPoint        points[2];
+    gp_stroke_style style;
+
+    points[0].x = m_priv->x0;
+    points[0].y = m_priv->y0;
+    points[1].x = m_priv->x1;
+    points[1].y = m_priv->y1;
+    cv_get_rect_size ( &clip );
+    gp_stroke_style_from_gc ( &style, m_priv->gc );
+    gp_shape_stroke_polyline ( m_priv->outline, &clip, points, 2, FALSE,
+                               &style );
+    cv_update_preview ( &m_priv->preview,
+                        gp_shape_damage ( NULL, m_priv->outline ) );
+}
+
+static void
+draw_in_pixmap ( GdkDrawable *drawable, GdkRegion *area )
+{
+    GdkColormap *colormap = gtk_widget_get_colormap ( m_priv->cv->widget );
+    gp_shape_render ( drawable, m_priv->cv->pixmap, m_priv->gc, area, NULL, 0,
+                      m_priv->outline, gp_dab_color_from_gc ( m_priv->gc, colormap ) );
+}
+
 static void     
 save_undo ( void )
 {
-    GdkRectangle    rect;
-    GdkRectangle    rect_max;
-    GdkBitmap       *mask;
-    GdkGC	        *gc_mask;
-    gp_point_array  *pa  = gp_point_array_new ();
-
-    gp_point_array_append (pa, m_priv->x0, m_priv->y0 );
-    gp_point_array_append (pa, m_priv->x1, m_priv->y1 );
-
-    cv_get_rect_size ( &rect_max );
-    gp_point_array_get_clipbox ( pa, &rect, m_priv->cv->line_width, &rect_max );
-     
-    undo_create_mask ( rect.width, rect.height, &mask, &gc_mask );
-    gdk_draw_line ( mask, gc_mask, 
-                    m_priv->x0 - rect.x, m_priv->y0 - rect.y,
-                    m_priv->x1 - rect.x, m_priv->y1 - rect.y );
-    undo_add ( &rect, mask, NULL, TOOL_LINE );
-
-    gp_point_array_free (pa);
-    g_object_unref (gc_mask);
-    g_object_unref (mask);
+    undo_add_shape ( NULL, m_priv->outline, TOOL_LINE );
 }
 
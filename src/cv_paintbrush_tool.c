@@ -25,9 +25,12 @@
 #include "file.h"
 #include "gp-image.h"
 #include "toolbar.h"
+#include "gp_dab.h"
+#include "gp_stroke.h"
+#include "gp_stabilizer.h"
+#include "gp_brush_library.h"
 
-#define BRUSH_WIDTH		17
-#define BRUSH_HEIGHT	17
+#define BRUSH_WIDTH		17	/* default large size */
 
 typedef enum{
 	GP_BRUSH_TYPE_ROUND,
@@ -44,59 +47,27 @@ static const double EPSILON = 0.00001;
 /* TODO: These should be part of gp_canvas */
 static gint g_prev_brush_size = GP_BRUSH_ROUND_LARGE;
 static gint g_brush_type = GP_BRUSH_TYPE_ROUND;
+static gint g_brush_size = BRUSH_WIDTH;	/* large size in pixels, medium and small follow */
+static gint g_brush_hardness = 100;	/* percent */
+static gint g_brush_opacity = 100;	/* percent */
+static gint g_brush_flow = 100;		/* percent */
+static gint g_brush_stabilizer = 0;	/* lazy mouse radius in pixels */
+static gboolean g_brush_smooth = FALSE;
 
-/* Test XPM for pixbuf brush */
-const char * happyface_xpm[] = {
-"30 30 3 1",
-" 	c None",
-".	c #000000",
-"+	c #FFFF00",
-"           ........           ",
-"        ...++++++++...        ",
-"       ..++++++++++++..       ",
-"     ..++++++++++++++++..     ",
-"    ..++++++++++++++++++..    ",
-"   ..++++++++++++++++++++..   ",
-"   .++++++++++++++++++++++.   ",
-"  .++++++..++++++++..++++++.  ",
-" ..+++++....++++++....+++++.. ",
-" .+++++......++++......+++++. ",
-" .+++++......++++......+++++. ",
-".++++++......++++......++++++.",
-".++++++......++++......++++++.",
-".+++++++....++++++....+++++++.",
-".++++++++..++++++++..++++++++.",
-".++++++++++++++++++++++++++++.",
-".++++++++++++++++++++++++++++.",
-".++++++++++++++++++++++++++++.",
-".+++++.++++++++++++++++.+++++.",
-" .+++++.++++++++++++++.+++++. ",
-" .++++++..++++++++++..++++++. ",
-" ..+++++++..++++++..+++++++.. ",
-"  .+++++++++......+++++++++.  ",
-"   .++++++++++++++++++++++.   ",
-"   ..++++++++++++++++++++..   ",
-"    ..++++++++++++++++++..    ",
-"     ..++++++++++++++++..     ",
-"       ..++++++++++++..       ",
-"        ...++++++++...        ",
-"           ........           "};
-static GdkPixbuf *g_pixbuf = NULL;
+static gint g_brush_image = -1;		/* brush library index, -1 for none */
 
 static void brush_interpolate(GdkDrawable *drawable, DrawBrushFunc *draw_brush_func, int x, int y);
 static GdkCursor *create_brush_cursor(GPBrushType type);
 static void set_brush_values(GPBrushType type, GPBrushSize size);
 static void set_brush_size(GPBrushSize size);
+static void set_brush_cursor(void);
+static GPBrushType shaped_brush_type(GPBrushSize size);
 static GdkGC *color_for_alphaing(GtkWidget *widget, GdkGC *fg, GdkGC *bg);
 static void brush_set_pixel(GdkPixbuf *pixbuf, gint color, gint x, gint y);
 static void draw_crosshair(GdkPixbuf *pixbuf, GPBrushType type);
 
 /* Private drawing functions */
-static void draw_round_brush(GdkDrawable *drawable, int x, int y);
-static void draw_rectangular_brush(GdkDrawable *drawable, int x, int y);
-static void draw_back_slash_brush(GdkDrawable *drawable, int x, int y);
-static void draw_fwd_slash_brush(GdkDrawable *drawable, int x, int y);
-static void draw_pixbuf_brush(GdkDrawable *drawable, int x, int y);
+static void queue_dab(GdkDrawable *drawable, int x, int y);
 
 /*Member functions*/
 static gboolean	button_press	( GdkEventButton *event );
@@ -105,7 +76,8 @@ static gboolean	button_motion	( GdkEventMotion *event );
 static void		draw			( void );
 static void		reset			( void );
 static void		destroy			( gpointer data  );
-static void		draw_in_pixmap	( GdkDrawable *drawable );
+static void		draw_in_pixmap	( GdkDrawable *drawable,
+								  const GdkPoint *points, gint n );
 static void     save_undo       ( void );
 
 /*private data*/
@@ -114,7 +86,6 @@ typedef struct {
 	gp_canvas *		cv;
 	GdkGC *			gc;
 	gint 			x0,y0;
-	gint			x_min,y_min,x_max,y_max;
 	guint			button;
 	gboolean 		is_draw;
 	double			spacing;        
@@ -122,50 +93,22 @@ typedef struct {
     GdkPoint		drag;
     DrawBrushFunc	*draw_brush;
     GPBrushType		brush_type;
+    gp_dab_shape	dab_shape;
+    const gp_dab_mask *	image_dab;	/* GP_BRUSH_TYPE_PIXBUF */
+    GArray *		dabs;		/* dab centers not yet rendered */
+    gp_dab_stroke *	stroke;
     gint			width, height; /* Brush width & height */
-    GdkPixmap *		bg_pixmap;
+    gp_stroke *		backup;		/* canvas tiles under the stroke */
+    gp_stabilizer *	stabilizer;
 } private_data;
 
 static private_data		*m_priv = NULL;
 
 static void
-destroy_background ( void )
+destroy_backup ( void )
 {
-    if (m_priv->bg_pixmap != NULL) 
-    {
-        g_object_unref (m_priv->bg_pixmap);
-        m_priv->bg_pixmap = NULL;
-    }
-}
-
-static void
-save_background ( void )
-{
-	gint w,h;
-    destroy_background ();
-	gdk_drawable_get_size ( m_priv->cv->pixmap, &w, &h );
-	m_priv->bg_pixmap = gdk_pixmap_new ( m_priv->cv->drawing, w, h, -1);
-	gdk_draw_drawable (	m_priv->bg_pixmap,
-		            	m_priv->cv->gc_fg,
-			            m_priv->cv->pixmap,
-			            0, 0,
-			            0, 0,
-			            w, h );
-}
-
-static void
-restore_background ( void )
-{
-    if ( m_priv->bg_pixmap != NULL )
-    {
-	    gdk_draw_drawable (	m_priv->cv->pixmap,
-		                	m_priv->cv->gc_fg,
-			                m_priv->bg_pixmap,
-			                0, 0,
-			                0, 0,
-			                -1, -1 );
-        destroy_background ();
-    }    
+    gp_stroke_free (m_priv->backup);
+    m_priv->backup = NULL;
 }
 
 static void
@@ -180,9 +123,10 @@ create_private_data( void )
 		m_priv->is_draw		=	FALSE;
 		m_priv->distance	=	0;
 		m_priv->brush_type	=	g_brush_type; /* change type here to test other brushes */
-		m_priv->width		=	BRUSH_WIDTH;
-		m_priv->height		=	BRUSH_HEIGHT;
-        m_priv->bg_pixmap   =   NULL;
+		m_priv->width		=	g_brush_size;
+		m_priv->height		=	g_brush_size;
+        m_priv->backup      =   NULL;
+		m_priv->dabs		=	g_array_new (FALSE, FALSE, sizeof(GdkPoint));
 
 		set_brush_values(m_priv->brush_type, g_prev_brush_size);
 	}
@@ -191,7 +135,10 @@ create_private_data( void )
 static void
 destroy_private_data( void )
 {
-    destroy_background ();
+    destroy_backup ();
+	gp_dab_stroke_free (m_priv->stroke);
+	gp_stabilizer_free (m_priv->stabilizer);
+	g_array_free (m_priv->dabs, TRUE);
 	g_slice_free (private_data, m_priv);
 	m_priv = NULL;
 }
@@ -227,21 +174,31 @@ button_press ( GdkEventButton *event )
 		m_priv->is_draw = !m_priv->is_draw;
 		if( m_priv->is_draw )
 		{
+			gint w, h;
 			m_priv->button = event->button;
-            save_background();
+            destroy_backup ();
+            m_priv->backup = gp_stroke_new (m_priv->cv);
+			gdk_drawable_get_size ( m_priv->cv->pixmap, &w, &h );
+			gp_dab_stroke_free (m_priv->stroke);
+			m_priv->stroke = NULL;
+			if (g_brush_opacity < 100 || g_brush_flow < 100)
+			{
+				m_priv->stroke = gp_dab_stroke_new (w, h, g_brush_opacity / 100.0,
+				                                    g_brush_flow / 100.0);
+			}
+			gp_stabilizer_free (m_priv->stabilizer);
+			m_priv->stabilizer = gp_stabilizer_new (g_brush_stabilizer, g_brush_smooth,
+			                                        event->x, event->y);
 		}
         else
         {
-            restore_background ();
+            gp_stroke_restore (m_priv->backup);
+            destroy_backup ();
         }
 		m_priv->drag.x = (gint)event->x;
 		m_priv->drag.y = (gint)event->y;
 		m_priv->x0 = m_priv->drag.x;
 		m_priv->y0 = m_priv->drag.y;
-        m_priv->x_min = G_MAXINT;
-        m_priv->x_max = G_MININT;
-		m_priv->y_min = G_MAXINT;
-        m_priv->y_max = G_MININT;
 
 		if( !m_priv->is_draw )
 		{
@@ -260,10 +217,17 @@ button_release ( GdkEventButton *event )
 		{
 			if( m_priv->is_draw )
 			{
-				draw_in_pixmap (m_priv->cv->pixmap);
+				const GdkPoint *points;
+				gint n;
+				points = gp_stabilizer_end (m_priv->stabilizer, &n);
+				draw_in_pixmap (m_priv->cv->pixmap, points, n);
                 save_undo ();
 				file_set_unsave ();
 			}
+			gp_dab_stroke_free (m_priv->stroke);
+			m_priv->stroke = NULL;
+			gp_stabilizer_free (m_priv->stabilizer);
+			m_priv->stabilizer = NULL;
 			gtk_widget_queue_draw ( m_priv->cv->widget );
 			m_priv->is_draw = FALSE;
 		}
@@ -276,6 +240,8 @@ button_motion ( GdkEventMotion *event )
 {
 	GdkModifierType state;
 	gint x, y;
+	const GdkPoint *points;
+	gint n;
 
 	if( m_priv->is_draw )
 	{
@@ -292,7 +258,8 @@ button_motion ( GdkEventMotion *event )
 		}
 		m_priv->x0 = x;
 		m_priv->y0 = y;
-		gtk_widget_queue_draw ( m_priv->cv->widget );
+		points = gp_stabilizer_add (m_priv->stabilizer, x, y, &n);
+		draw_in_pixmap ( m_priv->cv->pixmap, points, n );
 	}
 	return TRUE;
 }
@@ -300,10 +267,7 @@ button_motion ( GdkEventMotion *event )
 static void	
 draw ( void )
 {
-	if ( m_priv->is_draw )
-	{
-		draw_in_pixmap ( m_priv->cv->pixmap );
-	}
+	/* dabs go straight into the pixmap from button_motion */
 }
 
 static void 
@@ -328,19 +292,48 @@ static void
 destroy ( gpointer data  )
 {
 	destroy_private_data ();
-	if(GDK_IS_PIXBUF(g_pixbuf))
-	{
-		g_object_unref(g_pixbuf);
-	}
+	gp_dab_mask_cache_clear ();
 	g_print("paintbrush tool destroy\n");
 }
 
+/* Lay dabs along the new points of the (stabilized) stroke */
 static void
-draw_in_pixmap ( GdkDrawable *drawable )
+draw_in_pixmap ( GdkDrawable *drawable, const GdkPoint *points, gint n )
 {
-	brush_interpolate(drawable, m_priv->draw_brush, m_priv->x0, m_priv->y0);
-	m_priv->drag.x = m_priv->x0;
-	m_priv->drag.y = m_priv->y0;
+	gint i;
+
+	g_array_set_size (m_priv->dabs, 0);
+	for (i = 0; i < n; i++)
+	{
+		brush_interpolate(drawable, m_priv->draw_brush, points[i].x, points[i].y);
+		m_priv->drag = points[i];
+	}
+
+	if (m_priv->dabs->len > 0)
+	{
+		const gp_dab_mask *mask;
+		GdkRectangle rect;
+		guint color;
+
+		color = gp_dab_color_from_gc (m_priv->gc,
+		                              gtk_widget_get_colormap (m_priv->cv->widget));
+		if (GP_BRUSH_TYPE_PIXBUF == m_priv->brush_type)
+		{
+			mask = m_priv->image_dab;
+		}
+		else
+		{
+			mask = gp_dab_mask_get (m_priv->dab_shape, m_priv->width, m_priv->height,
+			                        g_brush_hardness);
+		}
+		rect  = gp_dab_render (drawable, m_priv->gc, m_priv->stroke, mask, color,
+		                       (GdkPoint *)m_priv->dabs->data, m_priv->dabs->len);
+		if (rect.width > 0 && rect.height > 0)
+		{
+			gtk_widget_queue_draw_area (m_priv->cv->widget, rect.x, rect.y,
+			                            rect.width, rect.height);
+		}
+	}
 }
 
 /* Create a new cursor after fg color change */
@@ -405,10 +398,10 @@ brush_interpolate(GdkDrawable *drawable, DrawBrushFunc *draw_brush_func, int x,
 			x = (int)(m_priv->drag.x + percent * dx);
 			y = (int)(m_priv->drag.y + percent * dy);
 
-		    if (m_priv->x_min>x)m_priv->x_min=x;
-		    if (m_priv->x_max<x)m_priv->x_max=x;
-		    if (m_priv->y_min>y)m_priv->y_min=y;
-		    if (m_priv->y_max<y)m_priv->y_max=y;
+			/* slash masks reach one column past the brush width */
+			gp_stroke_touch (m_priv->backup, x - m_priv->width / 2,
+			                 y - m_priv->height / 2,
+			                 m_priv->width + 1, m_priv->height + 1);
             
 			draw_brush_func(drawable, x, y);
 		}
@@ -416,67 +409,13 @@ brush_interpolate(GdkDrawable *drawable, DrawBrushFunc *draw_brush_func, int x,
 	 m_priv->distance = final;
 }
 
-/* m_priv->spacing = 2.0 is best for this brush */
-static void draw_round_brush(GdkDrawable *drawable, int x, int y)
-{
-	x -= (m_priv->width / 2);
-	y -= (m_priv->height / 2);
-
-	gdk_draw_arc( drawable, m_priv->gc, TRUE, x, y, m_priv->width, m_priv->height, 0, 360 * 64);
-}
-
-/* m_priv->spacing = 2.0 is best for this brush */
-static void draw_rectangular_brush(GdkDrawable *drawable, int x, int y)
-{
-	x -= (m_priv->width / 2);
-	y -= (m_priv->height / 2);
-
-	gdk_draw_rectangle( drawable, m_priv->gc, TRUE, x, y, m_priv->width, m_priv->height);
-}
-
-/* m_priv->spacing = 1.0 is best for this brush */
-static void draw_back_slash_brush(GdkDrawable *drawable, int x, int y)
+/* Collect the dab, all of them are rendered at once by draw_in_pixmap */
+static void queue_dab(GdkDrawable *drawable, int x, int y)
 {
-    gint w, h;
-   
-    w = m_priv->width - 1;
-    h = m_priv->height - 1;
-   
-    x -= (m_priv->width / 2);
-    y -= (m_priv->height / 2);
-
-    gdk_draw_line(drawable, m_priv->gc, x, y, x + w, y + h);
-    /* Draw another line to fill in gaps */
-    gdk_draw_line(drawable, m_priv->gc, x + 1, y, x + w, y + h - 1);
+	GdkPoint p = { x, y };
+	g_array_append_val (m_priv->dabs, p);
 }
 
-/* m_priv->spacing = 1.0 is best for this brush */
-static void draw_fwd_slash_brush(GdkDrawable *drawable, int x, int y)
-{
-    gint w, h;
-   
-    w = m_priv->width - 1;
-    h = m_priv->height - 1;
-   
-    x -= (m_priv->width / 2);
-    y -= (m_priv->height / 2);
-   
-    gdk_draw_line(drawable, m_priv->gc, x , y + h, x + w, y);
-    /* Draw another line to fill in gaps */
-    gdk_draw_line(drawable, m_priv->gc, x + 1 , y + h, x + w, y + 1);
-}
-
-/* m_priv->spacing = gdk_get_pixbuf_width() and you get nice tiling effect */
-static void draw_pixbuf_brush(GdkDrawable *drawable, int x, int y)
-{
-	x -= (m_priv->width / 2);
-	y -= (m_priv->height / 2);
-
-	gdk_draw_pixbuf(drawable, m_priv->gc, g_pixbuf, 0, 0, x, y,
-					-1, -1, GDK_RGB_DITHER_NONE, 0, 0);
-}
-
-/* TODO: Finish up GP_BRUSH_TYPE_PIXBUF cursor */
 #define MIN_CURSOR_WIDTH	19
 #define MIN_CURSOR_HEIGHT	MIN_CURSOR_WIDTH
 #define CENTERED(a,b)	(((a)/(2))-((b)/(2)))
@@ -492,6 +431,12 @@ static GdkCursor *create_brush_cursor(GPBrushType type)
 	gint wcur = MIN_CURSOR_WIDTH;
 	gint hcur = MIN_CURSOR_HEIGHT;
 
+	/* Image brushes use the crosshair */
+	if(GP_BRUSH_TYPE_PIXBUF == type)
+	{
+		return NULL;
+	}
+
 	if(m_priv->width > wcur){
 		wcur = m_priv->width;
 	}
@@ -556,10 +501,6 @@ static GdkCursor *create_brush_cursor(GPBrushType type)
 							wcur / 2 +  m_priv->width / 2, 
 							hcur / 2 +  m_priv->height / 2 );
 			break;
-		case GP_BRUSH_TYPE_PIXBUF:
-			gdk_draw_pixbuf( pixmap, m_priv->cv->gc_fg_pencil, g_pixbuf,
-							 0, 0, 0, 0, -1, -1, GDK_RGB_DITHER_NONE, 0, 0 );
-			break;
 		default:
 			printf("Debug: create_brush_cursor() unknown brush type: %d\n", type);
 			break;
@@ -619,24 +560,8 @@ static GdkCursor *create_brush_cursor(GPBrushType type)
 static void     
 save_undo ( void )
 {
-
-	gint w,h;
-	GdkRectangle rect;
-	
-	rect.x		=	m_priv->x_min - m_priv->width/2;
-	rect.y		=	m_priv->y_min - m_priv->height/2;
-	rect.width	=	m_priv->x_max - m_priv->x_min + m_priv->width;
-	rect.height	=	m_priv->y_max - m_priv->y_min + m_priv->height;
-
-	if (rect.x<0) rect.x = 0;
-	if (rect.y<0) rect.y = 0;
-	gdk_drawable_get_size ( m_priv->cv->pixmap, &w, &h );
-	if (rect.width>w) rect.width=w;
-	if (rect.height>h) rect.height=h;
-
-    undo_add ( &rect, NULL, m_priv->bg_pixmap, TOOL_PAINTBRUSH);
-
-	
+    gp_stroke_save_undo (m_priv->backup, TOOL_PAINTBRUSH);
+    destroy_backup ();
 	g_print ("save_undo\n");
 	
 }
@@ -644,14 +569,17 @@ save_undo ( void )
 void on_brush_size_toggled(GtkWidget *widget, gpointer data)
 {
 	static gint size;
-	GdkCursor *cursor;
- 
 	if(NULL != data)
 	{
 		size = *((gint *)data);
 		if(g_prev_brush_size != size)
 		{
-			if((size >= GP_BRUSH_RECT_LARGE) && (size <= GP_BRUSH_RECT_SMALL))
+			if(g_brush_image >= 0)
+			{
+				/* image brushes only take the size from the buttons */
+				set_brush_values(GP_BRUSH_TYPE_PIXBUF, size);
+			}
+			else if((size >= GP_BRUSH_RECT_LARGE) && (size <= GP_BRUSH_RECT_SMALL))
 			{
 				set_brush_values(GP_BRUSH_TYPE_ROUND, size);
 			}
@@ -673,57 +601,118 @@ void on_brush_size_toggled(GtkWidget *widget, gpointer data)
 			}
  
 			g_prev_brush_size = *((gint *)data);
-	
-			cursor = create_brush_cursor(m_priv->brush_type);
-	
-			if(!cursor)
-			{
-				cursor = gdk_cursor_new ( GDK_CROSSHAIR );
-				g_assert(cursor);
-			}
-			gdk_window_set_cursor ( m_priv->cv->drawing, cursor );
-			gdk_cursor_unref( cursor );
+			set_brush_cursor();
 		}
 		
 	}
 }
  
+void on_brush_size_value_changed(GtkRange *range, gpointer data)
+{
+	g_brush_size = (gint)gtk_range_get_value(range);
+	if ( m_priv == NULL || m_priv->brush_type == GP_BRUSH_TYPE_PIXBUF ) return;
+
+	set_brush_size(g_prev_brush_size);
+	set_brush_cursor();
+}
+
+void on_brush_hardness_value_changed(GtkRange *range, gpointer data)
+{
+	g_brush_hardness = (gint)gtk_range_get_value(range);
+}
+
+void on_brush_opacity_value_changed(GtkRange *range, gpointer data)
+{
+	g_brush_opacity = (gint)gtk_range_get_value(range);
+}
+
+void on_brush_flow_value_changed(GtkRange *range, gpointer data)
+{
+	g_brush_flow = (gint)gtk_range_get_value(range);
+}
+
+void on_brush_image_changed(GtkComboBox *combo, gpointer data)
+{
+	/* first entry is the shaped brushes */
+	g_brush_image = gtk_combo_box_get_active(combo) - 1;
+	if ( m_priv == NULL ) return;
+
+	if(g_brush_image >= 0)
+	{
+		set_brush_values(GP_BRUSH_TYPE_PIXBUF, g_prev_brush_size);
+	}
+	else
+	{
+		set_brush_values(shaped_brush_type(g_prev_brush_size), g_prev_brush_size);
+	}
+	set_brush_cursor();
+}
+
+void on_brush_stabilizer_value_changed(GtkRange *range, gpointer data)
+{
+	g_brush_stabilizer = (gint)gtk_range_get_value(range);
+}
+
+void on_brush_smooth_toggled(GtkToggleButton *button, gpointer data)
+{
+	g_brush_smooth = gtk_toggle_button_get_active(button);
+}
+
 static void set_brush_values(GPBrushType type, GPBrushSize size)
 {
 	switch(type)
 		{
 			case GP_BRUSH_TYPE_ROUND:
 				m_priv->brush_type  =   type;
-				m_priv->draw_brush	=	draw_round_brush;
+				m_priv->dab_shape	=	GP_DAB_ROUND;
+				m_priv->draw_brush	=	queue_dab;
 				m_priv->spacing 	=	2.0;
 				set_brush_size(size);
 				break;
 			case GP_BRUSH_TYPE_RECTANGLE:
 				m_priv->brush_type  =   type;
-				m_priv->draw_brush	=	draw_rectangular_brush;
+				m_priv->dab_shape	=	GP_DAB_SQUARE;
+				m_priv->draw_brush	=	queue_dab;
 				m_priv->spacing 	=	2.0;
 				set_brush_size(size);
 				break;
 			case GP_BRUSH_TYPE_FWRD_SLASH:
 				m_priv->brush_type  =   type;
-				m_priv->draw_brush	=	draw_fwd_slash_brush;
+				m_priv->dab_shape	=	GP_DAB_FWD_SLASH;
+				m_priv->draw_brush	=	queue_dab;
 				m_priv->spacing 	=	1.0;
 				set_brush_size(size);
 				break;
 			case GP_BRUSH_TYPE_BACK_SLASH:
 				m_priv->brush_type  =   type;
-				m_priv->draw_brush	=	draw_back_slash_brush;
+				m_priv->dab_shape	=	GP_DAB_BACK_SLASH;
+				m_priv->draw_brush	=	queue_dab;
 				m_priv->spacing 	=	1.0;
 				set_brush_size(size);
 				break;
 			case GP_BRUSH_TYPE_PIXBUF:
+			{
+				/* large, medium and small follow each other in GPBrushSize */
+				static const gint image_size[3] = { 64, 32, 16 };
+				const gp_dab_mask *dab = NULL;
+				if(g_brush_image >= 0)
+				{
+					dab = gp_brush_library_get_dab(g_brush_image, image_size[size % 3]);
+				}
+				if(dab == NULL)
+				{
+					g_brush_image = -1;
+					set_brush_values(shaped_brush_type(size), size);
+					return;
+				}
 				m_priv->brush_type  =   type;
-				g_pixbuf = gdk_pixbuf_new_from_xpm_data(happyface_xpm);
-				m_priv->draw_brush	=	draw_pixbuf_brush;
-				m_priv->spacing 	=	gdk_pixbuf_get_width(g_pixbuf);
-				m_priv->width		=	gdk_pixbuf_get_width(g_pixbuf);
-				m_priv->height		=	gdk_pixbuf_get_height(g_pixbuf);
+				m_priv->image_dab	=	dab;
+				m_priv->draw_brush	=	queue_dab;
+				m_priv->width		=	dab->width;
+				m_priv->height		=	dab->height;
+				m_priv->spacing 	=	MAX(1.0, MAX(dab->width, dab->height) / 4.0);
 				break;
+			}
 			default:
 				printf("Debug: brush set_brush_values() unknown brush type %d\n", m_priv->brush_type);
 				break;
@@ -732,6 +721,18 @@ static void set_brush_values(GPBrushType type, GPBrushSize size)
 	g_brush_type = type;
 }
 
+/* Brush type of the size buttons, same mapping as on_brush_size_toggled */
+static GPBrushType shaped_brush_type(GPBrushSize size)
+{
+	static const GPBrushType types[4] = {
+		GP_BRUSH_TYPE_ROUND,
+		GP_BRUSH_TYPE_RECTANGLE,
+		GP_BRUSH_TYPE_FWRD_SLASH,
+		GP_BRUSH_TYPE_BACK_SLASH
+	};
+	return types[CLAMP(size / 3, 0, 3)];
+}
+
 static void set_brush_size(GPBrushSize size)
 {
 	switch(size)
@@ -740,22 +741,22 @@ static void set_brush_size(GPBrushSize size)
 			case GP_BRUSH_ROUND_LARGE:	/* Fall through*/
 			case GP_BRUSH_FWRD_LARGE:	/* Fall through*/
 			case GP_BRUSH_BACK_LARGE:
-				m_priv->width  = BRUSH_WIDTH;
-				m_priv->height = BRUSH_HEIGHT;
+				m_priv->width  = g_brush_size;
+				m_priv->height = g_brush_size;
 				break;
 			case GP_BRUSH_RECT_MEDIUM:	/* Fall through*/
 			case GP_BRUSH_ROUND_MEDIUM:	/* Fall through*/
 			case GP_BRUSH_FWRD_MEDIUM:	/* Fall through*/
 			case GP_BRUSH_BACK_MEDIUM:
-				m_priv->width = BRUSH_WIDTH / 2;
-				m_priv->height = BRUSH_WIDTH / 2;
+				m_priv->width = MAX(1, g_brush_size / 2);
+				m_priv->height = MAX(1, g_brush_size / 2);
 				break;
 			case GP_BRUSH_RECT_SMALL:	/* Fall through*/
 			case GP_BRUSH_ROUND_SMALL:	/* Fall through*/
 			case GP_BRUSH_FWRD_SMALL:	/* Fall through*/
 			case GP_BRUSH_BACK_SMALL:	/* Fall through*/
-				m_priv->width = BRUSH_WIDTH / 4;
-				m_priv->height = BRUSH_WIDTH / 4;
+				m_priv->width = MAX(1, g_brush_size / 4);
+				m_priv->height = MAX(1, g_brush_size / 4);
 				break;
 			default:
 				return;
@@ -770,6 +771,21 @@ static void set_brush_size(GPBrushSize size)
 	}
 }
 
+/* Cursor of the current brush, the crosshair if it has none */
+static void set_brush_cursor(void)
+{
+	GdkCursor *cursor;
+
+	cursor = create_brush_cursor(m_priv->brush_type);
+	if(!cursor)
+	{
+		cursor = gdk_cursor_new ( GDK_CROSSHAIR );
+		g_assert(cursor);
+	}
+	gdk_window_set_cursor ( m_priv->cv->drawing, cursor );
+	gdk_cursor_unref( cursor );
+}
+
 /* Create a gc if the current fore and back colors are the same
  */
 static GdkGC *color_for_alphaing(GtkWidget *widget, GdkGC *fg, GdkGC *bg)
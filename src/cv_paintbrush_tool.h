@@ -43,5 +43,12 @@ gp_tool * tool_paintbrush_init ( gp_canvas * canvas );
 void notify_brush_of_fg_color_change(void);
 
 void on_brush_size_toggled(GtkWidget *widget, gpointer data);
+void on_brush_size_value_changed(GtkRange *range, gpointer data);
+void on_brush_hardness_value_changed(GtkRange *range, gpointer data);
+void on_brush_opacity_value_changed(GtkRange *range, gpointer data);
+void on_brush_flow_value_changed(GtkRange *range, gpointer data);
+void on_brush_image_changed(GtkComboBox *combo, gpointer data);
+void on_brush_stabilizer_value_changed(GtkRange *range, gpointer data);
+void on_brush_smooth_toggled(GtkToggleButton *button, gpointer data);
 
 #endif
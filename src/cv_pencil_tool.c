@@ -24,9 +24,8 @@
  #include <gtk/gtk.h>
 
 #include "cv_pencil_tool.h"
-#include "gp_point_array.h"
-#include "undo.h"
 #include "file.h"
+#include "gp_stroke.h"
 
 /*Member functions*/
 static gboolean	button_press	( GdkEventButton *event );
@@ -35,7 +34,7 @@ static gboolean	button_motion	( GdkEventMotion *event );
 static void		draw			( void );
 static void		reset			( void );
 static void		destroy			( gpointer data  );
-static void		draw_in_pixmap	( GdkDrawable *drawable );
+static void		draw_segment	( gint x, gint y );
 static void     save_undo       ( void );
 
 
@@ -44,7 +43,8 @@ typedef struct {
 	gp_tool			tool;
 	gp_canvas *		cv;
 	GdkGC *			gc;
-    gp_point_array  *pa;
+    GdkPoint        last;       /* end of the stroke drawn so far */
+    gp_stroke       *backup;    /* canvas tiles under the stroke */
 	guint			button;
 	gboolean 		is_draw;
 } private_data;
@@ -60,7 +60,7 @@ create_private_data( void )
 		m_priv->cv		=	NULL;
 		m_priv->gc		=	NULL;
 		m_priv->button	=	NONE_BUTTON;
-        m_priv->pa      =   gp_point_array_new();
+        m_priv->backup  =   NULL;
 		m_priv->is_draw	=	FALSE;
 	}
 }
@@ -68,7 +68,7 @@ create_private_data( void )
 static void
 destroy_private_data( void )
 {
-    gp_point_array_free( m_priv->pa );
+    gp_stroke_free ( m_priv->backup );
 	g_free (m_priv);
 	m_priv = NULL;
 }
@@ -102,10 +102,22 @@ button_press ( GdkEventButton *event )
 			m_priv->gc = m_priv->cv->gc_bg_pencil;
 		}
 		m_priv->is_draw = !m_priv->is_draw;
-		if( m_priv->is_draw ) m_priv->button = event->button;
-        gp_point_array_clear ( m_priv->pa );
-        gp_point_array_append ( m_priv->pa, (gint)event->x, (gint)event->y );
-		if( !m_priv->is_draw ) gtk_widget_queue_draw ( m_priv->cv->widget );
+        if( m_priv->is_draw )
+        {
+            m_priv->button  = event->button;
+            m_priv->backup  = gp_stroke_new ( m_priv->cv );
+            m_priv->last.x  = (gint)event->x;
+            m_priv->last.y  = (gint)event->y;
+            draw_segment ( m_priv->last.x, m_priv->last.y );
+        }
+        else
+        {
+            /* second button cancels the stroke */
+            gp_stroke_restore ( m_priv->backup );
+            gp_stroke_free ( m_priv->backup );
+            m_priv->backup = NULL;
+            gtk_widget_queue_draw ( m_priv->cv->widget );
+        }
 	}
 	return TRUE;
 }
@@ -119,14 +131,11 @@ button_release ( GdkEventButton *event )
 		{
 			if( m_priv->is_draw )
 			{
-                gp_point_array_append ( m_priv->pa, (gint)event->x, (gint)event->y );
+                draw_segment ( (gint)event->x, (gint)event->y );
                 save_undo ();
-				draw_in_pixmap (m_priv->cv->pixmap);
 				file_set_unsave ();
 			}
-			gtk_widget_queue_draw ( m_priv->cv->widget );
 			m_priv->is_draw = FALSE;
-            gp_point_array_clear ( m_priv->pa );
 		}
 	}
 	return TRUE;
@@ -137,8 +146,7 @@ button_motion ( GdkEventMotion *event )
 {
 	if( m_priv->is_draw )
 	{
-        gp_point_array_append ( m_priv->pa, (gint)event->x, (gint)event->y );
-		gtk_widget_queue_draw ( m_priv->cv->widget );
+        draw_segment ( (gint)event->x, (gint)event->y );
 	}
 	return TRUE;
 }
@@ -146,10 +154,7 @@ button_motion ( GdkEventMotion *event )
 static void	
 draw ( void )
 {
-	if ( m_priv->is_draw )
-	{
-		draw_in_pixmap (m_priv->cv->drawing);
-	}
+	/* segments go straight into the pixmap as they come */
 }
 
 static void 
@@ -169,42 +174,37 @@ destroy ( gpointer data  )
 	g_print("pencil tool destroy\n");
 }
 
+/* Draw only the segment from the last point, so each event costs the
+ * same however long the stroke already is */
 static void
-draw_in_pixmap ( GdkDrawable *drawable )
+draw_segment ( gint x, gint y )
 {
-	GdkPoint *	points		=	gp_point_array_data (m_priv->pa);
-	gint		n_points	=	gp_point_array_size (m_priv->pa);
-	gdk_draw_lines (drawable, m_priv->gc, points, n_points );
+    GdkRectangle rect;
+    rect.x      = MIN ( x, m_priv->last.x ) - 1;
+    rect.y      = MIN ( y, m_priv->last.y ) - 1;
+    rect.width  = ABS ( x - m_priv->last.x ) + 3;
+    rect.height = ABS ( y - m_priv->last.y ) + 3;
+
+    gp_stroke_touch ( m_priv->backup, rect.x, rect.y, rect.width, rect.height );
+    if ( x == m_priv->last.x && y == m_priv->last.y )
+    {
+        gdk_draw_point ( m_priv->cv->pixmap, m_priv->gc, x, y );
+    }
+    else
+    {
+        gdk_draw_line ( m_priv->cv->pixmap, m_priv->gc,
+                        m_priv->last.x, m_priv->last.y, x, y );
+    }
+    m_priv->last.x = x;
+    m_priv->last.y = y;
+    gtk_widget_queue_draw_area ( m_priv->cv->widget,
+                                 rect.x, rect.y, rect.width, rect.height );
 }
 
 static void     
 save_undo ( void )
 {
-    GdkRectangle    rect;
-    GdkRectangle    rect_max;
-    GdkBitmap       *mask;
-    GdkGC	        *gc_mask;
-    gp_point_array  *pa;
-    GdkPoint        *points;
-    gint	        n_points;
-
-    pa = gp_point_array_new ();
-    gp_point_array_copy ( m_priv->pa, pa );
-    points 		=	gp_point_array_data ( pa );
-    n_points	=	gp_point_array_size ( pa );
-
-    cv_get_rect_size ( &rect_max );
-    gp_point_array_get_clipbox ( pa, &rect, m_priv->cv->line_width, &rect_max );
-    undo_create_mask ( rect.width, rect.height, &mask, &gc_mask );
-    gp_point_array_offset ( pa, -rect.x, -rect.y);
-
-    gdk_draw_lines ( mask, gc_mask, points, n_points);
-
-    undo_add ( &rect, mask, NULL, TOOL_LINE );
-
-    gp_point_array_free ( pa );
-    g_object_unref (gc_mask);
-    g_object_unref (mask);
- }
-
-
+    gp_stroke_save_undo ( m_priv->backup, TOOL_PENCIL );
+    gp_stroke_free ( m_priv->backup );
+    m_priv->backup = NULL;
+}
@@ -26,6 +26,8 @@
 
 #include "cv_polygon_tool.h"
 #include "gp_point_array.h"
+#include "gp_shape.h"
+#include "gp_dab.h"
 #include "undo.h"
 #include "file.h"
 
@@ -36,7 +38,8 @@ static gboolean	button_motion	( GdkEventMotion *event );
 static void		draw			( void );
 static void		reset			( void );
 static void		destroy			( gpointer data  );
-static void		draw_in_pixmap	( GdkDrawable *drawable );
+static void		draw_in_pixmap	( GdkDrawable *drawable, GdkRegion *area );
+static void     update_shape    ( void );
 static void     save_undo       ( void );
 
 /*private data*/
@@ -55,6 +58,9 @@ typedef struct {
 	guint			button;
 	gboolean 		is_draw;
     gp_point_array  *pa;
+    gp_span_list    *fill;
+    gp_span_list    *outline;
+    GdkRegion       *preview;   /* last rubber-band damage */
 	gp_poly_state	state;
 } private_data;
 
@@ -72,6 +78,8 @@ create_private_data( void )
 		m_priv->button		=	NONE_BUTTON;
 		m_priv->is_draw		=	FALSE;
         m_priv->pa          =   gp_point_array_new();
+        m_priv->fill        =   gp_span_list_new();
+        m_priv->outline     =   gp_span_list_new();
 		m_priv->state		=	POLY_NONE;		
 	}
 }
@@ -80,6 +88,9 @@ static void
 destroy_private_data( void )
 {
     gp_point_array_free( m_priv->pa );
+    gp_span_list_free( m_priv->fill );
+    gp_span_list_free( m_priv->outline );
+    if ( m_priv->preview != NULL ) gdk_region_destroy ( m_priv->preview );
 	g_free (m_priv);
 	m_priv = NULL;
 }
@@ -125,6 +136,7 @@ button_press ( GdkEventButton *event )
 				/*add two point*/
                 gp_point_array_append ( m_priv->pa, (gint)event->x, (gint)event->y );
                 gp_point_array_append ( m_priv->pa, (gint)event->x, (gint)event->y );
+                update_shape ();
                 gtk_widget_queue_draw ( m_priv->cv->widget );
 				break;
 			}
@@ -146,6 +158,7 @@ button_press ( GdkEventButton *event )
 					/*next point*/
 					m_priv->state = POLY_DRAWING;
                     gp_point_array_append ( m_priv->pa, (gint)event->x, (gint)event->y );
+                    update_shape ();
 				}
 				else
 				{
@@ -153,7 +166,7 @@ button_press ( GdkEventButton *event )
                     save_undo ();
 					m_priv->state = POLY_NONE;
 					m_priv->is_draw	= FALSE;
-					draw_in_pixmap (m_priv->cv->pixmap);
+					draw_in_pixmap (m_priv->cv->pixmap, NULL);
 					file_set_unsave ();
                     gp_point_array_clear ( m_priv->pa );
 				}
@@ -188,7 +201,7 @@ button_motion ( GdkEventMotion *event )
 	{
         gint index = gp_point_array_size ( m_priv->pa ) - 1;
         gp_point_array_set ( m_priv->pa, index, (gint)event->x, (gint)event->y );
-		gtk_widget_queue_draw ( m_priv->cv->widget );
+        update_shape ();
 	}
 	return TRUE;
 }
@@ -198,7 +211,7 @@ draw ( void )
 {
 	if ( m_priv->is_draw )
 	{
-		draw_in_pixmap (m_priv->cv->drawing);
+		draw_in_pixmap (m_priv->cv->drawing, m_priv->cv->expose);
 	}
 }
 
@@ -221,55 +234,52 @@ destroy ( gpointer data  )
 }
 
 static void
-draw_in_pixmap ( GdkDrawable *drawable )
+update_shape ( void )
+{
+    GdkRectangle    clip;
+    GdkPoint        *points     = gp_point_array_data (m_priv->pa);
+    gint            n_points    = gp_point_array_size (m_priv->pa);
+    gp_stroke_style style;
+
+    cv_get_rect_size ( &clip );
+    gp_stroke_style_from_gc ( &style, m_priv->gcf );
+    gp_span_list_clear ( m_priv->fill );
+    if ( m_priv->cv->filled != FILLED_NONE )
+    {
+        gp_shape_fill_polygon ( m_priv->fill, &clip, points, n_points,
+                                GP_FILL_EVEN_ODD );
+    }
+    gp_shape_stroke_polyline ( m_priv->outline, &clip, points, n_points, TRUE,
+                               &style );
+    cv_update_preview ( &m_priv->preview,
+                        gp_shape_damage ( m_priv->fill, m_priv->outline ) );
+}
+
+static void
+draw_in_pixmap ( GdkDrawable *drawable, GdkRegion *area )
 {
 	if ( gp_point_array_size (m_priv->pa) > 0 )
 	{
-		GdkPoint *	points		=	gp_point_array_data (m_priv->pa);
-		gint		n_points	=	gp_point_array_size (m_priv->pa);
+		GdkColormap *	colormap	=	gtk_widget_get_colormap ( m_priv->cv->widget );
+		guint			fill_color	=	0;
 		if ( m_priv->cv->filled == FILLED_BACK )
 		{
-			gdk_draw_polygon ( drawable, m_priv->gcb, TRUE, points, n_points);
+			fill_color = gp_dab_color_from_gc ( m_priv->gcb, colormap );
 		}
 		else
 		if ( m_priv->cv->filled == FILLED_FORE )
 		{
-			gdk_draw_polygon ( drawable, m_priv->gcf, TRUE, points, n_points);
+			fill_color = gp_dab_color_from_gc ( m_priv->gcf, colormap );
 		}
-		gdk_draw_polygon ( drawable, m_priv->gcf, FALSE, points, n_points);
+		gp_shape_render ( drawable, m_priv->cv->pixmap, m_priv->gcf, area,
+		                  m_priv->fill, fill_color, m_priv->outline,
+		                  gp_dab_color_from_gc ( m_priv->gcf, colormap ) );
 	}
 }
 
 static void     
 save_undo ( void )
 {
-    GdkRectangle    rect;
-    GdkRectangle    rect_max;
-    GdkBitmap       *mask;
-    GdkGC	        *gc_mask;
-    gp_point_array  *pa;
-    GdkPoint        *points;
-    gint	        n_points;
-
-    pa = gp_point_array_new ();
-    gp_point_array_copy ( m_priv->pa, pa );
-    points 		=	gp_point_array_data ( pa );
-    n_points	=	gp_point_array_size ( pa );
-
-    cv_get_rect_size ( &rect_max );
-    gp_point_array_get_clipbox ( pa, &rect, m_priv->cv->line_width, &rect_max );
-    undo_create_mask ( rect.width, rect.height, &mask, &gc_mask );
-    gp_point_array_offset ( pa, -rect.x, -rect.y);
-
-    gdk_draw_polygon ( mask, gc_mask, FALSE, points, n_points);
-    if ( m_priv->cv->filled != FILLED_NONE )
-    {
-        gdk_draw_polygon ( mask, gc_mask, TRUE, points, n_points);
-    }
-
-    undo_add ( &rect, mask, NULL, TOOL_POLYGON );
-
-    gp_point_array_free ( pa );
-    g_object_unref (gc_mask);
-    g_object_unref (mask);
- }
+    /*the fill is left empty when the polygon is not filled*/
+    undo_add_shape ( m_priv->fill, m_priv->outline, TOOL_POLYGON );
+}
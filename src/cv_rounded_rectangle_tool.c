@@ -24,10 +24,12 @@
 #include "file.h"
 #include "undo.h"
 #include "gp_point_array.h"
+#include "gp_shape.h"
+#include "gp_dab.h"
 
 
-static void draw_rounded_rectangle(GdkDrawable *drawable, GdkGC *gc, gboolean filled, gint x,
-									gint y, gint width, gint height);
+/* radius of the corner arcs, 16 pixels across as before */
+#define ARC_RADIUS	8
 
 /*Member functions*/
 static gboolean	button_press	( GdkEventButton *event );
@@ -36,7 +38,8 @@ static gboolean	button_motion	( GdkEventMotion *event );
 static void		draw			( void );
 static void		reset			( void );
 static void		destroy			( gpointer data  );
-static void		draw_in_pixmap	( GdkDrawable *drawable );
+static void		draw_in_pixmap	( GdkDrawable *drawable, GdkRegion *area );
+static void     update_shape    ( void );
 static void     save_undo       ( void );
 
 
@@ -47,6 +50,9 @@ typedef struct {
 	GdkGC *			gcf;
 	GdkGC *			gcb;
     gp_point_array  *pa;
+    gp_span_list    *fill;
+    gp_span_list    *outline;
+    GdkRegion       *preview;   /* last rubber-band damage */
 	guint			button;
 	gboolean 		is_draw;
 } private_data;
@@ -65,6 +71,8 @@ create_private_data( void )
 		m_priv->button	=	NONE_BUTTON;
 		m_priv->is_draw	=	FALSE;
         m_priv->pa      =   gp_point_array_new();
+        m_priv->fill    =   gp_span_list_new();
+        m_priv->outline =   gp_span_list_new();
         
 	}
 }
@@ -73,6 +81,9 @@ static void
 destroy_private_data( void )
 {
     gp_point_array_free( m_priv->pa );
+    gp_span_list_free( m_priv->fill );
+    gp_span_list_free( m_priv->outline );
+    if ( m_priv->preview != NULL ) gdk_region_destroy ( m_priv->preview );
 	g_free (m_priv);
 	m_priv = NULL;
 }
@@ -113,6 +124,7 @@ button_press ( GdkEventButton *event )
 		/*add two point*/
         gp_point_array_append ( m_priv->pa, (gint)event->x, (gint)event->y );
         gp_point_array_append ( m_priv->pa, (gint)event->x, (gint)event->y );
+        update_shape ();
         
 		if( !m_priv->is_draw ) gtk_widget_queue_draw ( m_priv->cv->widget );
 		gtk_widget_queue_draw ( m_priv->cv->widget );
@@ -130,7 +142,7 @@ button_release ( GdkEventButton *event )
 			if( m_priv->is_draw )
 			{
    	            save_undo ();
-				draw_in_pixmap (m_priv->cv->pixmap);
+				draw_in_pixmap (m_priv->cv->pixmap, NULL);
 				file_set_unsave ();
 			}
 			gtk_widget_queue_draw ( m_priv->cv->widget );
@@ -147,7 +159,7 @@ button_motion ( GdkEventMotion *event )
 	if( m_priv->is_draw )
 	{
         gp_point_array_set ( m_priv->pa, 1, (gint)event->x, (gint)event->y );
-		gtk_widget_queue_draw ( m_priv->cv->widget );
+        update_shape ();
 	}
 	return TRUE;
 }
@@ -157,7 +169,7 @@ draw ( void )
 {
 	if ( m_priv->is_draw )
 	{
-		draw_in_pixmap (m_priv->cv->drawing);
+		draw_in_pixmap (m_priv->cv->drawing, m_priv->cv->expose);
 	}
 }
 
@@ -179,103 +191,66 @@ destroy ( gpointer data  )
 }
 
 static void
-draw_in_pixmap ( GdkDrawable *drawable )
+update_shape ( void )
 {
-    GdkRectangle    rect;
+    GdkRectangle    clip;
     GdkPoint        *p = gp_point_array_data (m_priv->pa);
-	rect.x      = MIN(p[0].x,p[1].x);
-	rect.y      = MIN(p[0].y,p[1].y);
-	rect.width  = ABS(p[1].x-p[0].x);
-	rect.height = ABS(p[1].y-p[0].y);
+    gp_stroke_style style;
+    gint            x, y, w, h;
+
+    x   = MIN(p[0].x,p[1].x);
+    y   = MIN(p[0].y,p[1].y);
+    w   = ABS(p[1].x-p[0].x);
+    h   = ABS(p[1].y-p[0].y);
+
+    cv_get_rect_size ( &clip );
+    gp_stroke_style_from_gc ( &style, m_priv->gcf );
+    gp_span_list_clear ( m_priv->fill );
+    if ( m_priv->cv->filled != FILLED_NONE )
+    {
+        gp_shape_fill_rectangle ( m_priv->fill, &clip, x, y, w, h,
+                                  ARC_RADIUS, ARC_RADIUS );
+    }
+    gp_shape_stroke_rectangle ( m_priv->outline, &clip, x, y, w, h,
+                                ARC_RADIUS, ARC_RADIUS, &style );
+    cv_update_preview ( &m_priv->preview,
+                        gp_shape_damage ( m_priv->fill, m_priv->outline ) );
+}
 
-	if ( m_priv->cv->filled == FILLED_BACK )
-	{
-		draw_rounded_rectangle (drawable, m_priv->gcb, TRUE, rect.x, rect.y, rect.width, rect.height );
-	}
-	else
-	if ( m_priv->cv->filled == FILLED_FORE )
-	{
-		draw_rounded_rectangle (drawable, m_priv->gcf, TRUE, rect.x, rect.y, rect.width, rect.height );
-	}
-	draw_rounded_rectangle (drawable, m_priv->gcf, FALSE, rect.x, rect.y, rect.width, rect.height );
+static void
+draw_in_pixmap ( GdkDrawable *drawable, GdkRegion *area )
+{
+    GdkColormap     *colormap   = gtk_widget_get_colormap ( m_priv->cv->widget );
+    guint           fill_color  = 0;
+
+    if ( m_priv->cv->filled == FILLED_BACK )
+    {
+        fill_color = gp_dab_color_from_gc ( m_priv->gcb, colormap );
+    }
+    else
+    if ( m_priv->cv->filled == FILLED_FORE )
+    {
+        fill_color = gp_dab_color_from_gc ( m_priv->gcf, colormap );
+    }
+    gp_shape_render ( drawable, m_priv->cv->pixmap, m_priv->gcf, area,
+                      m_priv->fill, fill_color, m_priv->outline,
+                      gp_dab_color_from_gc ( m_priv->gcf, colormap ) );
 }
 
 static void     
 save_undo ( void )
 {
     GdkRectangle    rect;
-    GdkRectangle    rect_max;
-    GdkBitmap       *mask = NULL;
 
-    cv_get_rect_size ( &rect_max );
-    gp_point_array_get_clipbox ( m_priv->pa, &rect, m_priv->cv->line_width, &rect_max );
     if ( m_priv->cv->filled == FILLED_NONE )
     {
-        GdkPoint    *p = gp_point_array_data (m_priv->pa);
-        GdkGC	    *gc_mask;
-        gint        x,y,w,h;
-        x   = MIN(p[0].x,p[1].x);
-        y   = MIN(p[0].y,p[1].y);
-        w   = ABS(p[1].x-p[0].x);
-        h   = ABS(p[1].y-p[0].y);
-        undo_create_mask ( rect.width, rect.height, &mask, &gc_mask );
-        draw_rounded_rectangle ( mask, gc_mask, FALSE, 
-                             x - rect.x, y-rect.y, w, h );
-        g_object_unref (gc_mask);
-    }                
-    undo_add ( &rect, mask, NULL, TOOL_ROUNDED_RECTANGLE );
-    if ( mask != NULL ) g_object_unref (mask);
-}
-
-static void draw_rounded_rectangle(GdkDrawable *drawable, GdkGC *gc, gboolean filled, gint x,
-					   gint y, gint width, gint height)
-{
-	gint warc = 16; /* Width & height of arc rectangle */
-	gint harc = 16; /* 16 is an arbitrary number that looks good on my system */
-	
-	if((width < warc) && (height < harc)){
-		gdk_draw_arc(drawable, gc, filled, x, y, width, height, 0, 360 * 64);
-		return; 
-	}
-	
-	if(width < warc){ warc = width; }
-	if(height < harc){ harc = height; }
-
-	/* Top right */
-	gdk_draw_arc(drawable, gc, filled, x + width - warc, y, warc, harc, 0, 90 * 64);
-	
-	/* Top left */
-	gdk_draw_arc(drawable, gc, filled, x, y, warc, harc, 90 * 64, 90 * 64);
-
-	/* Bottom left */
-	gdk_draw_arc(drawable, gc, filled, x, y + height - harc, warc, harc, 180 * 64, 90 * 64);
-
-	/* Bottom right */
-	gdk_draw_arc(drawable, gc, filled, x + width - warc, y + height - harc, warc, harc, 270 * 64, 90 * 64);
-	
-	if(filled){
-		/* Fill the center */
-		gdk_draw_rectangle(drawable, gc, TRUE, x + (warc / 2), y, width - warc, height );
-	
-		/* Fill left side */
-		gdk_draw_rectangle(drawable, gc, TRUE, x, y +  (harc / 2), warc / 2, height - harc );
-	
-		/* Fill right */
-		gdk_draw_rectangle(drawable, gc, TRUE, x + width - (warc / 2), y +  (harc / 2), warc / 2, height - harc );
-	}
-	else{
-		/* Top line */
-		gdk_draw_line(drawable, gc, x + (warc / 2), y, x + width - (warc / 2), y);
-	
-		/* Left line */
-		gdk_draw_line(drawable, gc, x, y +  (harc / 2), x, y + height - (harc / 2));
-	
-		/* right line */
-		gdk_draw_line(drawable, gc, x + width, y +  (harc / 2), x + width, y + height - (harc / 2));
-	
-		/* Bottom line */
-		gdk_draw_line(drawable, gc, x + (warc / 2), y + height, x + width - (warc / 2), y + height);
-	}
+        undo_add_shape ( NULL, m_priv->outline, TOOL_ROUNDED_RECTANGLE );
+        return;
+    }
+    /*filled, the whole box changes and a compressed image is smaller*/
+    rect = gp_shape_bounds ( m_priv->fill, m_priv->outline );
+    if ( rect.width == 0 ) return;
+    undo_add ( &rect, NULL, NULL, TOOL_ROUNDED_RECTANGLE );
 }
 
 
@@ -19,6 +19,7 @@
 
 
 #include "gp-image.h"
+#include "gp_transform.h"
 #include <string.h>
 #include <gdk-pixbuf/gdk-pixbuf.h>
 #include <glib/gi18n.h>
@@ -42,8 +43,24 @@ struct _GpImageData
 struct _GpImagePrivate
 {
 	GdkPixbuf *pixbuf;
+	GdkPixbuf *proxy;			/* pixbuf scaled to the size last drawn */
+	GdkInterpType proxy_interp;
+	gboolean draft;				/* being dragged, scale for speed */
+	GdkPixbuf *keyed;			/* pixbuf with the key colour see through */
+	gboolean use_key;
+	guchar key[3];
 };
 
+/* draft scaling above this many pixels is nearest neighbour */
+#define DRAFT_BILINEAR_MAX		(1024 * 1024)
+
+static void drop_proxy ( GpImage *image );
+static void drop_cache ( GpImage *image );
+static void own_pixbuf ( GpImage *image );
+static GdkPixbuf * get_current_pixbuf ( GpImage *image );
+static void key_color ( GdkPixbuf *dst, GdkPixbuf *src,
+                        guchar r, guchar g, guchar b, guchar a );
+
 
 G_DEFINE_TYPE (GpImage, gp_image, G_TYPE_OBJECT);
 
@@ -52,6 +69,10 @@ gp_image_init (GpImage *object)
 {
 	object->priv = GP_IMAGE_GET_PRIVATE (object);
 	object->priv->pixbuf = NULL;
+	object->priv->proxy = NULL;
+	object->priv->draft = FALSE;
+	object->priv->keyed = NULL;
+	object->priv->use_key = FALSE;
 }
 
 static void
@@ -63,6 +84,7 @@ gp_image_finalize (GObject *object)
 	{
 		g_object_unref ( priv->pixbuf );
 	}
+	drop_cache ( GP_IMAGE (object) );
 	G_OBJECT_CLASS (gp_image_parent_class)->finalize (object);	
 }
 
@@ -198,7 +220,7 @@ gp_image_get_data ( GpImage *image )
 		/*Insufficient memory to save image into a buffer*/
 		return NULL;
 	}
-	if (!gdk_pixbuf_save_to_callback ( image->priv->pixbuf,
+	if (!gdk_pixbuf_save_to_callback ( get_current_pixbuf ( image ),
 	                          		   save_to_buffer_callback,
 	                                   &sdata,
 	                                   "png", NULL, NULL ) ) 
@@ -229,7 +251,7 @@ gp_image_get_pixbuf ( GpImage *image )
 {
 	g_return_val_if_fail ( GP_IS_IMAGE (image), NULL);
 
-	return  gdk_pixbuf_copy ( image->priv->pixbuf );
+	return  gdk_pixbuf_copy ( get_current_pixbuf ( image ) );
 }
 
 
@@ -250,7 +272,8 @@ gp_image_set_diff_pixmap ( GpImage *image, GdkPixmap* pixmap, guint x_offset, gu
 	gint n_channels, rowstride;
 
 	g_return_if_fail ( GP_IS_IMAGE (image) );
-	
+	drop_cache ( image );
+	own_pixbuf ( image );
 
 	pixbuf		=   image->priv->pixbuf;
 	if(!gdk_pixbuf_get_has_alpha ( pixbuf ) )
@@ -318,7 +341,8 @@ gp_image_set_mask ( GpImage *image, GdkBitmap *mask )
 	gint n_channels, rowstride;
 
 	g_return_if_fail ( GP_IS_IMAGE (image) );
-	
+	drop_cache ( image );
+	own_pixbuf ( image );
 
 	pixbuf		=   image->priv->pixbuf;
 	if(!gdk_pixbuf_get_has_alpha ( pixbuf ) )
@@ -365,6 +389,45 @@ gp_image_set_mask ( GpImage *image, GdkBitmap *mask )
 	g_object_unref (m_pixbuf);
 }
 
+/* Replace the alpha channel with one byte per pixel from alpha */
+void
+gp_image_set_alpha ( GpImage *image, const guchar *alpha, gint alpha_rowstride )
+{
+	GdkPixbuf *pixbuf;
+	guchar *pixels, *p;
+	const guchar *a;
+	gint w, h, x;
+	gint n_channels, rowstride;
+
+	g_return_if_fail ( GP_IS_IMAGE (image) );
+	drop_cache ( image );
+	own_pixbuf ( image );
+
+	pixbuf		=   image->priv->pixbuf;
+	if(!gdk_pixbuf_get_has_alpha ( pixbuf ) )
+	{  /*add alpha*/
+		pixbuf = gdk_pixbuf_add_alpha(pixbuf, FALSE, 0, 0, 0);
+		g_object_unref(image->priv->pixbuf);
+		image->priv->pixbuf = pixbuf;
+	}
+	n_channels  =   gdk_pixbuf_get_n_channels   ( pixbuf );
+	rowstride   =   gdk_pixbuf_get_rowstride	( pixbuf );
+	w			=   gdk_pixbuf_get_width		( pixbuf );
+	h			=   gdk_pixbuf_get_height		( pixbuf );
+	pixels		=   gdk_pixbuf_get_pixels		( pixbuf );
+	while (h--) 
+	{
+		p   = pixels + 3;
+		a   = alpha;
+		for ( x = 0; x < w; x++, p += n_channels )
+		{
+			*p = *a++;
+		}
+		pixels	+= rowstride;
+		alpha	+= alpha_rowstride;
+	}
+}
+
 void
 gp_image_draw ( GpImage *image, 
                 GdkDrawable *drawable,
@@ -372,12 +435,13 @@ gp_image_draw ( GpImage *image,
 				gint x, gint y,
                 gint width, gint height )
 {
-	gboolean	resized;
-	GdkPixbuf   *pixbuf;
-	gint		wo,ho,w,h;
+	GpImagePrivate	*priv;
+	GdkPixbuf		*pixbuf;
+	gint			wo,ho,w,h;
 
 	g_return_if_fail ( GP_IS_IMAGE (image) );
 
+	priv = image->priv;
 	wo = gp_image_get_width  (image);
 	ho = gp_image_get_height (image);
 	w = (width  == -1)?wo:width;
@@ -385,13 +449,31 @@ gp_image_draw ( GpImage *image,
 
 	if ( w == wo && h == ho )
 	{
-		pixbuf  = image->priv->pixbuf;
-		resized = FALSE;
+		pixbuf  = get_current_pixbuf ( image );
 	}
 	else
 	{
-		pixbuf = gdk_pixbuf_scale_simple ( image->priv->pixbuf, w, h, GDK_INTERP_HYPER );
-		resized = TRUE;
+		GdkInterpType interp = GDK_INTERP_HYPER;
+
+		if ( priv->draft )
+		{
+			interp = ( (gdouble)w * h > DRAFT_BILINEAR_MAX )?
+			         GDK_INTERP_NEAREST:GDK_INTERP_BILINEAR;
+		}
+		/* every expose of a drag draws the same size again: scale only
+		 * when it changes, or to replace a draft with the real thing */
+		if ( priv->proxy == NULL ||
+		     gdk_pixbuf_get_width ( priv->proxy ) != w ||
+		     gdk_pixbuf_get_height ( priv->proxy ) != h ||
+		     ( priv->proxy_interp != interp &&
+		       priv->proxy_interp != GDK_INTERP_HYPER ) )
+		{
+			drop_proxy ( image );
+			priv->proxy = gdk_pixbuf_scale_simple ( get_current_pixbuf ( image ),
+			                                        w, h, interp );
+			priv->proxy_interp = interp;
+		}
+		pixbuf = priv->proxy;
 	}
 	
 	gdk_draw_pixbuf	( drawable,
@@ -402,9 +484,149 @@ gp_image_draw ( GpImage *image,
 			          -1, -1,
 			          GDK_RGB_DITHER_NORMAL, 
 		              0, 0);
-	if ( resized )
+}
+
+/* While draft is set, drawing at another size scales with a fast
+ * filter; clearing it makes the next draw resample in full quality */
+void
+gp_image_set_draft ( GpImage *image, gboolean draft )
+{
+	g_return_if_fail ( GP_IS_IMAGE (image) );
+	image->priv->draft = draft;
+}
+
+static void
+drop_proxy ( GpImage *image )
+{
+	if ( image->priv->proxy != NULL )
+	{
+		g_object_unref ( image->priv->proxy );
+		image->priv->proxy = NULL;
+	}
+}
+
+/* the pixels changed, nothing derived from them is valid */
+static void
+drop_cache ( GpImage *image )
+{
+	drop_proxy ( image );
+	if ( image->priv->keyed != NULL )
+	{
+		g_object_unref ( image->priv->keyed );
+		image->priv->keyed = NULL;
+	}
+}
+
+/* copy on write: pixels shared with someone else (the clipboard) are
+ * copied before they are changed */
+static void
+own_pixbuf ( GpImage *image )
+{
+	GdkPixbuf *pixbuf = image->priv->pixbuf;
+
+	if ( G_OBJECT (pixbuf)->ref_count > 1 )
 	{
+		image->priv->pixbuf = gdk_pixbuf_copy ( pixbuf );
 		g_object_unref ( pixbuf );
+		g_object_set_data ( G_OBJECT(image), "pixbuf", image->priv->pixbuf);
+	}
+}
+
+/* what is drawn and handed out: the keyed copy, made on first use */
+static GdkPixbuf *
+get_current_pixbuf ( GpImage *image )
+{
+	GpImagePrivate *priv = image->priv;
+
+	if ( !priv->use_key )
+	{
+		return priv->pixbuf;
+	}
+	if ( priv->keyed == NULL )
+	{
+		if ( gdk_pixbuf_get_has_alpha ( priv->pixbuf ) )
+		{
+			priv->keyed = gdk_pixbuf_copy ( priv->pixbuf );
+		}
+		else
+		{
+			priv->keyed = gdk_pixbuf_add_alpha ( priv->pixbuf, FALSE, 0, 0, 0 );
+		}
+		key_color ( priv->keyed, priv->keyed,
+		            priv->key[0], priv->key[1], priv->key[2], 0 );
+	}
+	return priv->keyed;
+}
+
+/* Show the pixels of colour r, g, b as transparent, or the image as it
+ * is when use_key is FALSE.  The keyed copy is kept until the pixels or
+ * the key change, so switching back and forth does not touch pixels.
+ */
+void
+gp_image_set_color_key ( GpImage *image, gboolean use_key,
+                         guchar r, guchar g, guchar b )
+{
+	GpImagePrivate *priv;
+
+	g_return_if_fail ( GP_IS_IMAGE (image) );
+	priv = image->priv;
+	if ( use_key && ( r != priv->key[0] || g != priv->key[1] || b != priv->key[2] ) )
+	{
+		drop_cache ( image );
+		priv->key[0] = r;
+		priv->key[1] = g;
+		priv->key[2] = b;
+	}
+	if ( use_key != priv->use_key )
+	{
+		/* the proxy was scaled from the other variant */
+		drop_proxy ( image );
+		priv->use_key = use_key;
+	}
+}
+
+/*
+ * dst[i] = src[i] with alpha replaced where the colour is the key's.
+ * Pixels are handled as whole words in memory order, so the loop is a
+ * compare and a select the compiler can vectorize.
+ */
+static void
+key_row ( guint32 *dst, const guint32 *src, gint n,
+          guint32 key, guint32 rgb_bits, guint32 alpha )
+{
+	gint i;
+	for ( i = 0; i < n; i++ )
+	{
+		guint32 p = src[i];
+		dst[i] = ( ( p & rgb_bits ) == key ) ? ( p & rgb_bits ) | alpha : p;
+	}
+}
+
+static void
+key_color ( GdkPixbuf *dst, GdkPixbuf *src,
+            guchar r, guchar g, guchar b, guchar a )
+{
+	const guchar	key_bytes[4]	= { r, g, b, 0 };
+	const guchar	rgb_bytes[4]	= { 0xFF, 0xFF, 0xFF, 0 };
+	const guchar	alpha_bytes[4]	= { 0, 0, 0, a };
+	guint32			key, rgb_bits, alpha;
+	guchar			*s, *d;
+	gint			w, h, src_stride, dst_stride;
+
+	memcpy ( &key, key_bytes, 4 );
+	memcpy ( &rgb_bits, rgb_bytes, 4 );
+	memcpy ( &alpha, alpha_bytes, 4 );
+	w			= gdk_pixbuf_get_width ( src );
+	h			= gdk_pixbuf_get_height ( src );
+	src_stride	= gdk_pixbuf_get_rowstride ( src );
+	dst_stride	= gdk_pixbuf_get_rowstride ( dst );
+	s			= gdk_pixbuf_get_pixels ( src );
+	d			= gdk_pixbuf_get_pixels ( dst );
+	while ( h-- )
+	{
+		key_row ( (guint32 *)d, (const guint32 *)s, w, key, rgb_bits, alpha );
+		s += src_stride;
+		d += dst_stride;
 	}
 }
 
@@ -416,32 +638,16 @@ gp_image_draw ( GpImage *image,
 void gp_image_make_color_transparent ( GpImage *image, guchar r, guchar g,
                                         guchar b, guchar a )
 {
-	gint width, height, rowstride, n_channels;
-	gint x, y;
-	guchar *pixels, *p;
-
 	g_return_if_fail ( GP_IS_IMAGE (image) );
+	drop_cache ( image );
+	own_pixbuf ( image );
 
-	n_channels = gdk_pixbuf_get_n_channels (image->priv->pixbuf);
 	g_return_if_fail (gdk_pixbuf_get_colorspace (image->priv->pixbuf) == GDK_COLORSPACE_RGB);
 	g_return_if_fail (gdk_pixbuf_get_bits_per_sample (image->priv->pixbuf) == 8);
 	g_return_if_fail (gdk_pixbuf_get_has_alpha (image->priv->pixbuf));
-	g_return_if_fail (n_channels == 4);
-	width = gdk_pixbuf_get_width (image->priv->pixbuf);
-	height = gdk_pixbuf_get_height (image->priv->pixbuf);
-	rowstride = gdk_pixbuf_get_rowstride (image->priv->pixbuf);
-	
-	pixels = gdk_pixbuf_get_pixels (image->priv->pixbuf);
-	
-	for(y = 0; y < height; y++){
-		for(x = 0; x < width; x++){
-			p = pixels + y * rowstride + x * n_channels;
-			if( (p[0] == r) && (p[1] == g) && (p[2] == b) )
-			{
-				p[3] = a;
-			}	
-		}
-	}
+	g_return_if_fail (gdk_pixbuf_get_n_channels (image->priv->pixbuf) == 4);
+
+	key_color ( image->priv->pixbuf, image->priv->pixbuf, r, g, b, a );
 }
 
 /* Invert the colors without touching alpha channel
@@ -453,6 +659,8 @@ void gp_image_invert_colors ( GpImage *image)
 	guchar *pixels, *p;
 
 	g_return_if_fail ( GP_IS_IMAGE (image) );
+	drop_cache ( image );
+	own_pixbuf ( image );
 
 	n_channels = gdk_pixbuf_get_n_channels (image->priv->pixbuf);
 	g_return_if_fail (gdk_pixbuf_get_colorspace (image->priv->pixbuf) == GDK_COLORSPACE_RGB);
@@ -481,6 +689,7 @@ gp_image_rotate ( GpImage *image, gint angle )
 	GdkPixbuf *new;
 	
 	g_return_if_fail ( GP_IS_IMAGE (image) );
+	drop_cache ( image );
 	
 	new = gdk_pixbuf_rotate_simple (image->priv->pixbuf, angle);
 
@@ -492,12 +701,32 @@ gp_image_rotate ( GpImage *image, gint angle )
 	}
 }
 
+/* map the image through m, it grows to the box of the result */
+void
+gp_image_transform ( GpImage *image, const gp_affine *m, gp_filter filter )
+{
+	GdkPixbuf *new;
+
+	g_return_if_fail ( GP_IS_IMAGE (image) );
+	drop_cache ( image );
+
+	new = gp_transform_pixbuf ( image->priv->pixbuf, m, filter );
+
+	if(GDK_IS_PIXBUF(new))
+	{
+		g_object_unref(image->priv->pixbuf);
+		image->priv->pixbuf = new;
+		g_object_set_data ( G_OBJECT(image), "pixbuf", image->priv->pixbuf);
+	}
+}
+
 void
 gp_image_flip ( GpImage *image, gboolean horizontal )
 {
 	GdkPixbuf *new;
 	
 	g_return_if_fail ( GP_IS_IMAGE (image) );
+	drop_cache ( image );
 	
 	new = gdk_pixbuf_flip (image->priv->pixbuf, horizontal);
 
@@ -539,6 +768,33 @@ gp_image_new_from_pixbuf ( GdkPixbuf *pixbuf, gboolean has_alpha  )
     return image;
 }
 
+/* The image takes over the caller's reference to pixbuf instead of
+ * copying it; while others hold it too, it is copied before the image
+ * writes to it. Only a pixbuf without alpha is copied up front, to
+ * add it. */
+GpImage * 
+gp_image_new_for_pixbuf ( GdkPixbuf *pixbuf )
+{
+	GpImage			*image;
+
+	g_return_val_if_fail ( GDK_IS_PIXBUF (pixbuf), NULL);
+	g_return_val_if_fail ( gdk_pixbuf_get_bits_per_sample (pixbuf) == BITS_PER_SAMPLE, NULL);
+
+	if ( !gdk_pixbuf_get_has_alpha (pixbuf) )
+	{
+		GdkPixbuf *rgba = gdk_pixbuf_add_alpha ( pixbuf, FALSE, 0, 0, 0 );
+		g_object_unref ( pixbuf );
+		pixbuf = rgba;
+		g_return_val_if_fail ( GDK_IS_PIXBUF (pixbuf), NULL);
+	}
+
+	image = g_object_new (GP_TYPE_IMAGE, NULL);
+	image->priv->pixbuf = pixbuf;
+	g_object_set_data ( G_OBJECT(image), "pixbuf", image->priv->pixbuf);
+
+	return image;
+}
+
 GpImage * 
 gp_image_copy ( GpImage *image )
 {
@@ -560,6 +816,8 @@ gp_image_copy ( GpImage *image )
 	g_object_unref (copy->priv->pixbuf);
 	
 	copy->priv->pixbuf = gdk_pixbuf_copy(image->priv->pixbuf);
+	copy->priv->use_key = image->priv->use_key;
+	memcpy ( copy->priv->key, image->priv->key, sizeof copy->priv->key );
 	
     if(!GDK_IS_PIXBUF (copy->priv->pixbuf))
 	{
@@ -592,7 +850,7 @@ GdkBitmap *
 gp_image_get_mask ( GpImage *image )
 {
 	GdkBitmap   *mask;
-	gdk_pixbuf_render_pixmap_and_mask ( image->priv->pixbuf, 
+	gdk_pixbuf_render_pixmap_and_mask ( get_current_pixbuf ( image ), 
 	                                    NULL, &mask, 255 );
 	return mask;
 }
@@ -22,6 +22,7 @@
 
 #include <glib-object.h>
  #include <gtk/gtk.h>
+#include "gp_transform.h"
 
 
 G_BEGIN_DECLS
@@ -58,6 +59,9 @@ GpImage *		gp_image_new_from_pixmap	( GdkPixmap* pixmap,
 			                                  gboolean has_alpha );
 GpImage *		gp_image_new_from_data		( GpImageData *data );
 void			gp_image_set_mask			( GpImage *image, GdkBitmap *mask );
+void			gp_image_set_alpha			( GpImage *image,
+							                  const guchar *alpha,
+							                  gint alpha_rowstride );
 GdkPixbuf *		gp_image_get_pixbuf			( GpImage *image );
 GpImageData *   gp_image_get_data			( GpImage *image );
 void			gp_image_data_free			( GpImageData *data );
@@ -66,6 +70,7 @@ void			gp_image_draw				( GpImage *image,
 							                  GdkGC *gc,
 							                  gint x, gint y,
 							                  gint width, gint height );
+void			gp_image_set_draft			( GpImage *image, gboolean draft );
 gint			gp_image_get_width			( GpImage *image );
 gint			gp_image_get_height			( GpImage *image );
 gboolean		gp_image_get_has_alpha		( GpImage *image );
@@ -76,6 +81,9 @@ void			gp_image_set_diff_pixmap	( GpImage *image,
 				                              guint x_offset, 
 				                              guint y_offset );
 
+void			gp_image_set_color_key		( GpImage *image,
+							                  gboolean use_key,
+							                  guchar r, guchar g, guchar b );
 void			gp_image_make_color_transparent		( GpImage *image,
 													  guchar r,
 													  guchar g,
@@ -86,9 +94,13 @@ void            gp_image_invert_colors       ( GpImage *image);
 void            gp_image_rotate              ( GpImage *image, gint angle );
 void            gp_image_flip                ( GpImage *image,
                                                gboolean horizontal );
+void            gp_image_transform           ( GpImage *image,
+                                               const gp_affine *m,
+                                               gp_filter filter );
 
 GpImage *		gp_image_new_from_pixbuf	 ( GdkPixbuf *pixbuf,
 											   gboolean has_alpha  );
+GpImage *		gp_image_new_for_pixbuf		 ( GdkPixbuf *pixbuf );
 GpImage * 		gp_image_copy				 ( GpImage *image );
 
 G_END_DECLS
@@ -0,0 +1,231 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor Boston, MA 02110-1301,  USA
+ */
+
+#include <string.h>
+
+#include "gp_brush_library.h"
+
+#define BRUSH_DIR       "brushes"
+#define N_LEVELS        6       /* 4, 8, 16, 32, 64, 128 pixels */
+#define MIN_LEVEL_SIZE  4
+
+typedef struct
+{
+    gchar       *name;
+    gchar       *filename;
+    GdkPixbuf   *pixbuf;            /* decoded on first use */
+    gboolean    failed;
+    gp_dab_mask *dabs[N_LEVELS];
+} brush_entry;
+
+static GPtrArray    *m_brushes  = NULL;
+static guint        m_idle_id   = 0;
+
+static void         library_scan        ( void );
+static void         scan_dir            ( const gchar *path );
+static gboolean     load_idle_func      ( gpointer data );
+static gint         compare_entries     ( gconstpointer a, gconstpointer b );
+static void         entry_free          ( brush_entry *entry );
+
+typedef struct
+{
+    GpBrushLibraryFunc  func;
+    gpointer            user_data;
+} load_closure;
+
+
+void
+gp_brush_library_load_idle ( GpBrushLibraryFunc loaded, gpointer user_data )
+{
+    load_closure *closure;
+    if ( m_idle_id != 0 ) return;
+    closure             = g_new ( load_closure, 1 );
+    closure->func       = loaded;
+    closure->user_data  = user_data;
+    m_idle_id = g_idle_add_full ( G_PRIORITY_LOW, load_idle_func, closure, g_free );
+}
+
+gint
+gp_brush_library_get_size ( void )
+{
+    library_scan ();
+    return m_brushes->len;
+}
+
+const gchar *
+gp_brush_library_get_name ( gint index )
+{
+    library_scan ();
+    g_return_val_if_fail ( index >= 0 && index < (gint)m_brushes->len, NULL );
+    return ((brush_entry *)g_ptr_array_index ( m_brushes, index ))->name;
+}
+
+/* Dab of the brush no larger than size, rounded up to a power of two
+ * and never above the image itself */
+const gp_dab_mask *
+gp_brush_library_get_dab ( gint index, gint size )
+{
+    brush_entry *entry;
+    gint        level, level_size, w, h, max;
+
+    library_scan ();
+    g_return_val_if_fail ( index >= 0 && index < (gint)m_brushes->len, NULL );
+    entry = g_ptr_array_index ( m_brushes, index );
+
+    if ( entry->pixbuf == NULL && !entry->failed )
+    {
+        GError *error = NULL;
+        entry->pixbuf = gdk_pixbuf_new_from_file ( entry->filename, &error );
+        if ( entry->pixbuf == NULL )
+        {
+            g_warning ( "Could not load brush %s: %s", entry->filename,
+                        error->message );
+            g_error_free ( error );
+            entry->failed = TRUE;
+        }
+    }
+    if ( entry->pixbuf == NULL ) return NULL;
+
+    w   = gdk_pixbuf_get_width ( entry->pixbuf );
+    h   = gdk_pixbuf_get_height ( entry->pixbuf );
+    max = MIN ( MAX ( w, h ), GP_BRUSH_LIBRARY_MAX_SIZE );
+    size = CLAMP ( size, 1, max );
+
+    for ( level = 0, level_size = MIN_LEVEL_SIZE;
+          level < N_LEVELS - 1 && level_size < size;
+          level++, level_size *= 2 );
+    level_size = MIN ( level_size, max );
+
+    if ( entry->dabs[level] == NULL )
+    {
+        GdkPixbuf   *scaled;
+        gint        sw, sh;
+        if ( w >= h )
+        {
+            sw = level_size;
+            sh = MAX ( 1, h * level_size / w );
+        }
+        else
+        {
+            sh = level_size;
+            sw = MAX ( 1, w * level_size / h );
+        }
+        if ( sw == w && sh == h )
+        {
+            scaled = g_object_ref ( entry->pixbuf );
+        }
+        else
+        {
+            scaled = gdk_pixbuf_scale_simple ( entry->pixbuf, sw, sh,
+                                               GDK_INTERP_HYPER );
+        }
+        entry->dabs[level] = gp_dab_mask_new_from_pixbuf ( scaled );
+        g_object_unref ( scaled );
+    }
+    return entry->dabs[level];
+}
+
+void
+gp_brush_library_free ( void )
+{
+    if ( m_idle_id != 0 )
+    {
+        g_source_remove ( m_idle_id );
+        m_idle_id = 0;
+    }
+    if ( m_brushes != NULL )
+    {
+        g_ptr_array_foreach ( m_brushes, (GFunc)entry_free, NULL );
+        g_ptr_array_free ( m_brushes, TRUE );
+        m_brushes = NULL;
+    }
+}
+
+
+/*private functions*/
+
+static gboolean
+load_idle_func ( gpointer data )
+{
+    load_closure *closure = (load_closure *)data;
+    m_idle_id = 0;
+    library_scan ();
+    if ( closure->func != NULL ) closure->func ( closure->user_data );
+    return FALSE;
+}
+
+/* List the brush files, done once */
+static void
+library_scan ( void )
+{
+    gchar *path;
+    if ( m_brushes != NULL ) return;
+    m_brushes = g_ptr_array_new ();
+
+    path = g_build_filename ( g_get_user_data_dir (), "gnome-paint", BRUSH_DIR, NULL );
+    scan_dir ( path );
+    g_free ( path );
+    path = g_build_filename ( PACKAGE_DATA_DIR, "gnome-paint", BRUSH_DIR, NULL );
+    scan_dir ( path );
+    g_free ( path );
+
+    g_ptr_array_sort ( m_brushes, compare_entries );
+}
+
+static void
+scan_dir ( const gchar *path )
+{
+    GDir        *dir;
+    const gchar *file;
+
+    dir = g_dir_open ( path, 0, NULL );
+    if ( dir == NULL ) return;
+    while ( ( file = g_dir_read_name ( dir ) ) != NULL )
+    {
+        gchar       *lower = g_ascii_strdown ( file, -1 );
+        if ( g_str_has_suffix ( lower, ".png" ) )
+        {
+            brush_entry *entry  = g_new0 ( brush_entry, 1 );
+            entry->name         = g_strndup ( file, strlen ( file ) - 4 );
+            entry->filename     = g_build_filename ( path, file, NULL );
+            g_ptr_array_add ( m_brushes, entry );
+        }
+        g_free ( lower );
+    }
+    g_dir_close ( dir );
+}
+
+static gint
+compare_entries ( gconstpointer a, gconstpointer b )
+{
+    const brush_entry *ea = *(brush_entry * const *)a;
+    const brush_entry *eb = *(brush_entry * const *)b;
+    return g_utf8_collate ( ea->name, eb->name );
+}
+
+static void
+entry_free ( brush_entry *entry )
+{
+    gint i;
+    for ( i = 0; i < N_LEVELS; i++ )
+    {
+        gp_dab_mask_free ( entry->dabs[i] );
+    }
+    if ( entry->pixbuf != NULL ) g_object_unref ( entry->pixbuf );
+    g_free ( entry->name );
+    g_free ( entry->filename );
+    g_free ( entry );
+}
@@ -0,0 +1,42 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor Boston, MA 02110-1301,  USA
+ */
+
+#ifndef __GP_BRUSH_LIBRARY_H__
+#define __GP_BRUSH_LIBRARY_H__
+
+#include <gtk/gtk.h>
+#include "gp_dab.h"
+
+/*
+ * Image brushes.
+ * PNG files from the user brush directory (and the shared one) are
+ * listed from an idle handler once the main loop runs, and each image
+ * is only decoded the first time it is used. Dabs are cached per brush
+ * at power of two sizes, already converted for gp_dab_render().
+ */
+
+#define GP_BRUSH_LIBRARY_MAX_SIZE   128
+
+typedef void (*GpBrushLibraryFunc) ( gpointer user_data );
+
+void                gp_brush_library_load_idle  ( GpBrushLibraryFunc loaded,
+                                                  gpointer user_data );
+gint                gp_brush_library_get_size   ( void );
+const gchar *       gp_brush_library_get_name   ( gint index );
+const gp_dab_mask * gp_brush_library_get_dab    ( gint index, gint size );
+void                gp_brush_library_free       ( void );
+
+#endif /*__GP_BRUSH_LIBRARY_H__*/
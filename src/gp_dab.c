@@ -0,0 +1,775 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor Boston, MA 02110-1301,  USA
+ */
+
+#include "gp_dab.h"
+#include "pixbuf_util.h"
+#include <string.h>
+#include <math.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/* a stroke rarely switches between more than a couple of brushes */
+#define MASK_CACHE_SIZE     8
+
+/* round masks are supersampled SUPERSAMPLE x SUPERSAMPLE per pixel */
+#define SUPERSAMPLE         4
+
+struct _gp_dab_stroke
+{
+    gint        width;
+    gint        height;
+    guint       opacity;    /* 0 - 255 */
+    guint       flow;       /* 0 - 255 */
+    guint16     **rows;     /* stroke alpha, 0 - 65535, rows are  *
+                             * allocated the first time a dab     *
+                             * touches them                       */
+};
+
+static gp_dab_mask  *mask_cache[MASK_CACHE_SIZE];
+static guint        mask_cache_next = 0;
+
+static gp_dab_mask *    mask_new            ( gp_dab_shape shape,
+                                              gint width, gint height );
+static void             mask_rasterize      ( gp_dab_mask *mask );
+static void             mask_update_spans   ( gp_dab_mask *mask );
+static guint16 *        stroke_get_row      ( gp_dab_stroke *stroke, gint y );
+static void             blend_span          ( guchar *dst, const guchar *cov,
+                                              guint16 *alpha, gint n,
+                                              const guchar *color,
+                                              guint flow, guint opacity );
+static gboolean         dab_bounds          ( GdkDrawable *drawable,
+                                              const gp_dab_mask *mask,
+                                              const GdkPoint *centers,
+                                              gint n_centers,
+                                              GdkRectangle *rect );
+static void             replace_span        ( guint32 *dst, const guchar *cov,
+                                              gint n, guint32 from, guint32 to,
+                                              guint tolerance );
+static void             blend_image_span    ( guchar *dst, const guchar *src,
+                                              const guchar *cov,
+                                              guint16 *alpha, gint n,
+                                              guint flow, guint opacity );
+
+
+const gp_dab_mask *
+gp_dab_mask_get ( gp_dab_shape shape, gint width, gint height, gint hardness )
+{
+    gp_dab_mask *mask;
+    guint       i;
+
+    hardness = ( shape == GP_DAB_ROUND ) ? CLAMP ( hardness, 0, 100 ) : 100;
+
+    for ( i = 0; i < MASK_CACHE_SIZE; i++ )
+    {
+        mask = mask_cache[i];
+        if ( mask != NULL && mask->shape == shape &&
+             mask->width == width && mask->height == height &&
+             mask->hardness == hardness )
+        {
+            return mask;
+        }
+    }
+
+    mask = mask_new ( shape, width, height );
+    mask->hardness = hardness;
+    mask_rasterize ( mask );
+    mask_update_spans ( mask );
+
+    i = mask_cache_next;
+    if ( mask_cache[i] != NULL ) gp_dab_mask_free ( mask_cache[i] );
+    mask_cache[i]   = mask;
+    mask_cache_next = ( i + 1 ) % MASK_CACHE_SIZE;
+    return mask;
+}
+
+void
+gp_dab_mask_cache_clear ( void )
+{
+    guint i;
+    for ( i = 0; i < MASK_CACHE_SIZE; i++ )
+    {
+        if ( mask_cache[i] != NULL )
+        {
+            gp_dab_mask_free ( mask_cache[i] );
+            mask_cache[i] = NULL;
+        }
+    }
+    mask_cache_next = 0;
+}
+
+/* Convert a brush image once: premultiplied colour plus the coverage
+ * spans, so stamping it costs no more than a procedural dab. */
+gp_dab_mask *
+gp_dab_mask_new_from_pixbuf ( GdkPixbuf *pixbuf )
+{
+    gp_dab_mask     *mask;
+    const guchar    *pixels;
+    gint            rowstride, n_channels;
+    gint            x, y;
+
+    g_return_val_if_fail ( GDK_IS_PIXBUF ( pixbuf ), NULL );
+
+    mask        = mask_new ( GP_DAB_IMAGE, gdk_pixbuf_get_width ( pixbuf ),
+                             gdk_pixbuf_get_height ( pixbuf ) );
+    mask->hardness  = 100;
+    mask->premul    = g_new ( guchar, mask->width * mask->height * 4 );
+    pixels      = gdk_pixbuf_get_pixels ( pixbuf );
+    rowstride   = gdk_pixbuf_get_rowstride ( pixbuf );
+    n_channels  = gdk_pixbuf_get_n_channels ( pixbuf );
+
+    for ( y = 0; y < mask->height; y++ )
+    {
+        const guchar    *s = pixels + y * rowstride;
+        guchar          *d = mask->premul + y * mask->width * 4;
+        guchar          *c = mask->coverage + y * mask->width;
+        for ( x = 0; x < mask->width; x++, s += n_channels, d += 4 )
+        {
+            guint a = ( n_channels == 4 ) ? s[3] : 0xFF;
+            d[0]    = ( s[0] * a + 127 ) / 255;
+            d[1]    = ( s[1] * a + 127 ) / 255;
+            d[2]    = ( s[2] * a + 127 ) / 255;
+            d[3]    = a;
+            c[x]    = a;
+        }
+    }
+    mask_update_spans ( mask );
+    return mask;
+}
+
+void
+gp_dab_mask_free ( gp_dab_mask *mask )
+{
+    if ( mask == NULL ) return;
+    g_free ( mask->coverage );
+    g_free ( mask->span_x0 );
+    g_free ( mask->span_x1 );
+    g_free ( mask->solid );
+    g_free ( mask->premul );
+    g_slice_free ( gp_dab_mask, mask );
+}
+
+gp_dab_stroke *
+gp_dab_stroke_new ( gint width, gint height, gdouble opacity, gdouble flow )
+{
+    gp_dab_stroke *stroke = g_slice_new0 ( gp_dab_stroke );
+    stroke->width   = width;
+    stroke->height  = height;
+    stroke->opacity = (guint)( CLAMP ( opacity, 0.0, 1.0 ) * 255.0 + 0.5 );
+    stroke->flow    = (guint)( CLAMP ( flow, 0.0, 1.0 ) * 255.0 + 0.5 );
+    stroke->rows    = g_new0 ( guint16 *, MAX ( height, 1 ) );
+    return stroke;
+}
+
+void
+gp_dab_stroke_free ( gp_dab_stroke *stroke )
+{
+    gint y;
+    if ( stroke == NULL ) return;
+    for ( y = 0; y < stroke->height; y++ )
+    {
+        g_free ( stroke->rows[y] );
+    }
+    g_free ( stroke->rows );
+    g_slice_free ( gp_dab_stroke, stroke );
+}
+
+/* foreground colour of a GC as col_rgba() */
+guint
+gp_dab_color_from_gc ( GdkGC *gc, GdkColormap *colormap )
+{
+    GdkGCValues values;
+    GdkColor    color;
+
+    gdk_gc_get_values ( gc, &values );
+    gdk_colormap_query_color ( colormap, values.foreground.pixel, &color );
+    return col_rgba ( color.red >> 8, color.green >> 8, color.blue >> 8, 0xFF );
+}
+
+/*
+ * Stamp every dab into one RGBA buffer covering their bounding box
+ * and draw it back. Returns the rectangle that was touched, empty if
+ * all the dabs fell outside the drawable.
+ * A NULL stroke paints at full opacity and flow.
+ */
+GdkRectangle
+gp_dab_render ( GdkDrawable *drawable, GdkGC *gc, gp_dab_stroke *stroke,
+                const gp_dab_mask *mask, guint color,
+                const GdkPoint *centers, gint n_centers )
+{
+    GdkRectangle    rect;
+    GdkPixbuf       *pixbuf;
+    guchar          *pixels;
+    gint            rowstride;
+    gint            i, x;
+    guint32         pixel;
+    guchar          *c      = (guchar *)&pixel;
+    guint           flow    = ( stroke != NULL ) ? stroke->flow : 0xFF;
+    guint           opacity = ( stroke != NULL ) ? stroke->opacity : 0xFF;
+
+    if ( !dab_bounds ( drawable, mask, centers, n_centers, &rect ) ) return rect;
+
+    pixbuf = gdk_pixbuf_new ( GDK_COLORSPACE_RGB, TRUE, 8, rect.width, rect.height );
+    gdk_pixbuf_get_from_drawable ( pixbuf, drawable, NULL,
+                                   rect.x, rect.y, 0, 0,
+                                   rect.width, rect.height );
+    pixels      = gdk_pixbuf_get_pixels ( pixbuf );
+    rowstride   = gdk_pixbuf_get_rowstride ( pixbuf );
+
+    c[0] = getr(color);
+    c[1] = getg(color);
+    c[2] = getb(color);
+    c[3] = 0xFF;
+
+    for ( i = 0; i < n_centers; i++ )
+    {
+        gint ox = centers[i].x - mask->width / 2 - rect.x;
+        gint oy = centers[i].y - mask->height / 2 - rect.y;
+        gint r0 = MAX ( 0, -oy );
+        gint r1 = MIN ( mask->height, rect.height - oy );
+        gint r;
+
+        for ( r = r0; r < r1; r++ )
+        {
+            const guchar    *cov;
+            guint32         *dst;
+            gint            s0, s1;
+
+            if ( mask->span_x1[r] < mask->span_x0[r] ) continue;
+            s0 = MAX ( mask->span_x0[r], -ox );
+            s1 = MIN ( mask->span_x1[r], rect.width - ox - 1 );
+            if ( s1 < s0 ) continue;
+
+            dst = (guint32 *)( pixels + ( oy + r ) * rowstride ) + ox;
+            cov = mask->coverage + r * mask->width;
+            if ( mask->premul != NULL )
+            {
+                guint16 *alpha = NULL;
+                if ( opacity != 0xFF )
+                {
+                    alpha = stroke_get_row ( stroke, rect.y + oy + r ) +
+                            rect.x + ox + s0;
+                }
+                blend_image_span ( (guchar *)( dst + s0 ),
+                                   mask->premul + ( r * mask->width + s0 ) * 4,
+                                   cov + s0, alpha, s1 - s0 + 1, flow, opacity );
+            }
+            else
+            if ( opacity == 0xFF && flow == 0xFF && mask->solid[r] )
+            {
+                for ( x = s0; x <= s1; x++ ) dst[x] = pixel;
+            }
+            else
+            {
+                guint16 *alpha = NULL;
+                if ( opacity != 0xFF )
+                {
+                    /* canvas coordinates of the span start */
+                    alpha = stroke_get_row ( stroke, rect.y + oy + r ) +
+                            rect.x + ox + s0;
+                }
+                blend_span ( (guchar *)( dst + s0 ), cov + s0, alpha,
+                             s1 - s0 + 1, c, flow, opacity );
+            }
+        }
+    }
+
+    gdk_draw_pixbuf ( drawable, gc, pixbuf, 0, 0, rect.x, rect.y,
+                      rect.width, rect.height, GDK_RGB_DITHER_NONE, 0, 0 );
+    g_object_unref ( pixbuf );
+    return rect;
+}
+
+/*
+ * Colour replace: inside the dabs, pixels within tolerance of the
+ * from colour on every channel become the to colour; the rest of the
+ * canvas is left alone. Dab pixels count as inside from half coverage.
+ */
+GdkRectangle
+gp_dab_replace ( GdkDrawable *drawable, GdkGC *gc, const gp_dab_mask *mask,
+                 guint from, guint to, guint tolerance,
+                 const GdkPoint *centers, gint n_centers )
+{
+    GdkRectangle    rect;
+    GdkPixbuf       *pixbuf;
+    guchar          *pixels;
+    gint            rowstride;
+    gint            i;
+    guint32         from_px, to_px;
+    guchar          *f  = (guchar *)&from_px;
+    guchar          *t  = (guchar *)&to_px;
+
+    if ( !dab_bounds ( drawable, mask, centers, n_centers, &rect ) ) return rect;
+
+    pixbuf = gdk_pixbuf_new ( GDK_COLORSPACE_RGB, TRUE, 8, rect.width, rect.height );
+    gdk_pixbuf_get_from_drawable ( pixbuf, drawable, NULL,
+                                   rect.x, rect.y, 0, 0,
+                                   rect.width, rect.height );
+    pixels      = gdk_pixbuf_get_pixels ( pixbuf );
+    rowstride   = gdk_pixbuf_get_rowstride ( pixbuf );
+
+    /* in memory order, like the pixbuf */
+    f[0] = getr(from);  f[1] = getg(from);  f[2] = getb(from);  f[3] = 0xFF;
+    t[0] = getr(to);    t[1] = getg(to);    t[2] = getb(to);    t[3] = 0xFF;
+    tolerance = MIN ( tolerance, 255 );
+
+    for ( i = 0; i < n_centers; i++ )
+    {
+        gint ox = centers[i].x - mask->width / 2 - rect.x;
+        gint oy = centers[i].y - mask->height / 2 - rect.y;
+        gint r0 = MAX ( 0, -oy );
+        gint r1 = MIN ( mask->height, rect.height - oy );
+        gint r;
+
+        for ( r = r0; r < r1; r++ )
+        {
+            guint32 *dst;
+            gint    s0, s1;
+
+            if ( mask->span_x1[r] < mask->span_x0[r] ) continue;
+            s0 = MAX ( mask->span_x0[r], -ox );
+            s1 = MIN ( mask->span_x1[r], rect.width - ox - 1 );
+            if ( s1 < s0 ) continue;
+
+            dst = (guint32 *)( pixels + ( oy + r ) * rowstride ) + ox;
+            replace_span ( dst + s0, mask->coverage + r * mask->width + s0,
+                           s1 - s0 + 1, from_px, to_px, tolerance );
+        }
+    }
+
+    gdk_draw_pixbuf ( drawable, gc, pixbuf, 0, 0, rect.x, rect.y,
+                      rect.width, rect.height, GDK_RGB_DITHER_NONE, 0, 0 );
+    g_object_unref ( pixbuf );
+    return rect;
+}
+
+
+/*private functions*/
+
+/* Bounding box of all the dabs clipped to the drawable */
+static gboolean
+dab_bounds ( GdkDrawable *drawable, const gp_dab_mask *mask,
+             const GdkPoint *centers, gint n_centers, GdkRectangle *rect )
+{
+    gint    x_min = G_MAXINT, y_min = G_MAXINT;
+    gint    x_max = G_MININT, y_max = G_MININT;
+    gint    width, height;
+    gint    i, x, y;
+
+    rect->x = rect->y = rect->width = rect->height = 0;
+    if ( n_centers <= 0 ) return FALSE;
+
+    for ( i = 0; i < n_centers; i++ )
+    {
+        x = centers[i].x - mask->width / 2;
+        y = centers[i].y - mask->height / 2;
+        x_min = MIN ( x_min, x );
+        y_min = MIN ( y_min, y );
+        x_max = MAX ( x_max, x + mask->width );
+        y_max = MAX ( y_max, y + mask->height );
+    }
+    gdk_drawable_get_size ( drawable, &width, &height );
+    x_min = MAX ( x_min, 0 );
+    y_min = MAX ( y_min, 0 );
+    x_max = MIN ( x_max, width );
+    y_max = MIN ( y_max, height );
+    if ( x_min >= x_max || y_min >= y_max ) return FALSE;
+
+    rect->x      = x_min;
+    rect->y      = y_min;
+    rect->width  = x_max - x_min;
+    rect->height = y_max - y_min;
+    return TRUE;
+}
+
+static gp_dab_mask *
+mask_new ( gp_dab_shape shape, gint width, gint height )
+{
+    gp_dab_mask *mask = g_slice_new0 ( gp_dab_mask );
+    mask->shape     = shape;
+    mask->width     = MAX ( width, 1 );
+    mask->height    = MAX ( height, 1 );
+    mask->coverage  = g_new0 ( guchar, mask->width * mask->height );
+    mask->span_x0   = g_new ( gint, mask->height );
+    mask->span_x1   = g_new ( gint, mask->height );
+    mask->solid     = g_new ( gboolean, mask->height );
+    return mask;
+}
+
+/*
+ * The shapes match what the X brushes used to draw: a filled ellipse
+ * or rectangle in the brush box, and two adjacent one pixel diagonals
+ * for the slash brushes.
+ */
+static void
+mask_rasterize ( gp_dab_mask *mask )
+{
+    gint    w   = mask->width;
+    gint    h   = mask->height;
+    gint    x, y;
+
+    switch ( mask->shape )
+    {
+        case GP_DAB_ROUND:
+        {
+            /* full strength up to hardness * radius, then a smooth *
+             * falloff to the rim; the rim itself is anti-aliased   *
+             * by supersampling                                     */
+            gdouble rx      = w / 2.0, ry = h / 2.0;
+            gdouble inner   = mask->hardness / 100.0;
+            gdouble step    = 1.0 / SUPERSAMPLE;
+            gint    sx, sy;
+            for ( y = 0; y < h; y++ )
+            {
+                for ( x = 0; x < w; x++ )
+                {
+                    gdouble sum = 0.0;
+                    for ( sy = 0; sy < SUPERSAMPLE; sy++ )
+                    {
+                        gdouble dy = ( y + ( sy + 0.5 ) * step - ry ) / ry;
+                        for ( sx = 0; sx < SUPERSAMPLE; sx++ )
+                        {
+                            gdouble dx = ( x + ( sx + 0.5 ) * step - rx ) / rx;
+                            gdouble d  = sqrt ( dx * dx + dy * dy );
+                            if ( d <= inner )
+                            {
+                                sum += 1.0;
+                            }
+                            else if ( d < 1.0 )
+                            {
+                                gdouble t = ( d - inner ) / ( 1.0 - inner );
+                                sum += 1.0 - t * t * ( 3.0 - 2.0 * t );
+                            }
+                        }
+                    }
+                    mask->coverage[y * w + x] =
+                        (guchar)( sum * 255.0 / ( SUPERSAMPLE * SUPERSAMPLE ) + 0.5 );
+                }
+            }
+            break;
+        }
+        case GP_DAB_SQUARE:
+        {
+            memset ( mask->coverage, 0xFF, w * h );
+            break;
+        }
+        case GP_DAB_BACK_SLASH:
+        case GP_DAB_FWD_SLASH:
+        {
+            for ( y = 0; y < h; y++ )
+            {
+                x = ( h > 1 ) ? ( y * ( w - 1 ) + ( h - 1 ) / 2 ) / ( h - 1 ) : 0;
+                if ( mask->shape == GP_DAB_FWD_SLASH ) x = w - 1 - x;
+                mask->coverage[y * w + x] = 0xFF;
+                /* second line to fill in gaps */
+                if ( x < w - 1 ) mask->coverage[y * w + x + 1] = 0xFF;
+            }
+            break;
+        }
+        case GP_DAB_IMAGE:
+        {
+            /* filled in by gp_dab_mask_new_from_pixbuf() */
+            break;
+        }
+    }
+}
+
+static void
+mask_update_spans ( gp_dab_mask *mask )
+{
+    gint x, y;
+    for ( y = 0; y < mask->height; y++ )
+    {
+        const guchar *row = mask->coverage + y * mask->width;
+        gint x0 = mask->width, x1 = -1;
+        for ( x = 0; x < mask->width; x++ )
+        {
+            if ( row[x] )
+            {
+                if ( x < x0 ) x0 = x;
+                x1 = x;
+            }
+        }
+        mask->span_x0[y]    = x0;
+        mask->span_x1[y]    = x1;
+        mask->solid[y]      = TRUE;
+        for ( x = x0; x <= x1; x++ )
+        {
+            if ( row[x] != 0xFF ) mask->solid[y] = FALSE;
+        }
+    }
+}
+
+static guint16 *
+stroke_get_row ( gp_dab_stroke *stroke, gint y )
+{
+    if ( stroke->rows[y] == NULL )
+    {
+        stroke->rows[y] = g_new0 ( guint16, stroke->width );
+    }
+    return stroke->rows[y];
+}
+
+/*
+ * Blend kernel: dst = dst + ( color - dst ) * t for n RGBA pixels.
+ *
+ * Without a stroke alpha row t = coverage * flow. With one, the stroke
+ * alpha a grows as a' = a + ( 1 - a ) * coverage * flow and what was
+ * painted so far is pulled to opacity * a', so overlapping dabs never
+ * go past the stroke opacity:
+ *     t = op * ( a' - a ) / ( 1 - op * a )
+ *
+ * The SSE2 path handles 8 pixels per iteration; the tail and non SSE2
+ * builds take the scalar path below, which computes the same thing.
+ */
+static inline guchar
+blend_channel ( guint d, guint c, guint t )
+{
+    guint x = d * ( 255 - t ) + c * t + 128;
+    return (guchar)( ( x + ( x >> 8 ) ) >> 8 );
+}
+
+static inline guint
+stroke_weight ( guint16 *alpha, guint cov, guint flow, guint opacity )
+{
+    gfloat a    = *alpha * ( 1.0f / 65535.0f );
+    gfloat op   = opacity * ( 1.0f / 255.0f );
+    gfloat c    = cov * flow * ( 1.0f / 65025.0f );
+    gfloat an   = a + ( 1.0f - a ) * c;
+    gfloat t    = op * ( an - a ) / MAX ( 1.0f - op * a, 1.0f / 65535.0f );
+    *alpha      = (guint16)( an * 65535.0f + 0.5f );
+    return (guint)( t * 255.0f + 0.5f );
+}
+
+#ifdef __SSE2__
+static inline __m128i
+div255_epu16 ( __m128i x )
+{
+    x = _mm_add_epi16 ( x, _mm_set1_epi16 ( 128 ) );
+    return _mm_srli_epi16 ( _mm_add_epi16 ( x, _mm_srli_epi16 ( x, 8 ) ), 8 );
+}
+
+/* two pixels (8 x u16) towards color by their weights */
+static inline __m128i
+blend2_sse2 ( __m128i d, __m128i c, __m128i t )
+{
+    __m128i it = _mm_sub_epi16 ( _mm_set1_epi16 ( 255 ), t );
+    return div255_epu16 ( _mm_add_epi16 ( _mm_mullo_epi16 ( d, it ),
+                                          _mm_mullo_epi16 ( c, t ) ) );
+}
+
+/* blend 8 RGBA pixels with 8 u16 weights */
+static inline void
+blend8_sse2 ( guchar *dst, __m128i t, __m128i c )
+{
+    __m128i zero    = _mm_setzero_si128 ();
+    __m128i p0      = _mm_loadu_si128 ( (__m128i *)dst );
+    __m128i p1      = _mm_loadu_si128 ( (__m128i *)( dst + 16 ) );
+    __m128i tlo     = _mm_unpacklo_epi16 ( t, t );
+    __m128i thi     = _mm_unpackhi_epi16 ( t, t );
+    __m128i r0, r1, r2, r3;
+
+    r0 = blend2_sse2 ( _mm_unpacklo_epi8 ( p0, zero ), c, _mm_unpacklo_epi32 ( tlo, tlo ) );
+    r1 = blend2_sse2 ( _mm_unpackhi_epi8 ( p0, zero ), c, _mm_unpackhi_epi32 ( tlo, tlo ) );
+    r2 = blend2_sse2 ( _mm_unpacklo_epi8 ( p1, zero ), c, _mm_unpacklo_epi32 ( thi, thi ) );
+    r3 = blend2_sse2 ( _mm_unpackhi_epi8 ( p1, zero ), c, _mm_unpackhi_epi32 ( thi, thi ) );
+    _mm_storeu_si128 ( (__m128i *)dst, _mm_packus_epi16 ( r0, r1 ) );
+    _mm_storeu_si128 ( (__m128i *)( dst + 16 ), _mm_packus_epi16 ( r2, r3 ) );
+}
+
+/* stroke_weight() for 4 pixels, same operation order and rounding;
+ * a holds the alpha and cf cov * flow, both as i32 */
+static inline __m128
+stroke_weight4_sse2 ( __m128i a32, __m128i cf32, __m128 op, __m128i *an32 )
+{
+    __m128  one     = _mm_set1_ps ( 1.0f );
+    __m128  half    = _mm_set1_ps ( 0.5f );
+    __m128  a   = _mm_mul_ps ( _mm_cvtepi32_ps ( a32 ), _mm_set1_ps ( 1.0f / 65535.0f ) );
+    __m128  c   = _mm_mul_ps ( _mm_cvtepi32_ps ( cf32 ), _mm_set1_ps ( 1.0f / 65025.0f ) );
+    __m128  an  = _mm_add_ps ( a, _mm_mul_ps ( _mm_sub_ps ( one, a ), c ) );
+    __m128  den = _mm_max_ps ( _mm_sub_ps ( one, _mm_mul_ps ( op, a ) ),
+                               _mm_set1_ps ( 1.0f / 65535.0f ) );
+    __m128  t   = _mm_div_ps ( _mm_mul_ps ( op, _mm_sub_ps ( an, a ) ), den );
+    *an32 = _mm_cvttps_epi32 ( _mm_add_ps ( _mm_mul_ps ( an, _mm_set1_ps ( 65535.0f ) ),
+                                            half ) );
+    return _mm_add_ps ( _mm_mul_ps ( t, _mm_set1_ps ( 255.0f ) ), half );
+}
+#endif
+
+static void
+blend_span ( guchar *dst, const guchar *cov, guint16 *alpha, gint n,
+             const guchar *color, guint flow, guint opacity )
+{
+    gint i = 0;
+
+#ifdef __SSE2__
+    {
+        __m128i zero    = _mm_setzero_si128 ();
+        __m128i c       = _mm_set_epi16 ( color[3], color[2], color[1], color[0],
+                                          color[3], color[2], color[1], color[0] );
+        __m128i bias    = _mm_set1_epi32 ( 32768 );
+        __m128  op      = _mm_set1_ps ( opacity * ( 1.0f / 255.0f ) );
+
+        for ( ; i + 8 <= n; i += 8 )
+        {
+            __m128i cv = _mm_unpacklo_epi8 ( _mm_loadl_epi64 ( (__m128i *)( cov + i ) ), zero );
+            __m128i t;
+
+            if ( alpha == NULL )
+            {
+                t = div255_epu16 ( _mm_mullo_epi16 ( cv, _mm_set1_epi16 ( flow ) ) );
+            }
+            else
+            {
+                __m128i a   = _mm_loadu_si128 ( (__m128i *)( alpha + i ) );
+                /* cov * flow <= 65025 fits the low u16 of the product */
+                __m128i cf  = _mm_mullo_epi16 ( cv, _mm_set1_epi16 ( flow ) );
+                __m128i an0, an1;
+                __m128  t0  = stroke_weight4_sse2 ( _mm_unpacklo_epi16 ( a, zero ),
+                                                    _mm_unpacklo_epi16 ( cf, zero ),
+                                                    op, &an0 );
+                __m128  t1  = stroke_weight4_sse2 ( _mm_unpackhi_epi16 ( a, zero ),
+                                                    _mm_unpackhi_epi16 ( cf, zero ),
+                                                    op, &an1 );
+                t = _mm_packs_epi32 ( _mm_cvttps_epi32 ( t0 ), _mm_cvttps_epi32 ( t1 ) );
+                /* no unsigned 32 -> 16 pack in SSE2: bias, pack, unbias */
+                an0 = _mm_sub_epi32 ( an0, bias );
+                an1 = _mm_sub_epi32 ( an1, bias );
+                _mm_storeu_si128 ( (__m128i *)( alpha + i ),
+                                   _mm_xor_si128 ( _mm_packs_epi32 ( an0, an1 ),
+                                                   _mm_set1_epi16 ( (gshort)0x8000 ) ) );
+            }
+            blend8_sse2 ( dst + i * 4, t, c );
+        }
+    }
+#endif
+
+    for ( ; i < n; i++ )
+    {
+        guint   t;
+        guchar  *p  = dst + i * 4;
+
+        if ( alpha == NULL )
+        {
+            t = ( cov[i] * flow + 127 ) / 255;
+        }
+        else
+        {
+            t = stroke_weight ( alpha + i, cov[i], flow, opacity );
+        }
+        p[0] = blend_channel ( p[0], color[0], t );
+        p[1] = blend_channel ( p[1], color[1], t );
+        p[2] = blend_channel ( p[2], color[2], t );
+        p[3] = blend_channel ( p[3], color[3], t );
+    }
+}
+
+/*
+ * Image dabs: premultiplied source over the canvas,
+ *     dst = dst * ( 1 - t ) + src * t / coverage
+ * where t is worked out from the coverage exactly as for a flat colour
+ * dab, so flow and stroke opacity behave the same for both.
+ */
+static void
+blend_image_span ( guchar *dst, const guchar *src, const guchar *cov,
+                   guint16 *alpha, gint n, guint flow, guint opacity )
+{
+    gint i, k;
+
+    for ( i = 0; i < n; i++, dst += 4, src += 4 )
+    {
+        guint t, s;
+
+        if ( cov[i] == 0 ) continue;
+        if ( alpha == NULL )
+        {
+            t = ( cov[i] * flow + 127 ) / 255;
+            s = flow;
+        }
+        else
+        {
+            t = stroke_weight ( alpha + i, cov[i], flow, opacity );
+            s = ( t * 255 + cov[i] / 2 ) / cov[i];
+        }
+        for ( k = 0; k < 4; k++ )
+        {
+            guint x = dst[k] * ( 255 - t ) + src[k] * s + 128;
+            x = ( x + ( x >> 8 ) ) >> 8;
+            dst[k] = (guchar)MIN ( x, 255 );
+        }
+    }
+}
+
+/*
+ * Replace kernel: compare and select, 4 pixels per iteration on SSE2.
+ * |dst - from| is built from two saturated subtractions, a pixel
+ * matches when no colour channel goes past the tolerance (alpha always
+ * passes) and the dab covers it at least half.
+ */
+static void
+replace_span ( guint32 *dst, const guchar *cov, gint n, guint32 from,
+               guint32 to, guint tolerance )
+{
+    gint            i = 0;
+    const guchar    *f = (const guchar *)&from;
+
+#ifdef __SSE2__
+    {
+        guint32 tol_px;
+        guchar  *tl     = (guchar *)&tol_px;
+        __m128i zero    = _mm_setzero_si128 ();
+        __m128i vfrom   = _mm_set1_epi32 ( (gint)from );
+        __m128i vto     = _mm_set1_epi32 ( (gint)to );
+        __m128i vtol;
+        __m128i half    = _mm_set1_epi32 ( 127 );
+
+        tl[0] = tl[1] = tl[2] = (guchar)tolerance;
+        tl[3] = 0xFF;
+        vtol  = _mm_set1_epi32 ( (gint)tol_px );
+
+        for ( ; i + 4 <= n; i += 4 )
+        {
+            gint32  c4;
+            __m128i d, diff, match, c, sel;
+
+            memcpy ( &c4, cov + i, 4 );
+            d       = _mm_loadu_si128 ( (__m128i *)( dst + i ) );
+            diff    = _mm_or_si128 ( _mm_subs_epu8 ( d, vfrom ),
+                                     _mm_subs_epu8 ( vfrom, d ) );
+            match   = _mm_cmpeq_epi32 ( _mm_subs_epu8 ( diff, vtol ), zero );
+            c       = _mm_unpacklo_epi16 ( _mm_unpacklo_epi8 (
+                                               _mm_cvtsi32_si128 ( c4 ), zero ),
+                                           zero );
+            sel     = _mm_and_si128 ( match, _mm_cmpgt_epi32 ( c, half ) );
+            _mm_storeu_si128 ( (__m128i *)( dst + i ),
+                               _mm_or_si128 ( _mm_and_si128 ( sel, vto ),
+                                              _mm_andnot_si128 ( sel, d ) ) );
+        }
+    }
+#endif
+
+    for ( ; i < n; i++ )
+    {
+        const guchar *p = (const guchar *)( dst + i );
+        if ( cov[i] < 128 ) continue;
+        if ( ABS ( p[0] - f[0] ) <= (gint)tolerance &&
+             ABS ( p[1] - f[1] ) <= (gint)tolerance &&
+             ABS ( p[2] - f[2] ) <= (gint)tolerance )
+        {
+            dst[i] = to;
+        }
+    }
+}
@@ -0,0 +1,89 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor Boston, MA 02110-1301,  USA
+ */
+
+#ifndef __GP_DAB_H__
+#define __GP_DAB_H__
+
+#include <gtk/gtk.h>
+
+/*
+ * Client side brush engine.
+ * A brush shape is rasterized once into a coverage mask (cached per
+ * shape and size), dabs are then stamped as row spans into an RGBA
+ * copy of the damaged part of the canvas, which is pushed back to
+ * the drawable with a single request.
+ */
+
+typedef enum
+{
+    GP_DAB_ROUND,
+    GP_DAB_SQUARE,
+    GP_DAB_FWD_SLASH,
+    GP_DAB_BACK_SLASH,
+    GP_DAB_IMAGE                /* made from a brush image            */
+} gp_dab_shape;
+
+typedef struct
+{
+    gp_dab_shape    shape;
+    gint            width;
+    gint            height;
+    gint            hardness;   /* 0 - 100, round brushes only        */
+    guchar          *coverage;  /* width * height, 0 - 255            */
+    gint            *span_x0;   /* per row first covered column       */
+    gint            *span_x1;   /* per row last covered column, < x0  *
+                                 * when the row is empty              */
+    gboolean        *solid;     /* row is fully covered in the span   */
+    guchar          *premul;    /* image dabs only, premultiplied     *
+                                 * RGBA, the alpha is the coverage    */
+} gp_dab_mask;
+
+/* Paint state of one stroke: opacity caps what the whole stroke can
+ * lay down, flow is how much of it each dab adds. */
+typedef struct _gp_dab_stroke gp_dab_stroke;
+
+const gp_dab_mask * gp_dab_mask_get         ( gp_dab_shape shape,
+                                              gint width, gint height,
+                                              gint hardness );
+void                gp_dab_mask_cache_clear ( void );
+gp_dab_mask *       gp_dab_mask_new_from_pixbuf ( GdkPixbuf *pixbuf );
+void                gp_dab_mask_free        ( gp_dab_mask *mask );
+guint               gp_dab_color_from_gc    ( GdkGC *gc,
+                                              GdkColormap *colormap );
+
+gp_dab_stroke *     gp_dab_stroke_new       ( gint width, gint height,
+                                              gdouble opacity, gdouble flow );
+void                gp_dab_stroke_free      ( gp_dab_stroke *stroke );
+
+/* color is ignored for image dabs */
+GdkRectangle        gp_dab_render           ( GdkDrawable *drawable,
+                                              GdkGC *gc,
+                                              gp_dab_stroke *stroke,
+                                              const gp_dab_mask *mask,
+                                              guint color,
+                                              const GdkPoint *centers,
+                                              gint n_centers );
+
+/* from and to are col_rgba() colours, tolerance is per channel 0 - 255 */
+GdkRectangle        gp_dab_replace          ( GdkDrawable *drawable,
+                                              GdkGC *gc,
+                                              const gp_dab_mask *mask,
+                                              guint from, guint to,
+                                              guint tolerance,
+                                              const GdkPoint *centers,
+                                              gint n_centers );
+
+#endif /*__GP_DAB_H__*/
@@ -0,0 +1,357 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor Boston, MA 02110-1301,  USA
+ */
+
+#include "gp_mask.h"
+#include "pixbuf_util.h"
+#include <string.h>
+
+gp_mask *
+gp_mask_new ( gint x, gint y, gint width, gint height )
+{
+    gp_mask *mask = g_slice_new ( gp_mask );
+    mask->x         = x;
+    mask->y         = y;
+    mask->width     = width;
+    mask->height    = height;
+    mask->data      = g_new0 ( guchar, (gsize)width * height );
+    return mask;
+}
+
+gp_mask *
+gp_mask_new_from_spans ( const gp_span_list *sl )
+{
+    const GdkRectangle  *b = &sl->bounds;
+    gp_mask             *mask;
+    gint                i;
+
+    if ( sl->spans->len == 0 || b->width <= 0 || b->height <= 0 ) return NULL;
+    mask = gp_mask_new ( b->x, b->y, b->width, b->height );
+    for ( i = 0; i < sl->spans->len; i++ )
+    {
+        const gp_span   *span = &g_array_index ( sl->spans, gp_span, i );
+        guchar          *dst;
+
+        dst = mask->data + ( span->y - b->y ) * mask->width + ( span->x - b->x );
+        if ( span->offset < 0 )
+        {
+            memset ( dst, 255, span->width );
+        }
+        else
+        {
+            memcpy ( dst, sl->coverage->data + span->offset, span->width );
+        }
+    }
+    return mask;
+}
+
+gp_mask *
+gp_mask_new_from_data ( const guchar *data, gint rowstride, const GdkRectangle *area )
+{
+    gp_mask *mask = gp_mask_new ( area->x, area->y, area->width, area->height );
+    gint    x, y;
+
+    for ( y = 0; y < area->height; y++ )
+    {
+        const guchar    *src = data + ( area->y + y ) * rowstride + area->x;
+        guchar          *dst = mask->data + y * area->width;
+        for ( x = 0; x < area->width; x++ )
+        {
+            dst[x] = src[x] ? 255 : 0;
+        }
+    }
+    return mask;
+}
+
+gp_mask *
+gp_mask_copy ( const gp_mask *mask )
+{
+    gp_mask *copy = gp_mask_new ( mask->x, mask->y, mask->width, mask->height );
+    memcpy ( copy->data, mask->data, (gsize)mask->width * mask->height );
+    return copy;
+}
+
+void
+gp_mask_free ( gp_mask *mask )
+{
+    if ( mask == NULL ) return;
+    g_free ( mask->data );
+    g_slice_free ( gp_mask, mask );
+}
+
+void
+gp_mask_flip ( gp_mask *mask, gboolean horizontal )
+{
+    gint y;
+
+    if ( horizontal )
+    {
+        for ( y = 0; y < mask->height; y++ )
+        {
+            guchar *l = mask->data + y * mask->width;
+            guchar *r = l + mask->width - 1;
+            for ( ; l < r; l++, r-- )
+            {
+                guchar t = *l; *l = *r; *r = t;
+            }
+        }
+    }
+    else
+    {
+        guchar *row = g_new ( guchar, mask->width );
+        for ( y = 0; y < mask->height / 2; y++ )
+        {
+            guchar *t = mask->data + y * mask->width;
+            guchar *b = mask->data + ( mask->height - 1 - y ) * mask->width;
+            memcpy ( row, t, mask->width );
+            memcpy ( t, b, mask->width );
+            memcpy ( b, row, mask->width );
+        }
+        g_free ( row );
+    }
+}
+
+void
+gp_mask_rotate ( gp_mask *mask, GdkPixbufRotation angle )
+{
+    gint    w = mask->width;
+    gint    h = mask->height;
+    guchar  *data;
+    gint    x, y;
+
+    switch ( angle )
+    {
+        case GDK_PIXBUF_ROTATE_UPSIDEDOWN:
+            gp_mask_flip ( mask, TRUE );
+            gp_mask_flip ( mask, FALSE );
+            return;
+        case GDK_PIXBUF_ROTATE_COUNTERCLOCKWISE:
+        case GDK_PIXBUF_ROTATE_CLOCKWISE:
+            break;
+        default:
+            return;
+    }
+
+    data = g_new ( guchar, (gsize)w * h );
+    for ( y = 0; y < h; y++ )
+    {
+        const guchar *src = mask->data + y * w;
+        for ( x = 0; x < w; x++ )
+        {
+            /*the rotated mask is h wide and w high*/
+            if ( angle == GDK_PIXBUF_ROTATE_COUNTERCLOCKWISE )
+            {
+                data[( w - 1 - x ) * h + y] = src[x];
+            }
+            else
+            {
+                data[x * h + ( h - 1 - y )] = src[x];
+            }
+        }
+    }
+    g_free ( mask->data );
+    mask->data      = data;
+    mask->width     = h;
+    mask->height    = w;
+}
+
+/*
+ * Add is a per byte max and subtract min ( a, 255 - b ): on the 0 / 255
+ * masks the wand makes those are exactly OR and AND NOT, and an
+ * anti-aliased lasso edge still comes out as coverage. Both are plain
+ * byte loops the compiler turns into vector max / min.
+ */
+static void
+combine_row ( guchar *dst, const guchar *src, gint n, gp_mask_op op )
+{
+    gint i;
+
+    if ( op == GP_MASK_ADD )
+    {
+        for ( i = 0; i < n; i++ )
+        {
+            dst[i] = MAX ( dst[i], src[i] );
+        }
+    }
+    else
+    {
+        for ( i = 0; i < n; i++ )
+        {
+            dst[i] = MIN ( dst[i], (guchar)( 255 - src[i] ) );
+        }
+    }
+}
+
+/* shrink to the covered bytes, NULL when there are none */
+static gp_mask *
+mask_trim ( gp_mask *mask )
+{
+    GdkRectangle    r;
+    gint            x0 = mask->width, x1 = -1, y0 = -1, y1 = -1;
+    gint            x, y;
+    gp_mask         *trim;
+
+    for ( y = 0; y < mask->height; y++ )
+    {
+        const guchar *row = mask->data + y * mask->width;
+        for ( x = 0; x < mask->width && row[x] == 0; x++ );
+        if ( x == mask->width ) continue;
+        x0 = MIN ( x0, x );
+        for ( x = mask->width - 1; row[x] == 0; x-- );
+        x1 = MAX ( x1, x );
+        if ( y0 < 0 ) y0 = y;
+        y1 = y;
+    }
+    if ( y1 < 0 )
+    {
+        gp_mask_free ( mask );
+        return NULL;
+    }
+    if ( x0 == 0 && y0 == 0 && x1 == mask->width - 1 && y1 == mask->height - 1 )
+    {
+        return mask;
+    }
+    r.x         = x0;
+    r.y         = y0;
+    r.width     = x1 - x0 + 1;
+    r.height    = y1 - y0 + 1;
+    trim = gp_mask_new ( mask->x + r.x, mask->y + r.y, r.width, r.height );
+    for ( y = 0; y < r.height; y++ )
+    {
+        memcpy ( trim->data + y * r.width,
+                 mask->data + ( r.y + y ) * mask->width + r.x, r.width );
+    }
+    gp_mask_free ( mask );
+    return trim;
+}
+
+gp_mask *
+gp_mask_combine ( const gp_mask *a, const gp_mask *b, gp_mask_op op )
+{
+    gp_mask *dst;
+    gint    x0, y0, x1, y1, y;
+
+    if ( op == GP_MASK_REPLACE || a == NULL )
+    {
+        if ( op == GP_MASK_SUBTRACT || b == NULL ) return NULL;
+        return gp_mask_copy ( b );
+    }
+    if ( b == NULL ) return gp_mask_copy ( a );
+
+    if ( op == GP_MASK_ADD )
+    {
+        x0  = MIN ( a->x, b->x );
+        y0  = MIN ( a->y, b->y );
+        x1  = MAX ( a->x + a->width, b->x + b->width );
+        y1  = MAX ( a->y + a->height, b->y + b->height );
+        dst = gp_mask_new ( x0, y0, x1 - x0, y1 - y0 );
+        for ( y = 0; y < a->height; y++ )
+        {
+            memcpy ( dst->data + ( a->y - y0 + y ) * dst->width + ( a->x - x0 ),
+                     a->data + y * a->width, a->width );
+        }
+    }
+    else
+    {
+        dst = gp_mask_copy ( a );
+    }
+
+    /*b only touches the part it overlaps*/
+    x0 = MAX ( dst->x, b->x );
+    y0 = MAX ( dst->y, b->y );
+    x1 = MIN ( dst->x + dst->width, b->x + b->width );
+    y1 = MIN ( dst->y + dst->height, b->y + b->height );
+    for ( y = y0; y < y1 && x0 < x1; y++ )
+    {
+        combine_row ( dst->data + ( y - dst->y ) * dst->width + ( x0 - dst->x ),
+                      b->data + ( y - b->y ) * b->width + ( x0 - b->x ),
+                      x1 - x0, op );
+    }
+    return mask_trim ( dst );
+}
+
+/*blend color through the mask over the x0, y0 - x1, y1 part of source*/
+static void
+fill_rect ( const gp_mask *mask, GdkDrawable *drawable, GdkDrawable *source,
+            GdkGC *gc, gint x, gint y, guint color,
+            gint x0, gint y0, gint x1, gint y1 )
+{
+    GdkPixbuf       *pixbuf;
+    guchar          *pixels;
+    gint            rowstride, n_channels;
+    guint           r = getr ( color ), g = getg ( color ), b = getb ( color );
+    guint           a = geta ( color );
+    gint            i, j;
+
+    pixbuf = gdk_pixbuf_get_from_drawable ( NULL, source, NULL,
+                                            x0, y0, 0, 0, x1 - x0, y1 - y0 );
+    g_return_if_fail ( pixbuf != NULL );
+    pixels      = gdk_pixbuf_get_pixels ( pixbuf );
+    rowstride   = gdk_pixbuf_get_rowstride ( pixbuf );
+    n_channels  = gdk_pixbuf_get_n_channels ( pixbuf );
+    for ( j = 0; j < y1 - y0; j++ )
+    {
+        const guchar    *cov = mask->data + ( y0 - y + j ) * mask->width + ( x0 - x );
+        guchar          *p   = pixels + j * rowstride;
+        for ( i = 0; i < x1 - x0; i++, p += n_channels )
+        {
+            guint v = ( cov[i] * a + 127 ) / 255;
+            guint u = 255 - v;
+            if ( v == 0 ) continue;
+            p[0] = ( r * v + p[0] * u + 127 ) / 255;
+            p[1] = ( g * v + p[1] * u + 127 ) / 255;
+            p[2] = ( b * v + p[2] * u + 127 ) / 255;
+        }
+    }
+    gdk_draw_pixbuf ( drawable, gc, pixbuf, 0, 0, x0, y0,
+                      x1 - x0, y1 - y0, GDK_RGB_DITHER_NONE, 0, 0 );
+    g_object_unref ( pixbuf );
+}
+
+void
+gp_mask_fill ( const gp_mask *mask, GdkDrawable *drawable, GdkDrawable *source,
+               GdkGC *gc, GdkRegion *area, gint x, gint y, guint color )
+{
+    GdkRectangle    rect, *rects;
+    GdkRegion       *region;
+    gint            sw, sh, n_rects, i;
+
+    if ( source == NULL ) source = drawable;
+    /*the mask may hang off the canvas once moved*/
+    gdk_drawable_get_size ( source, &sw, &sh );
+    rect.x      = MAX ( x, 0 );
+    rect.y      = MAX ( y, 0 );
+    rect.width  = MIN ( x + mask->width, sw ) - rect.x;
+    rect.height = MIN ( y + mask->height, sh ) - rect.y;
+    if ( rect.width <= 0 || rect.height <= 0 ) return;
+    if ( area == NULL )
+    {
+        fill_rect ( mask, drawable, source, gc, x, y, color,
+                    rect.x, rect.y, rect.x + rect.width, rect.y + rect.height );
+        return;
+    }
+
+    region = gdk_region_rectangle ( &rect );
+    gdk_region_intersect ( region, area );
+    gdk_region_get_rectangles ( region, &rects, &n_rects );
+    for ( i = 0; i < n_rects; i++ )
+    {
+        GdkRectangle *r = &rects[i];
+        fill_rect ( mask, drawable, source, gc, x, y, color,
+                    r->x, r->y, r->x + r->width, r->y + r->height );
+    }
+    g_free ( rects );
+    gdk_region_destroy ( region );
+}
@@ -0,0 +1,74 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor Boston, MA 02110-1301,  USA
+ */
+ 
+#ifndef __GP_MASK_H__
+#define __GP_MASK_H__
+
+#include <gtk/gtk.h>
+#include "gp_shape.h"
+
+/*
+ * Selection mask: one coverage byte per pixel over a bounding box,
+ * rows packed with no padding. 0 is outside, 255 fully selected and
+ * the values between are the anti-aliased edge.
+ */
+
+typedef struct
+{
+    gint    x, y;           /* top left pixel, canvas coordinates   */
+    gint    width;
+    gint    height;
+    guchar  *data;          /* width * height coverage, 0 - 255     */
+} gp_mask;
+
+typedef enum
+{
+    GP_MASK_REPLACE,
+    GP_MASK_ADD,
+    GP_MASK_SUBTRACT
+} gp_mask_op;
+
+gp_mask *   gp_mask_new             ( gint x, gint y,
+                                      gint width, gint height );
+/* NULL when the spans are empty */
+gp_mask *   gp_mask_new_from_spans  ( const gp_span_list *sl );
+/* area of data, a rowstride wide canvas sized mask; any non zero
+ * byte is selected */
+gp_mask *   gp_mask_new_from_data   ( const guchar *data, gint rowstride,
+                                      const GdkRectangle *area );
+gp_mask *   gp_mask_copy            ( const gp_mask *mask );
+void        gp_mask_free            ( gp_mask *mask );
+
+/* the same turns gdk_pixbuf_flip and gdk_pixbuf_rotate_simple make */
+void        gp_mask_flip            ( gp_mask *mask, gboolean horizontal );
+void        gp_mask_rotate          ( gp_mask *mask, GdkPixbufRotation angle );
+
+/* a op b as a new mask trimmed to what is left, NULL when that is
+ * nothing; either may be NULL for an empty mask */
+gp_mask *   gp_mask_combine         ( const gp_mask *a, const gp_mask *b,
+                                      gp_mask_op op );
+
+/* blend color, a col_rgba() whose alpha scales the coverage, over
+ * source into drawable through the mask placed at x, y; a NULL
+ * source is the drawable itself, a NULL area the whole mask */
+void        gp_mask_fill            ( const gp_mask *mask,
+                                      GdkDrawable *drawable,
+                                      GdkDrawable *source,
+                                      GdkGC *gc, GdkRegion *area,
+                                      gint x, gint y,
+                                      guint color );
+
+#endif /*__GP_MASK_H__*/
@@ -0,0 +1,1412 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor Boston, MA 02110-1301,  USA
+ */
+
+#include "gp_shape.h"
+#include "pixbuf_util.h"
+#include <string.h>
+#include <math.h>
+
+#define BAND_ROWS       64      /* rows accumulated at a time           */
+#define FLATTEN_TOL     0.125   /* max distance of arc chords, pixels   */
+#define DAMAGE_TILE     32      /* granularity of gp_shape_damage       */
+#define SCAN_SUBSAMPLE  16      /* sub-scanlines per row, polygon fill  */
+#define MITER_LIMIT     10.0    /* longest miter in half line widths,   *
+                                 * about the 11 degrees X allows        */
+
+typedef struct
+{
+    gdouble x0, y0;
+    gdouble x1, y1;
+} gp_edge;
+
+typedef struct
+{
+    gdouble x, y;
+} gp_dpoint;
+
+/*edge table entry of the scanline filler*/
+typedef struct
+{
+    gdouble y_top, y_bottom;
+    gdouble x_top;
+    gdouble x;              /* at the current sub-scanline        */
+    gdouble dxdy;
+    gint    dir;            /* +1 downwards, -1 upwards            */
+} gp_scan_edge;
+
+/*edges of the shape being built*/
+static GArray   *edges      = NULL;
+static GArray   *contour    = NULL;
+static GArray   *polyline   = NULL;     /* centre line being stroked  */
+static GArray   *scan_table = NULL;     /* gp_scan_edge, by y_top     */
+static GPtrArray *scan_active = NULL;   /* edges on the sub-scanline  */
+static gfloat   *acc        = NULL;
+static gsize    acc_size    = 0;
+
+static void     path_begin          ( void );
+static void     contour_add         ( gdouble x, gdouble y );
+static void     contour_close       ( gint sign );
+static void     add_round_rect      ( gdouble x0, gdouble y0,
+                                      gdouble x1, gdouble y1,
+                                      gdouble rx, gdouble ry, gint sign );
+static void     flatten_cubic       ( const gp_dpoint *p, gint depth );
+static void     stroke_path         ( gboolean closed,
+                                      const gp_stroke_style *style );
+static void     add_join            ( const gp_dpoint *p,
+                                      gdouble ax, gdouble ay,
+                                      gdouble bx, gdouble by,
+                                      gdouble hw, GdkJoinStyle join );
+static void     add_cap             ( const gp_dpoint *p,
+                                      gdouble dx, gdouble dy,
+                                      gdouble hw, GdkCapStyle cap );
+static void     add_disc            ( const gp_dpoint *p, gdouble r );
+static void     rasterize           ( gp_span_list *sl,
+                                      const GdkRectangle *clip );
+static void     scanline_fill       ( gp_span_list *sl,
+                                      const GdkRectangle *clip,
+                                      gp_fill_rule rule );
+static gint     scan_edge_compare   ( gconstpointer a, gconstpointer b );
+static void     accumulate_interval ( gfloat *a, gdouble xa, gdouble xb,
+                                      gfloat weight );
+static void     accumulate_line     ( gfloat *a, gint stride, gint rows,
+                                      gdouble x0, gdouble y0,
+                                      gdouble x1, gdouble y1 );
+static void     accumulate_clipped  ( gfloat *a, gint stride, gint rows,
+                                      gint width,
+                                      gdouble x0, gdouble y0,
+                                      gdouble x1, gdouble y1 );
+static void     spans_from_row      ( gp_span_list *sl, const gfloat *a,
+                                      gint width, gint x, gint y );
+static gint     first_span          ( const gp_span_list *sl, gint y );
+static void     tiles_to_region     ( GdkRegion *region,
+                                      const GdkRectangle *bounds,
+                                      const guchar *tiles, gint tw, gint th );
+static void     runs_append         ( gp_span_runs *runs, GArray *pairs,
+                                      gint y, gint x, gint width );
+static gint *   runs_index          ( const gp_span_runs *runs, gint **start );
+static GdkRegion * runs_damage      ( const gp_span_runs *runs );
+static void     copy_tile_runs      ( const gp_span_runs *runs,
+                                      const gint *first, const gint *start,
+                                      const GdkRectangle *r, GdkPixbuf *tile,
+                                      guchar *pixels, gboolean to_tile );
+static void     render_rect         ( GdkDrawable *drawable,
+                                      GdkDrawable *source, GdkGC *gc,
+                                      const GdkRectangle *rect,
+                                      const gp_span_list *fill,
+                                      guint fill_color,
+                                      const gp_span_list *outline,
+                                      guint outline_color );
+
+
+void
+gp_stroke_style_from_gc ( gp_stroke_style *style, GdkGC *gc )
+{
+    GdkGCValues values;
+    gdk_gc_get_values ( gc, &values );
+    style->width    = MAX ( values.line_width, 1 );
+    style->cap      = values.cap_style;
+    style->join     = values.join_style;
+}
+
+gp_span_list *
+gp_span_list_new ( void )
+{
+    gp_span_list *sl = g_slice_new0 ( gp_span_list );
+    sl->spans       = g_array_new ( FALSE, FALSE, sizeof(gp_span) );
+    sl->coverage    = g_byte_array_new ();
+    return sl;
+}
+
+void
+gp_span_list_free ( gp_span_list *sl )
+{
+    if ( sl == NULL ) return;
+    g_array_free ( sl->spans, TRUE );
+    g_byte_array_free ( sl->coverage, TRUE );
+    g_slice_free ( gp_span_list, sl );
+}
+
+void
+gp_span_list_clear ( gp_span_list *sl )
+{
+    g_array_set_size ( sl->spans, 0 );
+    g_byte_array_set_size ( sl->coverage, 0 );
+    sl->bounds.x = sl->bounds.y = 0;
+    sl->bounds.width = sl->bounds.height = 0;
+}
+
+/*
+ * Merge the two sorted lists into whole pixel runs, row by row. A run
+ * is kept as its x from bounds.x and its width, both 16 bit as every
+ * GDK coordinate is.
+ */
+gp_span_runs *
+gp_span_runs_new ( const gp_span_list *a, const gp_span_list *b )
+{
+    gp_span_runs    *runs;
+    GArray          *pairs;
+    const gp_span   *pa = ( a != NULL ) ? (gp_span *)a->spans->data : NULL;
+    const gp_span   *pb = ( b != NULL ) ? (gp_span *)b->spans->data : NULL;
+    const gp_span   *ea = ( a != NULL ) ? pa + a->spans->len : NULL;
+    const gp_span   *eb = ( b != NULL ) ? pb + b->spans->len : NULL;
+    GdkRectangle    bounds = gp_shape_bounds ( a, b );
+    gint            y = 0, x = 0, width = 0;
+    gboolean        open = FALSE;
+
+    if ( bounds.width <= 0 || bounds.height <= 0 ) return NULL;
+
+    runs            = g_slice_new0 ( gp_span_runs );
+    runs->bounds    = bounds;
+    runs->n_runs    = g_new0 ( guint16, bounds.height );
+    pairs           = g_array_new ( FALSE, FALSE, 2 * sizeof(guint16) );
+    /*both lists are sorted by row then column, merge them in order*/
+    while ( pa != ea || pb != eb )
+    {
+        const gp_span *next;
+        if ( pb == eb || ( pa != ea && ( pa->y < pb->y ||
+             ( pa->y == pb->y && pa->x <= pb->x ) ) ) )
+        {
+            next = pa++;
+        }
+        else
+        {
+            next = pb++;
+        }
+        if ( open && next->y == y && next->x <= x + width )
+        {
+            width = MAX ( width, next->x + next->width - x );
+            continue;
+        }
+        if ( open ) runs_append ( runs, pairs, y, x, width );
+        y       = next->y;
+        x       = next->x;
+        width   = next->width;
+        open    = TRUE;
+    }
+    if ( open ) runs_append ( runs, pairs, y, x, width );
+
+    runs->runs = g_memdup ( pairs->data, pairs->len * 2 * sizeof(guint16) );
+    g_array_free ( pairs, TRUE );
+    return runs;
+}
+
+void
+gp_span_runs_free ( gp_span_runs *runs )
+{
+    if ( runs == NULL ) return;
+    g_free ( runs->n_runs );
+    g_free ( runs->runs );
+    g_slice_free ( gp_span_runs, runs );
+}
+
+/*
+ * Read back one damage tile run at a time: an outline only costs the
+ * tiles along it, not its bounding box.
+ */
+guchar *
+gp_span_runs_read_pixels ( const gp_span_runs *runs, GdkDrawable *drawable )
+{
+    guchar          *pixels = g_new ( guchar, 3 * MAX ( 1, runs->n_pixels ) );
+    gint            *start;
+    gint            *first  = runs_index ( runs, &start );
+    GdkRegion       *region = runs_damage ( runs );
+    GdkRectangle    *rects;
+    gint            n_rects, i;
+
+    gdk_region_get_rectangles ( region, &rects, &n_rects );
+    for ( i = 0; i < n_rects; i++ )
+    {
+        GdkRectangle    *r = &rects[i];
+        GdkPixbuf       *tile;
+
+        tile = gdk_pixbuf_get_from_drawable ( NULL, drawable, NULL,
+                                              r->x, r->y, 0, 0,
+                                              r->width, r->height );
+        if ( tile == NULL ) continue;
+        copy_tile_runs ( runs, first, start, r, tile, pixels, FALSE );
+        g_object_unref ( tile );
+    }
+    g_free ( rects );
+    gdk_region_destroy ( region );
+    g_free ( first );
+    return pixels;
+}
+
+/*
+ * The same tile runs the other way: each is read back, has its runs
+ * patched in and goes back with a single request.
+ */
+void
+gp_span_runs_write_pixels ( const gp_span_runs *runs, GdkDrawable *drawable,
+                            GdkGC *gc, const guchar *pixels )
+{
+    gint            *start;
+    gint            *first  = runs_index ( runs, &start );
+    GdkRegion       *region = runs_damage ( runs );
+    GdkRectangle    *rects;
+    gint            n_rects, i;
+
+    gdk_region_get_rectangles ( region, &rects, &n_rects );
+    for ( i = 0; i < n_rects; i++ )
+    {
+        GdkRectangle    *r = &rects[i];
+        GdkPixbuf       *tile;
+
+        tile = gdk_pixbuf_get_from_drawable ( NULL, drawable, NULL,
+                                              r->x, r->y, 0, 0,
+                                              r->width, r->height );
+        if ( tile == NULL ) continue;
+        copy_tile_runs ( runs, first, start, r, tile, (guchar *)pixels, TRUE );
+        gdk_draw_pixbuf ( drawable, gc, tile, 0, 0, r->x, r->y,
+                          r->width, r->height, GDK_RGB_DITHER_NONE, 0, 0 );
+        g_object_unref ( tile );
+    }
+    g_free ( rects );
+    gdk_region_destroy ( region );
+    g_free ( first );
+}
+
+void
+gp_shape_fill_polygon ( gp_span_list *sl, const GdkRectangle *clip,
+                        const GdkPoint *points, gint n_points,
+                        gp_fill_rule rule )
+{
+    gint i;
+    path_begin ();
+    for ( i = 0; i < n_points; i++ )
+    {
+        contour_add ( points[i].x + 0.5, points[i].y + 0.5 );
+    }
+    /*keep the direction of every edge, the fill rule needs it*/
+    contour_close ( 0 );
+    scanline_fill ( sl, clip, rule );
+}
+
+void
+gp_shape_stroke_polyline ( gp_span_list *sl, const GdkRectangle *clip,
+                           const GdkPoint *points, gint n_points,
+                           gboolean closed, const gp_stroke_style *style )
+{
+    gint i;
+
+    path_begin ();
+    for ( i = 0; i < n_points; i++ )
+    {
+        gp_dpoint p = { points[i].x + 0.5, points[i].y + 0.5 };
+        g_array_append_val ( polyline, p );
+    }
+    stroke_path ( closed, style );
+    rasterize ( sl, clip );
+}
+
+void
+gp_shape_stroke_curve ( gp_span_list *sl, const GdkRectangle *clip,
+                        const GdkPoint *points, const gp_stroke_style *style )
+{
+    gp_dpoint   p[4];
+    gint        i;
+
+    for ( i = 0; i < 4; i++ )
+    {
+        p[i].x = points[i].x + 0.5;
+        p[i].y = points[i].y + 0.5;
+    }
+    path_begin ();
+    g_array_append_val ( polyline, p[0] );
+    flatten_cubic ( p, 0 );
+    stroke_path ( FALSE, style );
+    rasterize ( sl, clip );
+}
+
+void
+gp_shape_fill_rectangle ( gp_span_list *sl, const GdkRectangle *clip,
+                          gint x, gint y, gint width, gint height,
+                          gdouble rx, gdouble ry )
+{
+    path_begin ();
+    add_round_rect ( x + 0.5, y + 0.5, x + width + 0.5, y + height + 0.5,
+                     rx, ry, 1 );
+    rasterize ( sl, clip );
+}
+
+/*
+ * Sharp corners are stroked as a closed line, so they get the joins of
+ * the style. Rounded ones are a ring between the outline grown and
+ * shrunk by half the line width.
+ */
+void
+gp_shape_stroke_rectangle ( gp_span_list *sl, const GdkRectangle *clip,
+                            gint x, gint y, gint width, gint height,
+                            gdouble rx, gdouble ry,
+                            const gp_stroke_style *style )
+{
+    gdouble hw = MAX ( style->width, 1 ) / 2.0;
+    gdouble x0 = x + 0.5;
+    gdouble y0 = y + 0.5;
+    gdouble x1 = x0 + width;
+    gdouble y1 = y0 + height;
+
+    rx = MIN ( rx, width / 2.0 );
+    ry = MIN ( ry, height / 2.0 );
+    path_begin ();
+    if ( rx <= 0.0 || ry <= 0.0 )
+    {
+        gp_dpoint corners[4] = { { x0, y0 }, { x1, y0 }, { x1, y1 }, { x0, y1 } };
+        g_array_append_vals ( polyline, corners, 4 );
+        stroke_path ( TRUE, style );
+        rasterize ( sl, clip );
+        return;
+    }
+    add_round_rect ( x0 - hw, y0 - hw, x1 + hw, y1 + hw,
+                     rx + hw, ry + hw, 1 );
+    if ( x1 - x0 > 2 * hw && y1 - y0 > 2 * hw )
+    {
+        add_round_rect ( x0 + hw, y0 + hw, x1 - hw, y1 - hw,
+                         MAX ( rx - hw, 0.0 ), MAX ( ry - hw, 0.0 ), -1 );
+    }
+    rasterize ( sl, clip );
+}
+
+GdkRectangle
+gp_shape_render ( GdkDrawable *drawable, GdkDrawable *source, GdkGC *gc,
+                  GdkRegion *area,
+                  const gp_span_list *fill, guint fill_color,
+                  const gp_span_list *outline, guint outline_color )
+{
+    GdkRectangle    rect = gp_shape_bounds ( fill, outline );
+    GdkRectangle    *rects;
+    GdkRegion       *region;
+    gint            n_rects, i;
+
+    if ( rect.width <= 0 || rect.height <= 0 ) return rect;
+    if ( source == NULL ) source = drawable;
+    if ( area == NULL )
+    {
+        render_rect ( drawable, source, gc, &rect,
+                      fill, fill_color, outline, outline_color );
+        return rect;
+    }
+
+    region = gdk_region_rectangle ( &rect );
+    gdk_region_intersect ( region, area );
+    gdk_region_get_rectangles ( region, &rects, &n_rects );
+    for ( i = 0; i < n_rects; i++ )
+    {
+        render_rect ( drawable, source, gc, &rects[i],
+                      fill, fill_color, outline, outline_color );
+    }
+    g_free ( rects );
+    gdk_region_destroy ( region );
+    return rect;
+}
+
+GdkRectangle
+gp_shape_bounds ( const gp_span_list *fill, const gp_span_list *outline )
+{
+    GdkRectangle rect = { 0, 0, 0, 0 };
+
+    if ( fill != NULL && fill->spans->len > 0 )
+    {
+        rect = fill->bounds;
+    }
+    if ( outline != NULL && outline->spans->len > 0 )
+    {
+        if ( rect.width == 0 ) rect = outline->bounds;
+        else gdk_rectangle_union ( &rect, (GdkRectangle *)&outline->bounds, &rect );
+    }
+    return rect;
+}
+
+GdkRegion *
+gp_shape_damage ( const gp_span_list *fill, const gp_span_list *outline )
+{
+    GdkRectangle        bounds  = gp_shape_bounds ( fill, outline );
+    GdkRegion           *region = gdk_region_new ();
+    const gp_span_list  *lists[2];
+    guchar              *tiles;
+    gint                tw, th, i, j;
+
+    if ( bounds.width == 0 ) return region;
+
+    tw      = ( bounds.width + DAMAGE_TILE - 1 ) / DAMAGE_TILE;
+    th      = ( bounds.height + DAMAGE_TILE - 1 ) / DAMAGE_TILE;
+    tiles   = g_new0 ( guchar, tw * th );
+    lists[0] = fill;
+    lists[1] = outline;
+    for ( i = 0; i < 2; i++ )
+    {
+        if ( lists[i] == NULL ) continue;
+        for ( j = 0; j < lists[i]->spans->len; j++ )
+        {
+            const gp_span *span = &g_array_index ( lists[i]->spans, gp_span, j );
+            gint    row = ( span->y - bounds.y ) / DAMAGE_TILE;
+            gint    t0  = ( span->x - bounds.x ) / DAMAGE_TILE;
+            gint    t1  = ( span->x + span->width - 1 - bounds.x ) / DAMAGE_TILE;
+            memset ( tiles + row * tw + t0, 1, t1 - t0 + 1 );
+        }
+    }
+
+    tiles_to_region ( region, &bounds, tiles, tw, th );
+    g_free ( tiles );
+    return region;
+}
+
+/*private functions*/
+
+/* one rectangle per run of marked DAMAGE_TILE tiles over bounds */
+static void
+tiles_to_region ( GdkRegion *region, const GdkRectangle *bounds,
+                  const guchar *tiles, gint tw, gint th )
+{
+    gint tx, ty;
+
+    for ( ty = 0; ty < th; ty++ )
+    {
+        for ( tx = 0; tx < tw; tx++ )
+        {
+            GdkRectangle r;
+            gint start = tx;
+            if ( !tiles[ty * tw + tx] ) continue;
+            while ( tx < tw && tiles[ty * tw + tx] ) tx++;
+            r.x         = bounds->x + start * DAMAGE_TILE;
+            r.y         = bounds->y + ty * DAMAGE_TILE;
+            r.width     = MIN ( ( tx - start ) * DAMAGE_TILE,
+                                bounds->x + bounds->width - r.x );
+            r.height    = MIN ( DAMAGE_TILE, bounds->y + bounds->height - r.y );
+            gdk_region_union_with_rect ( region, &r );
+        }
+    }
+}
+
+static void
+runs_append ( gp_span_runs *runs, GArray *pairs, gint y, gint x, gint width )
+{
+    guint16 pair[2];
+
+    pair[0] = x - runs->bounds.x;
+    pair[1] = width;
+    g_array_append_vals ( pairs, pair, 1 );
+    runs->n_runs[y - runs->bounds.y]++;
+    runs->n_pixels += width;
+}
+
+/*
+ * Index of the first run of every row and of the end after them, with
+ * start pointing at where each row begins in the packed pixels; one
+ * allocation for both.
+ */
+static gint *
+runs_index ( const gp_span_runs *runs, gint **start )
+{
+    gint    h       = runs->bounds.height;
+    gint    *first  = g_new ( gint, 2 * ( h + 1 ) );
+    gint    row, k;
+
+    *start      = first + h + 1;
+    first[0]    = 0;
+    (*start)[0] = 0;
+    for ( row = 0; row < h; row++ )
+    {
+        first[row + 1]      = first[row] + runs->n_runs[row];
+        (*start)[row + 1]   = (*start)[row];
+        for ( k = first[row]; k < first[row + 1]; k++ )
+        {
+            (*start)[row + 1] += runs->runs[2 * k + 1];
+        }
+    }
+    return first;
+}
+
+/* the DAMAGE_TILE tiles under the runs, as gp_shape_damage */
+static GdkRegion *
+runs_damage ( const gp_span_runs *runs )
+{
+    const GdkRectangle  *bounds = &runs->bounds;
+    GdkRegion           *region = gdk_region_new ();
+    const guint16       *pair   = runs->runs;
+    guchar              *tiles;
+    gint                tw, th, row, k;
+
+    tw      = ( bounds->width + DAMAGE_TILE - 1 ) / DAMAGE_TILE;
+    th      = ( bounds->height + DAMAGE_TILE - 1 ) / DAMAGE_TILE;
+    tiles   = g_new0 ( guchar, tw * th );
+    for ( row = 0; row < bounds->height; row++ )
+    {
+        for ( k = 0; k < runs->n_runs[row]; k++, pair += 2 )
+        {
+            gint t0 = pair[0] / DAMAGE_TILE;
+            gint t1 = ( pair[0] + pair[1] - 1 ) / DAMAGE_TILE;
+            memset ( tiles + ( row / DAMAGE_TILE ) * tw + t0, 1, t1 - t0 + 1 );
+        }
+    }
+    tiles_to_region ( region, bounds, tiles, tw, th );
+    g_free ( tiles );
+    return region;
+}
+
+/*
+ * Copy the runs inside tile run r between the packed buffer and the
+ * tile pixels read back from the drawable: to_tile writes the runs
+ * into the tile, otherwise they are read out of it. first and start
+ * are from runs_index().
+ */
+static void
+copy_tile_runs ( const gp_span_runs *runs, const gint *first,
+                 const gint *start, const GdkRectangle *r, GdkPixbuf *tile,
+                 guchar *pixels, gboolean to_tile )
+{
+    guchar  *data       = gdk_pixbuf_get_pixels ( tile );
+    gint    rowstride   = gdk_pixbuf_get_rowstride ( tile );
+    gint    n_channels  = gdk_pixbuf_get_n_channels ( tile );
+    gint    row0        = MAX ( r->y - runs->bounds.y, 0 );
+    gint    row1        = MIN ( r->y + r->height - runs->bounds.y,
+                                runs->bounds.height );
+    gint    row, k;
+
+    for ( row = row0; row < row1; row++ )
+    {
+        gint offset = start[row];
+        for ( k = first[row]; k < first[row + 1]; k++ )
+        {
+            gint    x       = runs->bounds.x + runs->runs[2 * k];
+            gint    width   = runs->runs[2 * k + 1];
+            guchar  *t, *p;
+            gint    i;
+
+            p       = pixels + offset * 3;
+            offset += width;
+            /*a run lies in a single run of tiles*/
+            if ( x < r->x || x >= r->x + r->width ) continue;
+            t = data + ( runs->bounds.y + row - r->y ) * rowstride +
+                ( x - r->x ) * n_channels;
+            for ( i = 0; i < width; i++, t += n_channels, p += 3 )
+            {
+                if ( to_tile )
+                {
+                    t[0] = p[0];
+                    t[1] = p[1];
+                    t[2] = p[2];
+                }
+                else
+                {
+                    p[0] = t[0];
+                    p[1] = t[1];
+                    p[2] = t[2];
+                }
+            }
+        }
+    }
+}
+
+/* first span on or below row y, spans are sorted by row */
+static gint
+first_span ( const gp_span_list *sl, gint y )
+{
+    gint lo = 0, hi = sl->spans->len;
+    while ( lo < hi )
+    {
+        gint mid = ( lo + hi ) / 2;
+        if ( g_array_index ( sl->spans, gp_span, mid ).y < y ) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+static void
+render_rect ( GdkDrawable *drawable, GdkDrawable *source, GdkGC *gc,
+              const GdkRectangle *rect,
+              const gp_span_list *fill, guint fill_color,
+              const gp_span_list *outline, guint outline_color )
+{
+    const gp_span_list  *lists[2];
+    guint               colors[2];
+    GdkPixbuf           *pixbuf;
+    guchar              *pixels;
+    gint                rowstride;
+    gint                i, j, x;
+
+    lists[0] = fill;
+    lists[1] = outline;
+    colors[0] = fill_color;
+    colors[1] = outline_color;
+
+    pixbuf = gdk_pixbuf_new ( GDK_COLORSPACE_RGB, TRUE, 8, rect->width, rect->height );
+    gdk_pixbuf_get_from_drawable ( pixbuf, source, NULL,
+                                   rect->x, rect->y, 0, 0,
+                                   rect->width, rect->height );
+    pixels      = gdk_pixbuf_get_pixels ( pixbuf );
+    rowstride   = gdk_pixbuf_get_rowstride ( pixbuf );
+
+    for ( i = 0; i < 2; i++ )
+    {
+        guint   r, g, b, a;
+        if ( lists[i] == NULL ) continue;
+        r = getr ( colors[i] );
+        g = getg ( colors[i] );
+        b = getb ( colors[i] );
+        a = geta ( colors[i] );
+        for ( j = first_span ( lists[i], rect->y ); j < lists[i]->spans->len; j++ )
+        {
+            const gp_span   *span = &g_array_index ( lists[i]->spans, gp_span, j );
+            gint            x0, x1;
+            guchar          *dst;
+
+            if ( span->y >= rect->y + rect->height ) break;
+            x0  = MAX ( span->x, rect->x );
+            x1  = MIN ( span->x + span->width, rect->x + rect->width );
+            if ( x0 >= x1 ) continue;
+            dst = pixels + ( span->y - rect->y ) * rowstride + ( x0 - rect->x ) * 4;
+            if ( span->offset < 0 && a == 255 )
+            {
+                for ( x = x0; x < x1; x++, dst += 4 )
+                {
+                    dst[0] = r;
+                    dst[1] = g;
+                    dst[2] = b;
+                }
+            }
+            else
+            {
+                const guchar *cov = ( span->offset < 0 ) ? NULL :
+                                    lists[i]->coverage->data + span->offset - span->x;
+                for ( x = x0; x < x1; x++, dst += 4 )
+                {
+                    guint v = ( cov != NULL ) ? ( cov[x] * a + 127 ) / 255 : a;
+                    guint u = 255 - v;
+                    dst[0] = ( r * v + dst[0] * u + 127 ) / 255;
+                    dst[1] = ( g * v + dst[1] * u + 127 ) / 255;
+                    dst[2] = ( b * v + dst[2] * u + 127 ) / 255;
+                }
+            }
+        }
+    }
+
+    gdk_draw_pixbuf ( drawable, gc, pixbuf, 0, 0, rect->x, rect->y,
+                      rect->width, rect->height, GDK_RGB_DITHER_NONE, 0, 0 );
+    g_object_unref ( pixbuf );
+}
+
+static void
+path_begin ( void )
+{
+    if ( edges == NULL )
+    {
+        edges   = g_array_new ( FALSE, FALSE, sizeof(gp_edge) );
+        contour = g_array_new ( FALSE, FALSE, sizeof(gp_dpoint) );
+        polyline = g_array_new ( FALSE, FALSE, sizeof(gp_dpoint) );
+    }
+    g_array_set_size ( edges, 0 );
+    g_array_set_size ( contour, 0 );
+    g_array_set_size ( polyline, 0 );
+}
+
+static void
+contour_add ( gdouble x, gdouble y )
+{
+    gp_dpoint p = { x, y };
+    g_array_append_val ( contour, p );
+}
+
+/*
+ * Turn the pending contour into edges, winding as sign asks for,
+ * or as drawn when sign is 0.
+ */
+static void
+contour_close ( gint sign )
+{
+    gp_dpoint   *p  = (gp_dpoint *)contour->data;
+    gint        n   = contour->len;
+    gdouble     area = 0.0;
+    gint        i;
+
+    for ( i = 0; i < n; i++ )
+    {
+        gp_dpoint *q = &p[( i + 1 ) % n];
+        area += p[i].x * q->y - q->x * p[i].y;
+    }
+    for ( i = 0; i < n; i++ )
+    {
+        gp_dpoint   *a = &p[i];
+        gp_dpoint   *b = &p[( i + 1 ) % n];
+        gp_edge     e;
+        if ( a->y == b->y ) continue;
+        if ( sign != 0 && ( area < 0.0 ) == ( sign > 0 ) )
+        {
+            gp_dpoint *t = a; a = b; b = t;
+        }
+        e.x0 = a->x; e.y0 = a->y;
+        e.x1 = b->x; e.y1 = b->y;
+        g_array_append_val ( edges, e );
+    }
+    g_array_set_size ( contour, 0 );
+}
+
+/*
+ * Split the curve in halves until its control points are within
+ * FLATTEN_TOL of the chord, then emit the end point. The test is the
+ * usual bound on how far a cubic strays from its chord, so a straight
+ * stretch costs one segment and only tight bends get subdivided.
+ */
+static void
+flatten_cubic ( const gp_dpoint *p, gint depth )
+{
+    gdouble     ux  = 3.0 * p[1].x - 2.0 * p[0].x - p[3].x;
+    gdouble     uy  = 3.0 * p[1].y - 2.0 * p[0].y - p[3].y;
+    gdouble     vx  = 3.0 * p[2].x - p[0].x - 2.0 * p[3].x;
+    gdouble     vy  = 3.0 * p[2].y - p[0].y - 2.0 * p[3].y;
+    gp_dpoint   l[4], r[4], m;
+
+    ux *= ux; uy *= uy;
+    vx *= vx; vy *= vy;
+    if ( depth >= 16 ||
+         MAX ( ux, vx ) + MAX ( uy, vy ) <= 16.0 * FLATTEN_TOL * FLATTEN_TOL )
+    {
+        g_array_append_val ( polyline, p[3] );
+        return;
+    }
+
+    /*de Casteljau at t = 0.5*/
+    m.x     = ( p[1].x + p[2].x ) / 2.0;
+    m.y     = ( p[1].y + p[2].y ) / 2.0;
+    l[0]    = p[0];
+    l[1].x  = ( p[0].x + p[1].x ) / 2.0;
+    l[1].y  = ( p[0].y + p[1].y ) / 2.0;
+    r[3]    = p[3];
+    r[2].x  = ( p[2].x + p[3].x ) / 2.0;
+    r[2].y  = ( p[2].y + p[3].y ) / 2.0;
+    l[2].x  = ( l[1].x + m.x ) / 2.0;
+    l[2].y  = ( l[1].y + m.y ) / 2.0;
+    r[1].x  = ( m.x + r[2].x ) / 2.0;
+    r[1].y  = ( m.y + r[2].y ) / 2.0;
+    l[3].x  = r[0].x = ( l[2].x + r[1].x ) / 2.0;
+    l[3].y  = r[0].y = ( l[2].y + r[1].y ) / 2.0;
+    flatten_cubic ( l, depth + 1 );
+    flatten_cubic ( r, depth + 1 );
+}
+
+/*
+ * The stroke is the union of one quad per segment of the centre line,
+ * a join piece on the outside of every turn and the caps. All the
+ * pieces wind the same way, so overlaps add up instead of cancelling
+ * and the whole outline is filled in one pass, each pixel once.
+ */
+static void
+stroke_path ( gboolean closed, const gp_stroke_style *style )
+{
+    gp_dpoint   *pts    = (gp_dpoint *)polyline->data;
+    gdouble     hw      = MAX ( style->width, 1 ) / 2.0;
+    gint        n       = 0;
+    gint        n_seg, i;
+    gdouble     *dir;
+
+    /*repeated points have no direction*/
+    for ( i = 0; i < polyline->len; i++ )
+    {
+        if ( n == 0 || fabs ( pts[i].x - pts[n - 1].x ) > 1e-6 ||
+             fabs ( pts[i].y - pts[n - 1].y ) > 1e-6 )
+        {
+            pts[n++] = pts[i];
+        }
+    }
+    if ( closed && n > 1 && fabs ( pts[n - 1].x - pts[0].x ) < 1e-6 &&
+         fabs ( pts[n - 1].y - pts[0].y ) < 1e-6 )
+    {
+        n--;
+    }
+    g_array_set_size ( polyline, n );
+    if ( n == 0 ) return;
+    if ( n == 1 )
+    {
+        /*a dot, the cap shape centred on the point*/
+        if ( style->cap == GDK_CAP_ROUND )
+        {
+            add_disc ( &pts[0], hw );
+        }
+        else if ( style->cap == GDK_CAP_PROJECTING )
+        {
+            add_round_rect ( pts[0].x - hw, pts[0].y - hw,
+                             pts[0].x + hw, pts[0].y + hw, 0, 0, 1 );
+        }
+        return;
+    }
+
+    n_seg   = closed ? n : n - 1;
+    dir     = g_new ( gdouble, 2 * n_seg );
+    for ( i = 0; i < n_seg; i++ )
+    {
+        const gp_dpoint *p0 = &pts[i];
+        const gp_dpoint *p1 = &pts[( i + 1 ) % n];
+        gdouble         dx  = p1->x - p0->x;
+        gdouble         dy  = p1->y - p0->y;
+        gdouble         len = sqrt ( dx * dx + dy * dy );
+        gdouble         nx, ny;
+
+        dx /= len;
+        dy /= len;
+        dir[2 * i]      = dx;
+        dir[2 * i + 1]  = dy;
+        nx = -dy * hw;
+        ny =  dx * hw;
+        contour_add ( p0->x + nx, p0->y + ny );
+        contour_add ( p1->x + nx, p1->y + ny );
+        contour_add ( p1->x - nx, p1->y - ny );
+        contour_add ( p0->x - nx, p0->y - ny );
+        contour_close ( 1 );
+    }
+    /*joins between segment i - 1 and segment i*/
+    for ( i = closed ? 0 : 1; i < n_seg; i++ )
+    {
+        gint k = ( i + n_seg - 1 ) % n_seg;
+        add_join ( &pts[i], dir[2 * k], dir[2 * k + 1],
+                   dir[2 * i], dir[2 * i + 1], hw, style->join );
+    }
+    if ( !closed )
+    {
+        add_cap ( &pts[0], -dir[0], -dir[1], hw, style->cap );
+        add_cap ( &pts[n - 1], dir[2 * n_seg - 2], dir[2 * n_seg - 1],
+                  hw, style->cap );
+    }
+    g_free ( dir );
+}
+
+/*
+ * Fill the wedge the two segment quads leave open on the outside of
+ * the turn at p, a and b are the unit directions in and out.
+ */
+static void
+add_join ( const gp_dpoint *p, gdouble ax, gdouble ay,
+           gdouble bx, gdouble by, gdouble hw, GdkJoinStyle join )
+{
+    gdouble cross   = ax * by - ay * bx;
+    gdouble dot     = ax * bx + ay * by;
+    gdouble side    = ( cross > 0.0 ) ? -hw : hw;   /* towards the outside */
+    gdouble miter;
+
+    if ( fabs ( cross ) < 1e-9 && dot > 0.0 ) return;
+    /*
+     * the round join only differs from the bevel by how far the arc
+     * bulges past the chord, skip the disc when that is invisible
+     */
+    if ( join == GDK_JOIN_ROUND &&
+         ( dot < 0.0 || hw * ( 1.0 - sqrt ( ( 1.0 + dot ) / 2.0 ) ) > FLATTEN_TOL ) )
+    {
+        add_disc ( p, hw );
+        return;
+    }
+    contour_add ( p->x, p->y );
+    contour_add ( p->x - ay * side, p->y + ax * side );
+    miter = 1.0 / sqrt ( MAX ( ( 1.0 + dot ) / 2.0, 1e-12 ) );
+    if ( join == GDK_JOIN_MITER && miter <= MITER_LIMIT )
+    {
+        /*the offset lines meet on the bisector of the normals*/
+        gdouble mx = ( -ay - by ) * side / ( 1.0 + dot );
+        gdouble my = (  ax + bx ) * side / ( 1.0 + dot );
+        contour_add ( p->x + mx, p->y + my );
+    }
+    contour_add ( p->x - by * side, p->y + bx * side );
+    contour_close ( 1 );
+}
+
+/* end of the line at p, d is the unit direction out of the line */
+static void
+add_cap ( const gp_dpoint *p, gdouble dx, gdouble dy,
+          gdouble hw, GdkCapStyle cap )
+{
+    if ( cap == GDK_CAP_ROUND )
+    {
+        add_disc ( p, hw );
+    }
+    else if ( cap == GDK_CAP_PROJECTING )
+    {
+        gdouble nx = -dy * hw;
+        gdouble ny =  dx * hw;
+        contour_add ( p->x + nx, p->y + ny );
+        contour_add ( p->x + nx + dx * hw, p->y + ny + dy * hw );
+        contour_add ( p->x - nx + dx * hw, p->y - ny + dy * hw );
+        contour_add ( p->x - nx, p->y - ny );
+        contour_close ( 1 );
+    }
+    /*butt and not last end on the point*/
+}
+
+static void
+add_disc ( const gp_dpoint *p, gdouble r )
+{
+    add_round_rect ( p->x - r, p->y - r, p->x + r, p->y + r, r, r, 1 );
+}
+
+static void
+add_round_rect ( gdouble x0, gdouble y0, gdouble x1, gdouble y1,
+                 gdouble rx, gdouble ry, gint sign )
+{
+    gdouble cx[4], cy[4];
+    gdouble r, step;
+    gint    n, i, k;
+
+    rx = MIN ( rx, ( x1 - x0 ) / 2.0 );
+    ry = MIN ( ry, ( y1 - y0 ) / 2.0 );
+    if ( rx <= 0.0 || ry <= 0.0 ) rx = ry = 0.0;
+
+    /*arc centres, clockwise from the top right corner*/
+    cx[0] = x1 - rx; cy[0] = y0 + ry;
+    cx[1] = x1 - rx; cy[1] = y1 - ry;
+    cx[2] = x0 + rx; cy[2] = y1 - ry;
+    cx[3] = x0 + rx; cy[3] = y0 + ry;
+
+    r = MAX ( rx, ry );
+    n = 1;
+    if ( r > FLATTEN_TOL )
+    {
+        n = (gint)ceil ( G_PI_2 / ( 2.0 * acos ( 1.0 - FLATTEN_TOL / r ) ) );
+    }
+    step = G_PI_2 / n;
+    for ( k = 0; k < 4; k++ )
+    {
+        gdouble start = -G_PI_2 + k * G_PI_2;
+        for ( i = 0; i <= n; i++ )
+        {
+            gdouble t = start + i * step;
+            contour_add ( cx[k] + rx * cos ( t ), cy[k] + ry * sin ( t ) );
+        }
+    }
+    contour_close ( sign );
+}
+
+static void
+rasterize ( gp_span_list *sl, const GdkRectangle *clip )
+{
+    gdouble x_min = G_MAXDOUBLE, y_min = G_MAXDOUBLE;
+    gdouble x_max = -G_MAXDOUBLE, y_max = -G_MAXDOUBLE;
+    gint    left, top, right, bottom;
+    gint    width, height, stride;
+    gint    band, i, r;
+
+    gp_span_list_clear ( sl );
+    if ( edges->len == 0 ) return;
+
+    for ( i = 0; i < edges->len; i++ )
+    {
+        gp_edge *e = &g_array_index ( edges, gp_edge, i );
+        x_min = MIN ( x_min, MIN ( e->x0, e->x1 ) );
+        x_max = MAX ( x_max, MAX ( e->x0, e->x1 ) );
+        y_min = MIN ( y_min, MIN ( e->y0, e->y1 ) );
+        y_max = MAX ( y_max, MAX ( e->y0, e->y1 ) );
+    }
+    left    = (gint)floor ( x_min );
+    top     = (gint)floor ( y_min );
+    right   = (gint)ceil ( x_max );
+    bottom  = (gint)ceil ( y_max );
+    if ( clip != NULL )
+    {
+        left    = MAX ( left, clip->x );
+        top     = MAX ( top, clip->y );
+        right   = MIN ( right, clip->x + clip->width );
+        bottom  = MIN ( bottom, clip->y + clip->height );
+    }
+    width   = right - left;
+    height  = bottom - top;
+    if ( width <= 0 || height <= 0 ) return;
+
+    stride  = width + 2;
+    if ( acc_size < (gsize)stride * BAND_ROWS )
+    {
+        g_free ( acc );
+        acc_size    = (gsize)stride * BAND_ROWS;
+        acc         = g_new ( gfloat, acc_size );
+    }
+
+    for ( band = 0; band < height; band += BAND_ROWS )
+    {
+        gint    rows = MIN ( BAND_ROWS, height - band );
+        gdouble b0   = top + band;
+        gdouble b1   = b0 + rows;
+
+        memset ( acc, 0, sizeof(gfloat) * stride * rows );
+        for ( i = 0; i < edges->len; i++ )
+        {
+            gp_edge *e  = &g_array_index ( edges, gp_edge, i );
+            gdouble ya  = MAX ( MIN ( e->y0, e->y1 ), b0 );
+            gdouble yb  = MIN ( MAX ( e->y0, e->y1 ), b1 );
+            gdouble dxdy, xa, xb;
+
+            if ( yb <= ya ) continue;
+            dxdy = ( e->x1 - e->x0 ) / ( e->y1 - e->y0 );
+            xa   = e->x0 + ( ya - e->y0 ) * dxdy;
+            xb   = e->x0 + ( yb - e->y0 ) * dxdy;
+            /*keep the direction, it carries the winding*/
+            if ( e->y0 > e->y1 )
+            {
+                gdouble t;
+                t = xa; xa = xb; xb = t;
+                t = ya; ya = yb; yb = t;
+            }
+            accumulate_clipped ( acc, stride, rows, width,
+                                 xa - left, ya - b0, xb - left, yb - b0 );
+        }
+        for ( r = 0; r < rows; r++ )
+        {
+            spans_from_row ( sl, acc + r * stride, width, left, top + band + r );
+        }
+    }
+}
+
+/*
+ * Signed area accumulation: every line adds, to the cells it crosses,
+ * the change in covered area it causes in that row, so a running sum
+ * along the row gives the exact coverage of each pixel.
+ * Needs 0 <= x <= stride - 2 and 0 <= y <= rows.
+ */
+static void
+accumulate_line ( gfloat *a, gint stride, gint rows,
+                  gdouble x0, gdouble y0, gdouble x1, gdouble y1 )
+{
+    gdouble dir, dxdy, x;
+    gint    y, y_end;
+
+    if ( fabs ( y1 - y0 ) < 1e-9 ) return;
+    if ( y0 < y1 )
+    {
+        dir = 1.0;
+    }
+    else
+    {
+        gdouble t;
+        dir = -1.0;
+        t = x0; x0 = x1; x1 = t;
+        t = y0; y0 = y1; y1 = t;
+    }
+    dxdy    = ( x1 - x0 ) / ( y1 - y0 );
+    x       = x0;
+    y_end   = MIN ( rows, (gint)ceil ( y1 ) );
+
+    for ( y = (gint)y0; y < y_end; y++ )
+    {
+        gfloat  *line   = a + y * stride;
+        gdouble dy      = MIN ( y + 1.0, y1 ) - MAX ( (gdouble)y, y0 );
+        gdouble x_next  = x + dxdy * dy;
+        gdouble d       = dy * dir;
+        gdouble xl      = MIN ( x, x_next );
+        gdouble xr      = MAX ( x, x_next );
+        gdouble xl_floor = floor ( xl );
+        gint    xli     = (gint)xl_floor;
+        gint    xri     = (gint)ceil ( xr );
+
+        if ( xri <= xli + 1 )
+        {
+            /*the line stays in one cell*/
+            gdouble xm = 0.5 * ( x + x_next ) - xl_floor;
+            line[xli]       += d - d * xm;
+            line[xli + 1]   += d * xm;
+        }
+        else
+        {
+            gdouble s   = 1.0 / ( xr - xl );
+            gdouble xlf = xl - xl_floor;
+            gdouble a0  = 0.5 * s * ( 1.0 - xlf ) * ( 1.0 - xlf );
+            gdouble xrf = xr - xri + 1.0;
+            gdouble am  = 0.5 * s * xrf * xrf;
+            gint    xi;
+
+            line[xli] += d * a0;
+            if ( xri == xli + 2 )
+            {
+                line[xli + 1] += d * ( 1.0 - a0 - am );
+            }
+            else
+            {
+                gdouble a1 = s * ( 1.5 - xlf );
+                gdouble a2;
+                line[xli + 1] += d * ( a1 - a0 );
+                for ( xi = xli + 2; xi < xri - 1; xi++ )
+                {
+                    line[xi] += d * s;
+                }
+                a2 = a1 + ( xri - xli - 3 ) * s;
+                line[xri - 1] += d * ( 1.0 - a2 - am );
+            }
+            line[xri] += d * am;
+        }
+        x = x_next;
+    }
+}
+
+/*
+ * Parts of a line left or right of the raster are pressed against its
+ * side: they still carry their winding into the row, without touching
+ * cells outside the buffer.
+ */
+static void
+accumulate_clipped ( gfloat *a, gint stride, gint rows, gint width,
+                     gdouble x0, gdouble y0, gdouble x1, gdouble y1 )
+{
+    gdouble t[4];
+    gint    n = 0, i;
+
+    t[n++] = 0.0;
+    if ( x1 != x0 )
+    {
+        gdouble tl = ( 0.0 - x0 ) / ( x1 - x0 );
+        gdouble tr = ( width - x0 ) / ( x1 - x0 );
+        if ( tl > tr ) { gdouble tt = tl; tl = tr; tr = tt; }
+        if ( tl > 0.0 && tl < 1.0 ) t[n++] = tl;
+        if ( tr > 0.0 && tr < 1.0 ) t[n++] = tr;
+    }
+    t[n++] = 1.0;
+
+    for ( i = 0; i + 1 < n; i++ )
+    {
+        gdouble xa = x0 + ( x1 - x0 ) * t[i];
+        gdouble xb = x0 + ( x1 - x0 ) * t[i + 1];
+        gdouble ya = y0 + ( y1 - y0 ) * t[i];
+        gdouble yb = y0 + ( y1 - y0 ) * t[i + 1];
+        accumulate_line ( a, stride, rows,
+                          CLAMP ( xa, 0.0, (gdouble)width ), ya,
+                          CLAMP ( xb, 0.0, (gdouble)width ), yb );
+    }
+}
+
+/*
+ * Polygon fill from an edge table sorted on the top of the edges and
+ * an active edge list kept in x order. Each row is sampled on
+ * SCAN_SUBSAMPLE sub-scanlines and the runs inside the polygon by the
+ * fill rule are added with their exact horizontal extent. Only the
+ * edges crossing a sub-scanline are looked at, so the cost follows the
+ * rows and the crossings, not rows times vertices.
+ */
+static void
+scanline_fill ( gp_span_list *sl, const GdkRectangle *clip, gp_fill_rule rule )
+{
+    const gfloat    weight  = 1.0f / SCAN_SUBSAMPLE;
+    gdouble         x_min = G_MAXDOUBLE, y_min = G_MAXDOUBLE;
+    gdouble         x_max = -G_MAXDOUBLE, y_max = -G_MAXDOUBLE;
+    gp_scan_edge    *table;
+    gint            n_edges, next = 0;
+    gint            left, top, right, bottom, width, stride;
+    gint            i, j, k, y;
+
+    gp_span_list_clear ( sl );
+    if ( scan_table == NULL )
+    {
+        scan_table  = g_array_new ( FALSE, FALSE, sizeof(gp_scan_edge) );
+        scan_active = g_ptr_array_new ();
+    }
+    g_array_set_size ( scan_table, 0 );
+    g_ptr_array_set_size ( scan_active, 0 );
+
+    for ( i = 0; i < edges->len; i++ )
+    {
+        gp_edge         *e = &g_array_index ( edges, gp_edge, i );
+        gp_scan_edge    se;
+
+        se.dir      = ( e->y1 > e->y0 ) ? 1 : -1;
+        se.y_top    = MIN ( e->y0, e->y1 );
+        se.y_bottom = MAX ( e->y0, e->y1 );
+        se.x_top    = ( se.dir > 0 ) ? e->x0 : e->x1;
+        se.dxdy     = ( e->x1 - e->x0 ) / ( e->y1 - e->y0 );
+        g_array_append_val ( scan_table, se );
+        x_min = MIN ( x_min, MIN ( e->x0, e->x1 ) );
+        x_max = MAX ( x_max, MAX ( e->x0, e->x1 ) );
+        y_min = MIN ( y_min, se.y_top );
+        y_max = MAX ( y_max, se.y_bottom );
+    }
+    n_edges = scan_table->len;
+    if ( n_edges == 0 ) return;
+
+    left    = (gint)floor ( x_min );
+    top     = (gint)floor ( y_min );
+    right   = (gint)ceil ( x_max );
+    bottom  = (gint)ceil ( y_max );
+    if ( clip != NULL )
+    {
+        left    = MAX ( left, clip->x );
+        top     = MAX ( top, clip->y );
+        right   = MIN ( right, clip->x + clip->width );
+        bottom  = MIN ( bottom, clip->y + clip->height );
+    }
+    width   = right - left;
+    if ( width <= 0 || bottom <= top ) return;
+
+    stride  = width + 2;
+    if ( acc_size < (gsize)stride )
+    {
+        g_free ( acc );
+        acc_size    = (gsize)stride;
+        acc         = g_new ( gfloat, acc_size );
+    }
+    g_array_sort ( scan_table, scan_edge_compare );
+    table = (gp_scan_edge *)scan_table->data;
+
+    for ( y = top; y < bottom; y++ )
+    {
+        if ( scan_active->len == 0 )
+        {
+            /*nothing on this row, jump to the next edge*/
+            while ( next < n_edges && table[next].y_bottom <= y ) next++;
+            if ( next == n_edges ) break;
+            if ( table[next].y_top >= y + 1.0 )
+            {
+                y = (gint)floor ( table[next].y_top ) - 1;
+                continue;
+            }
+        }
+
+        memset ( acc, 0, sizeof(gfloat) * stride );
+        for ( k = 0; k < SCAN_SUBSAMPLE; k++ )
+        {
+            gdouble sy      = y + ( k + 0.5 ) / SCAN_SUBSAMPLE;
+            gint    winding = 0;
+            gdouble x_in    = 0.0;
+
+            /*drop the edges that ended, move the others down*/
+            for ( i = 0, j = 0; i < scan_active->len; i++ )
+            {
+                gp_scan_edge *e = g_ptr_array_index ( scan_active, i );
+                if ( e->y_bottom <= sy ) continue;
+                e->x = e->x_top + ( sy - e->y_top ) * e->dxdy;
+                scan_active->pdata[j++] = e;
+            }
+            g_ptr_array_set_size ( scan_active, j );
+            /*then take in the ones that started*/
+            for ( ; next < n_edges && table[next].y_top <= sy; next++ )
+            {
+                gp_scan_edge *e = &table[next];
+                if ( e->y_bottom <= sy ) continue;
+                e->x = e->x_top + ( sy - e->y_top ) * e->dxdy;
+                g_ptr_array_add ( scan_active, e );
+            }
+            /*insertion sort, the order barely changes between lines*/
+            for ( i = 1; i < scan_active->len; i++ )
+            {
+                gp_scan_edge *e = g_ptr_array_index ( scan_active, i );
+                for ( j = i; j > 0 &&
+                      ((gp_scan_edge *)scan_active->pdata[j - 1])->x > e->x; j-- )
+                {
+                    scan_active->pdata[j] = scan_active->pdata[j - 1];
+                }
+                scan_active->pdata[j] = e;
+            }
+
+            for ( i = 0; i < scan_active->len; i++ )
+            {
+                gp_scan_edge    *e = g_ptr_array_index ( scan_active, i );
+                gboolean        was_in, is_in;
+
+                was_in   = ( rule == GP_FILL_EVEN_ODD ) ? ( winding & 1 ) : ( winding != 0 );
+                winding += e->dir;
+                is_in    = ( rule == GP_FILL_EVEN_ODD ) ? ( winding & 1 ) : ( winding != 0 );
+                if ( !was_in && is_in )
+                {
+                    x_in = e->x;
+                }
+                else if ( was_in && !is_in )
+                {
+                    accumulate_interval ( acc,
+                                          CLAMP ( x_in - left, 0.0, (gdouble)width ),
+                                          CLAMP ( e->x - left, 0.0, (gdouble)width ),
+                                          weight );
+                }
+            }
+        }
+        spans_from_row ( sl, acc, width, left, y );
+    }
+}
+
+static gint
+scan_edge_compare ( gconstpointer a, gconstpointer b )
+{
+    gdouble ya = ((const gp_scan_edge *)a)->y_top;
+    gdouble yb = ((const gp_scan_edge *)b)->y_top;
+    return ( ya > yb ) - ( ya < yb );
+}
+
+/*
+ * Add weight to the cells under [xa, xb) as changes to the running
+ * sum, pixels cut by an end get their share. Needs 0 <= xa, xb <= the
+ * row width, with two spare cells after it.
+ */
+static void
+accumulate_interval ( gfloat *a, gdouble xa, gdouble xb, gfloat weight )
+{
+    gint    ia, ib;
+    gfloat  fa, fb;
+
+    if ( xb <= xa ) return;
+    ia  = (gint)xa;
+    ib  = (gint)xb;
+    fa  = (gfloat)( xa - ia );
+    fb  = (gfloat)( xb - ib );
+    if ( ia == ib )
+    {
+        a[ia]       += weight * ( fb - fa );
+        a[ia + 1]   -= weight * ( fb - fa );
+    }
+    else
+    {
+        a[ia]       += weight * ( 1.0f - fa );
+        a[ia + 1]   += weight * fa;
+        a[ib]       -= weight * ( 1.0f - fb );
+        a[ib + 1]   -= weight * fb;
+    }
+}
+
+/* running sum of one accumulated row, cut into solid and partial spans */
+static void
+spans_from_row ( gp_span_list *sl, const gfloat *a, gint width, gint x, gint y )
+{
+    gfloat  sum     = 0.0f;
+    gint    kind    = 0;    /* 0 empty, 1 partial, 2 solid */
+    gp_span span;
+    gint    i;
+
+    for ( i = 0; i <= width; i++ )
+    {
+        guchar  v = 0;
+        gint    k = 0;
+        if ( i < width )
+        {
+            gfloat c;
+            sum += a[i];
+            c = fabsf ( sum );
+            v = ( c >= 1.0f ) ? 255 : (guchar)( c * 255.0f + 0.5f );
+            k = ( v == 255 ) ? 2 : ( v != 0 );
+        }
+        if ( k != kind )
+        {
+            if ( kind != 0 )
+            {
+                span.width = x + i - span.x;
+                g_array_append_val ( sl->spans, span );
+                if ( sl->bounds.width == 0 )
+                {
+                    sl->bounds.x        = span.x;
+                    sl->bounds.y        = span.y;
+                    sl->bounds.width    = span.width;
+                    sl->bounds.height   = 1;
+                }
+                else
+                {
+                    GdkRectangle r = { span.x, span.y, span.width, 1 };
+                    gdk_rectangle_union ( &sl->bounds, &r, &sl->bounds );
+                }
+            }
+            kind = k;
+            span.x      = x + i;
+            span.y      = y;
+            span.offset = ( k == 1 ) ? (gint)sl->coverage->len : -1;
+        }
+        if ( k == 1 ) g_byte_array_append ( sl->coverage, &v, 1 );
+    }
+}
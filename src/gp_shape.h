@@ -0,0 +1,161 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor Boston, MA 02110-1301,  USA
+ */
+
+#ifndef __GP_SHAPE_H__
+#define __GP_SHAPE_H__
+
+#include <gtk/gtk.h>
+
+/*
+ * Client side anti-aliased shape rasterizer.
+ * A shape outline is flattened to edges and turned into per row
+ * spans with analytic (exact area) coverage. The same span list is
+ * used to draw the rubber-band preview and to commit the shape, so
+ * the shape is only rasterized again when its geometry changes.
+ * Coordinates follow the GDK drawing calls: a line through point
+ * (x,y) runs through the centre of that pixel.
+ */
+
+typedef struct
+{
+    gint    y;
+    gint    x;
+    gint    width;
+    gint    offset;     /* into coverage, -1 when fully covered       */
+} gp_span;
+
+typedef struct
+{
+    GArray          *spans;     /* gp_span, sorted by row             */
+    GByteArray      *coverage;  /* 0 - 255 for the partial spans      */
+    GdkRectangle    bounds;     /* of every span, empty for no spans  */
+} gp_span_list;
+
+/* how lines are stroked, as set on a GdkGC */
+typedef struct
+{
+    gint            width;
+    GdkCapStyle     cap;        /* GDK_CAP_NOT_LAST is taken as butt  */
+    GdkJoinStyle    join;
+} gp_stroke_style;
+
+void            gp_stroke_style_from_gc     ( gp_stroke_style *style,
+                                              GdkGC *gc );
+
+gp_span_list *  gp_span_list_new            ( void );
+void            gp_span_list_free           ( gp_span_list *sl );
+void            gp_span_list_clear          ( gp_span_list *sl );
+
+/*
+ * Every pixel a span list touches, compact enough to keep for undo:
+ * per row of bounds the number of runs, then each run as its x from
+ * bounds.x and its width.
+ */
+typedef struct
+{
+    GdkRectangle    bounds;
+    guint16         *n_runs;    /* bounds.height of them              */
+    guint16         *runs;      /* x, width pairs, row by row         */
+    gint            n_pixels;
+} gp_span_runs;
+
+/* the pixels a or b (either may be NULL) touch, NULL for none */
+gp_span_runs *  gp_span_runs_new            ( const gp_span_list *a,
+                                              const gp_span_list *b );
+void            gp_span_runs_free           ( gp_span_runs *runs );
+/* packed RGB of the pixels under the runs, in run order */
+guchar *        gp_span_runs_read_pixels    ( const gp_span_runs *runs,
+                                              GdkDrawable *drawable );
+void            gp_span_runs_write_pixels   ( const gp_span_runs *runs,
+                                              GdkDrawable *drawable,
+                                              GdkGC *gc,
+                                              const guchar *pixels );
+
+/* which parts of a self-intersecting polygon are inside */
+typedef enum
+{
+    GP_FILL_EVEN_ODD,           /* odd number of crossings, as X does   */
+    GP_FILL_NONZERO             /* any winding                          */
+} gp_fill_rule;
+
+/* 
+ * Shape builders, each one replaces the content of the list.
+ * Spans are clipped to clip when it is not NULL.
+ */
+/* 
+ * Scanline filled, the coverage is exact along a row and counted on
+ * sub-scanlines down it.
+ */
+void            gp_shape_fill_polygon       ( gp_span_list *sl,
+                                              const GdkRectangle *clip,
+                                              const GdkPoint *points,
+                                              gint n_points,
+                                              gp_fill_rule rule );
+void            gp_shape_stroke_polyline    ( gp_span_list *sl,
+                                              const GdkRectangle *clip,
+                                              const GdkPoint *points,
+                                              gint n_points,
+                                              gboolean closed,
+                                              const gp_stroke_style *style );
+/* cubic Bezier from points[0] to points[3], bent towards the control
+ * points points[1] and points[2] */
+void            gp_shape_stroke_curve       ( gp_span_list *sl,
+                                              const GdkRectangle *clip,
+                                              const GdkPoint *points,
+                                              const gp_stroke_style *style );
+/* rx, ry are the corner radii: 0 for a plain rectangle, half the size
+ * for an ellipse */
+void            gp_shape_fill_rectangle     ( gp_span_list *sl,
+                                              const GdkRectangle *clip,
+                                              gint x, gint y,
+                                              gint width, gint height,
+                                              gdouble rx, gdouble ry );
+void            gp_shape_stroke_rectangle   ( gp_span_list *sl,
+                                              const GdkRectangle *clip,
+                                              gint x, gint y,
+                                              gint width, gint height,
+                                              gdouble rx, gdouble ry,
+                                              const gp_stroke_style *style );
+
+/*
+ * Blend fill then outline (either may be NULL) over the pixels read
+ * from source, or from drawable itself when source is NULL, and draw
+ * the result to drawable. Colours are col_rgba(), their alpha scales
+ * the coverage. Only the part inside area is touched, one request per
+ * rectangle of it; a NULL area means the whole shape. Returns the
+ * bounds of the shape.
+ */
+GdkRectangle    gp_shape_render             ( GdkDrawable *drawable,
+                                              GdkDrawable *source,
+                                              GdkGC *gc,
+                                              GdkRegion *area,
+                                              const gp_span_list *fill,
+                                              guint fill_color,
+                                              const gp_span_list *outline,
+                                              guint outline_color );
+
+/* Bounds of both lists, either may be NULL */
+GdkRectangle    gp_shape_bounds             ( const gp_span_list *fill,
+                                              const gp_span_list *outline );
+
+/*
+ * Tiles the shape touches, so redrawing it costs about its perimeter
+ * for an outline instead of its whole bounding box.
+ */
+GdkRegion *     gp_shape_damage             ( const gp_span_list *fill,
+                                              const gp_span_list *outline );
+
+#endif /*__GP_SHAPE_H__*/
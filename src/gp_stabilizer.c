@@ -0,0 +1,225 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor Boston, MA 02110-1301,  USA
+ */
+
+#include <math.h>
+
+#include "gp_stabilizer.h"
+
+#define WINDOW          4       /* samples the spline looks at        */
+#define MIN_KNOT_DIST   1.0     /* closer samples are dropped          */
+#define SEG_STEP        2.0     /* pixels per spline subdivision       */
+#define SEG_MAX_STEPS   64
+
+typedef struct
+{
+    gdouble x, y;
+} knot;
+
+struct _gp_stabilizer
+{
+    gdouble     radius;
+    gboolean    smooth;
+    gdouble     bx, by;         /* lazy pointer                        */
+    knot        win[WINDOW];    /* last knots, oldest first            */
+    gint        n_win;
+    GdkPoint    last;           /* last point handed out               */
+    GArray      *out;
+};
+
+static void     emit_point      ( gp_stabilizer *st, gdouble x, gdouble y );
+static void     emit_segment    ( gp_stabilizer *st, const knot *p0,
+                                  const knot *p1, const knot *p2,
+                                  const knot *p3 );
+
+
+gp_stabilizer *
+gp_stabilizer_new ( gdouble lazy_radius, gboolean smooth, gdouble x, gdouble y )
+{
+    gp_stabilizer *st = g_slice_new0 ( gp_stabilizer );
+    st->radius      = MAX ( lazy_radius, 0.0 );
+    st->smooth      = smooth;
+    st->bx          = x;
+    st->by          = y;
+    st->win[0].x    = x;
+    st->win[0].y    = y;
+    st->n_win       = 1;
+    st->last.x      = (gint)floor ( x + 0.5 );
+    st->last.y      = (gint)floor ( y + 0.5 );
+    st->out         = g_array_new ( FALSE, FALSE, sizeof(GdkPoint) );
+    return st;
+}
+
+void
+gp_stabilizer_free ( gp_stabilizer *st )
+{
+    if ( st == NULL ) return;
+    g_array_free ( st->out, TRUE );
+    g_slice_free ( gp_stabilizer, st );
+}
+
+const GdkPoint *
+gp_stabilizer_add ( gp_stabilizer *st, gdouble x, gdouble y, gint *n_points )
+{
+    gdouble dx, dy, d;
+    knot    *w = st->win;
+
+    g_array_set_size ( st->out, 0 );
+    *n_points = 0;
+
+    /* lazy mouse: drag the pointer along on a string of length radius */
+    dx  = x - st->bx;
+    dy  = y - st->by;
+    d   = sqrt ( dx * dx + dy * dy );
+    if ( d <= st->radius ) return NULL;
+    if ( st->radius > 0.0 )
+    {
+        gdouble k = ( d - st->radius ) / d;
+        st->bx += dx * k;
+        st->by += dy * k;
+    }
+    else
+    {
+        st->bx = x;
+        st->by = y;
+    }
+
+    if ( !st->smooth )
+    {
+        emit_point ( st, st->bx, st->by );
+    }
+    else
+    {
+        knot    *tail = &w[st->n_win - 1];
+        dx = st->bx - tail->x;
+        dy = st->by - tail->y;
+        if ( dx * dx + dy * dy < MIN_KNOT_DIST * MIN_KNOT_DIST ) return NULL;
+
+        if ( st->n_win == WINDOW )
+        {
+            w[0] = w[1];
+            w[1] = w[2];
+            w[2] = w[3];
+            st->n_win--;
+        }
+        w[st->n_win].x = st->bx;
+        w[st->n_win].y = st->by;
+        st->n_win++;
+
+        if ( st->n_win == 3 )
+        {
+            /* first segment, mirror the second knot for the missing one */
+            knot    p0;
+            p0.x    = 2.0 * w[0].x - w[1].x;
+            p0.y    = 2.0 * w[0].y - w[1].y;
+            emit_segment ( st, &p0, &w[0], &w[1], &w[2] );
+        }
+        else
+        if ( st->n_win == 4 )
+        {
+            emit_segment ( st, &w[0], &w[1], &w[2], &w[3] );
+        }
+    }
+    *n_points = st->out->len;
+    return (GdkPoint *)st->out->data;
+}
+
+/* Finish the segment the spline was holding back */
+const GdkPoint *
+gp_stabilizer_end ( gp_stabilizer *st, gint *n_points )
+{
+    knot    *w = st->win;
+    gint    n  = st->n_win;
+
+    g_array_set_size ( st->out, 0 );
+    *n_points = 0;
+    if ( !st->smooth || n < 2 ) return NULL;
+
+    if ( n == 2 )
+    {
+        emit_point ( st, w[1].x, w[1].y );
+    }
+    else
+    {
+        knot    p3;
+        p3.x    = 2.0 * w[n - 1].x - w[n - 2].x;
+        p3.y    = 2.0 * w[n - 1].y - w[n - 2].y;
+        emit_segment ( st, &w[n - 3], &w[n - 2], &w[n - 1], &p3 );
+    }
+    *n_points = st->out->len;
+    return (GdkPoint *)st->out->data;
+}
+
+
+/*private functions*/
+
+static void
+emit_point ( gp_stabilizer *st, gdouble x, gdouble y )
+{
+    GdkPoint p;
+    p.x = (gint)floor ( x + 0.5 );
+    p.y = (gint)floor ( y + 0.5 );
+    if ( p.x == st->last.x && p.y == st->last.y ) return;
+    g_array_append_val ( st->out, p );
+    st->last = p;
+}
+
+/* knot spacing for the centripetal parametrization, |p1 - p0| ^ 0.5 */
+static inline gdouble
+knot_interval ( const knot *a, const knot *b )
+{
+    gdouble dx = b->x - a->x;
+    gdouble dy = b->y - a->y;
+    gdouble dt = sqrt ( sqrt ( dx * dx + dy * dy ) );
+    return ( dt < 1e-4 ) ? 1.0 : dt;
+}
+
+/* Sample the centripetal Catmull-Rom segment from p1 to p2
+ * (Barry and Goldman's pyramidal form), p1 excluded */
+static void
+emit_segment ( gp_stabilizer *st, const knot *p0, const knot *p1,
+               const knot *p2, const knot *p3 )
+{
+    gdouble t0 = 0.0;
+    gdouble t1 = t0 + knot_interval ( p0, p1 );
+    gdouble t2 = t1 + knot_interval ( p1, p2 );
+    gdouble t3 = t2 + knot_interval ( p2, p3 );
+    gdouble dx = p2->x - p1->x;
+    gdouble dy = p2->y - p1->y;
+    gint    steps, i;
+
+    steps = (gint)ceil ( sqrt ( dx * dx + dy * dy ) / SEG_STEP );
+    steps = CLAMP ( steps, 1, SEG_MAX_STEPS );
+
+    for ( i = 1; i < steps; i++ )
+    {
+        gdouble t = t1 + ( t2 - t1 ) * i / steps;
+        gdouble a1x, a1y, a2x, a2y, a3x, a3y, b1x, b1y, b2x, b2y;
+
+        a1x = ( ( t1 - t ) * p0->x + ( t - t0 ) * p1->x ) / ( t1 - t0 );
+        a1y = ( ( t1 - t ) * p0->y + ( t - t0 ) * p1->y ) / ( t1 - t0 );
+        a2x = ( ( t2 - t ) * p1->x + ( t - t1 ) * p2->x ) / ( t2 - t1 );
+        a2y = ( ( t2 - t ) * p1->y + ( t - t1 ) * p2->y ) / ( t2 - t1 );
+        a3x = ( ( t3 - t ) * p2->x + ( t - t2 ) * p3->x ) / ( t3 - t2 );
+        a3y = ( ( t3 - t ) * p2->y + ( t - t2 ) * p3->y ) / ( t3 - t2 );
+        b1x = ( ( t2 - t ) * a1x + ( t - t0 ) * a2x ) / ( t2 - t0 );
+        b1y = ( ( t2 - t ) * a1y + ( t - t0 ) * a2y ) / ( t2 - t0 );
+        b2x = ( ( t3 - t ) * a2x + ( t - t1 ) * a3x ) / ( t3 - t1 );
+        b2y = ( ( t3 - t ) * a2y + ( t - t1 ) * a3y ) / ( t3 - t1 );
+        emit_point ( st, ( ( t2 - t ) * b1x + ( t - t1 ) * b2x ) / ( t2 - t1 ),
+                         ( ( t2 - t ) * b1y + ( t - t1 ) * b2y ) / ( t2 - t1 ) );
+    }
+    emit_point ( st, p2->x, p2->y );
+}
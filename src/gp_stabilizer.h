@@ -0,0 +1,46 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor Boston, MA 02110-1301,  USA
+ */
+
+#ifndef __GP_STABILIZER_H__
+#define __GP_STABILIZER_H__
+
+#include <gtk/gtk.h>
+
+/*
+ * Stroke stabilizer.
+ * Input samples first drive a lazy-mouse pointer, which only moves
+ * once the cursor is further than the lazy radius from it. Its path is
+ * then optionally smoothed with a centripetal Catmull-Rom spline over
+ * the last four positions, so each new sample costs O(1) and the curve
+ * lags at most one sample behind the pointer.
+ *
+ * gp_stabilizer_add() and gp_stabilizer_end() return the new points of
+ * the stroke polyline; the array stays valid until the next call.
+ */
+
+typedef struct _gp_stabilizer gp_stabilizer;
+
+gp_stabilizer *     gp_stabilizer_new   ( gdouble lazy_radius,
+                                          gboolean smooth,
+                                          gdouble x, gdouble y );
+void                gp_stabilizer_free  ( gp_stabilizer *st );
+const GdkPoint *    gp_stabilizer_add   ( gp_stabilizer *st,
+                                          gdouble x, gdouble y,
+                                          gint *n_points );
+const GdkPoint *    gp_stabilizer_end   ( gp_stabilizer *st,
+                                          gint *n_points );
+
+#endif /*__GP_STABILIZER_H__*/
@@ -0,0 +1,166 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor Boston, MA 02110-1301,  USA
+ */
+
+#include "gp_stroke.h"
+#include "undo.h"
+
+#define TS  GP_STROKE_TILE_SIZE
+
+struct _gp_stroke
+{
+    gp_canvas   *cv;
+    gint        width;          /* canvas size                      */
+    gint        height;
+    gint        tiles_x;        /* tile grid size                   */
+    gint        tiles_y;
+    guchar      *touched;       /* tiles_x * tiles_y flags          */
+    gint        n_touched;
+    GdkPixmap   *backup;        /* canvas sized, only the touched   *
+                                 * tiles hold valid pixels          */
+};
+
+static void     copy_tile_run   ( gp_stroke *stroke, GdkDrawable *dst,
+                                  GdkDrawable *src, gint tx0, gint tx1,
+                                  gint ty );
+
+
+gp_stroke *
+gp_stroke_new ( gp_canvas *cv )
+{
+    gp_stroke *stroke = g_slice_new0 ( gp_stroke );
+    stroke->cv      = cv;
+    gdk_drawable_get_size ( cv->pixmap, &stroke->width, &stroke->height );
+    stroke->tiles_x = ( stroke->width + TS - 1 ) / TS;
+    stroke->tiles_y = ( stroke->height + TS - 1 ) / TS;
+    stroke->touched = g_new0 ( guchar, stroke->tiles_x * stroke->tiles_y );
+    return stroke;
+}
+
+void
+gp_stroke_free ( gp_stroke *stroke )
+{
+    if ( stroke == NULL ) return;
+    if ( stroke->backup != NULL ) g_object_unref ( stroke->backup );
+    g_free ( stroke->touched );
+    g_slice_free ( gp_stroke, stroke );
+}
+
+/* Back up every tile under the rectangle that was not touched yet,
+ * one blit per run of adjacent tiles. */
+void
+gp_stroke_touch ( gp_stroke *stroke, gint x, gint y, gint width, gint height )
+{
+    gint tx0, ty0, tx1, ty1, tx, ty;
+
+    if ( stroke == NULL ) return;
+    if ( x < 0 ) { width += x; x = 0; }
+    if ( y < 0 ) { height += y; y = 0; }
+    width   = MIN ( width, stroke->width - x );
+    height  = MIN ( height, stroke->height - y );
+    if ( width <= 0 || height <= 0 ) return;
+
+    tx0 = x / TS;
+    ty0 = y / TS;
+    tx1 = ( x + width - 1 ) / TS;
+    ty1 = ( y + height - 1 ) / TS;
+
+    for ( ty = ty0; ty <= ty1; ty++ )
+    {
+        guchar *row = stroke->touched + ty * stroke->tiles_x;
+        tx = tx0;
+        while ( tx <= tx1 )
+        {
+            gint run;
+            if ( row[tx] ) { tx++; continue; }
+            for ( run = tx; run <= tx1 && !row[run]; run++ )
+            {
+                row[run] = 1;
+                stroke->n_touched++;
+            }
+            if ( stroke->backup == NULL )
+            {
+                /* no copy here, tiles are filled in as needed */
+                stroke->backup = gdk_pixmap_new ( stroke->cv->pixmap,
+                                                  stroke->width,
+                                                  stroke->height, -1 );
+            }
+            copy_tile_run ( stroke, stroke->backup, stroke->cv->pixmap,
+                            tx, run - 1, ty );
+            tx = run;
+        }
+    }
+}
+
+/* Put the touched tiles back on the canvas */
+void
+gp_stroke_restore ( gp_stroke *stroke )
+{
+    gint tx, ty;
+    if ( stroke == NULL || stroke->backup == NULL ) return;
+    for ( ty = 0; ty < stroke->tiles_y; ty++ )
+    {
+        guchar *row = stroke->touched + ty * stroke->tiles_x;
+        for ( tx = 0; tx < stroke->tiles_x; tx++ )
+        {
+            gint run;
+            if ( !row[tx] ) continue;
+            for ( run = tx; run < stroke->tiles_x && row[run]; run++ );
+            copy_tile_run ( stroke, stroke->cv->pixmap, stroke->backup,
+                            tx, run - 1, ty );
+            tx = run;
+        }
+    }
+}
+
+void
+gp_stroke_save_undo ( gp_stroke *stroke, gp_tool_enum tool )
+{
+    GdkRectangle    *tiles;
+    gint            n = 0;
+    gint            tx, ty;
+
+    if ( stroke == NULL || stroke->n_touched == 0 ) return;
+
+    tiles = g_new ( GdkRectangle, stroke->n_touched );
+    for ( ty = 0; ty < stroke->tiles_y; ty++ )
+    {
+        for ( tx = 0; tx < stroke->tiles_x; tx++ )
+        {
+            if ( !stroke->touched[ty * stroke->tiles_x + tx] ) continue;
+            tiles[n].x      = tx * TS;
+            tiles[n].y      = ty * TS;
+            tiles[n].width  = MIN ( TS, stroke->width - tiles[n].x );
+            tiles[n].height = MIN ( TS, stroke->height - tiles[n].y );
+            n++;
+        }
+    }
+    undo_add_tiles ( stroke->backup, tiles, n, tool );
+    g_free ( tiles );
+}
+
+
+/*private functions*/
+
+static void
+copy_tile_run ( gp_stroke *stroke, GdkDrawable *dst, GdkDrawable *src,
+                gint tx0, gint tx1, gint ty )
+{
+    gint x  = tx0 * TS;
+    gint y  = ty * TS;
+    gint w  = MIN ( ( tx1 + 1 ) * TS, stroke->width ) - x;
+    gint h  = MIN ( TS, stroke->height - y );
+    gdk_draw_drawable ( dst, stroke->cv->gc_fg, src, x, y, x, y, w, h );
+}
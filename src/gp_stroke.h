@@ -0,0 +1,44 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor Boston, MA 02110-1301,  USA
+ */
+
+#ifndef __GP_STROKE_H__
+#define __GP_STROKE_H__
+
+#include "common.h"
+#include "toolbar.h"
+
+/*
+ * Stroke session.
+ * Freehand tools call gp_stroke_touch() before they paint an area of
+ * the canvas pixmap; the canvas tiles under it are backed up the first
+ * time they are touched. At the end of the stroke only those tiles are
+ * handed to the undo queue, or put back if the stroke is cancelled.
+ */
+
+#define GP_STROKE_TILE_SIZE     64
+
+typedef struct _gp_stroke gp_stroke;
+
+gp_stroke *     gp_stroke_new           ( gp_canvas *cv );
+void            gp_stroke_free          ( gp_stroke *stroke );
+void            gp_stroke_touch         ( gp_stroke *stroke,
+                                          gint x, gint y,
+                                          gint width, gint height );
+void            gp_stroke_restore       ( gp_stroke *stroke );
+void            gp_stroke_save_undo     ( gp_stroke *stroke,
+                                          gp_tool_enum tool );
+
+#endif /*__GP_STROKE_H__*/
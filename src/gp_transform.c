@@ -0,0 +1,400 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor Boston, MA 02110-1301,  USA
+ */
+
+#include "gp_transform.h"
+#include <math.h>
+#include <unistd.h>
+
+/* output rows per thread pool task */
+#define BAND_HEIGHT     32
+/* below this many output pixels the threads cost more than they save */
+#define SERIAL_MAX      ( 256 * 256 )
+/* largest side of a result */
+#define MAX_SIDE        32767
+
+typedef struct
+{
+    const guchar    *src;
+    gint            src_width;
+    gint            src_height;
+    gint            src_stride;
+    guchar          *dst;
+    gint            dst_width;
+    gint            dst_height;
+    gint            dst_stride;
+    gp_affine       inv;        /* destination to source            */
+    gp_filter       filter;
+    gint            pending;    /* bands not done yet               */
+    GMutex          *lock;
+    GCond           *done;
+} transform_job;
+
+/* one output band, as pushed to the pool */
+typedef struct
+{
+    transform_job   *job;
+    gint            band;
+} band_task;
+
+/* shared by every transform, made on first use */
+static GThreadPool *m_pool = NULL;
+
+
+void
+gp_affine_stretch_skew ( gp_affine *m, gdouble sx, gdouble sy,
+                         gdouble skew_x, gdouble skew_y )
+{
+    gdouble tx = tan ( skew_x * G_PI / 180.0 );
+    gdouble ty = tan ( skew_y * G_PI / 180.0 );
+
+    /*the skew after the stretch: [1 tx; ty 1] * [sx 0; 0 sy]*/
+    m->xx = sx;
+    m->xy = tx * sy;
+    m->yx = ty * sx;
+    m->yy = sy;
+    m->x0 = 0.0;
+    m->y0 = 0.0;
+}
+
+void
+gp_affine_rotate ( gp_affine *m, gdouble degrees )
+{
+    gdouble c = cos ( degrees * G_PI / 180.0 );
+    gdouble s = sin ( degrees * G_PI / 180.0 );
+
+    /*y grows downwards, so this turns counterclockwise on screen*/
+    m->xx = c;
+    m->xy = s;
+    m->yx = -s;
+    m->yy = c;
+    m->x0 = 0.0;
+    m->y0 = 0.0;
+}
+
+void
+gp_affine_multiply ( gp_affine *m, const gp_affine *a, const gp_affine *b )
+{
+    gp_affine r;
+
+    r.xx = a->xx * b->xx + a->xy * b->yx;
+    r.xy = a->xx * b->xy + a->xy * b->yy;
+    r.yx = a->yx * b->xx + a->yy * b->yx;
+    r.yy = a->yx * b->xy + a->yy * b->yy;
+    r.x0 = a->xx * b->x0 + a->xy * b->y0 + a->x0;
+    r.y0 = a->yx * b->x0 + a->yy * b->y0 + a->y0;
+    *m = r;
+}
+
+/* the pixel box a w x h source lands in, FALSE if there is none */
+static gboolean
+transform_box ( gint w, gint h, const gp_affine *m,
+                gdouble *x0, gdouble *y0, gdouble *x1, gdouble *y1 )
+{
+    gdouble cx[4], cy[4];
+    gint    i;
+
+    if ( fabs ( m->xx * m->yy - m->xy * m->yx ) < 1e-9 ) return FALSE;
+    for ( i = 0; i < 4; i++ )
+    {
+        gdouble px = ( i & 1 ) ? w : 0;
+        gdouble py = ( i & 2 ) ? h : 0;
+        cx[i] = m->xx * px + m->xy * py + m->x0;
+        cy[i] = m->yx * px + m->yy * py + m->y0;
+    }
+    *x0 = *x1 = cx[0];
+    *y0 = *y1 = cy[0];
+    for ( i = 1; i < 4; i++ )
+    {
+        *x0 = MIN ( *x0, cx[i] ); *x1 = MAX ( *x1, cx[i] );
+        *y0 = MIN ( *y0, cy[i] ); *y1 = MAX ( *y1, cy[i] );
+    }
+    /*a hair of slack so exact scales do not grow a pixel*/
+    *x0 = floor ( *x0 + 1e-6 ); *y0 = floor ( *y0 + 1e-6 );
+    *x1 = ceil ( *x1 - 1e-6 );  *y1 = ceil ( *y1 - 1e-6 );
+    if ( *x1 - *x0 < 1.0 ) *x1 = *x0 + 1.0;
+    if ( *y1 - *y0 < 1.0 ) *y1 = *y0 + 1.0;
+    return ( *x1 - *x0 <= MAX_SIDE && *y1 - *y0 <= MAX_SIDE );
+}
+
+gboolean
+gp_transform_get_size ( gint w, gint h, const gp_affine *m,
+                        gint *width, gint *height )
+{
+    gdouble x0, y0, x1, y1;
+
+    if ( !transform_box ( w, h, m, &x0, &y0, &x1, &y1 ) ) return FALSE;
+    *width  = (gint)( x1 - x0 );
+    *height = (gint)( y1 - y0 );
+    return TRUE;
+}
+
+static gint
+n_workers ( void )
+{
+    static gint n = 0;
+
+    if ( n == 0 )
+    {
+        glong cpus = sysconf ( _SC_NPROCESSORS_ONLN );
+        n = (gint)CLAMP ( cpus, 1, 64 );
+    }
+    return n;
+}
+
+/*
+ * Filters work on premultiplied values so the transparent outside and
+ * transparent source pixels do not bleed their colour into the edges:
+ * acc[0..2] gather colour * alpha, acc[3] the alpha.
+ */
+static inline void
+tap ( const transform_job *job, gint x, gint y, gfloat w, gfloat *acc )
+{
+    const guchar    *p;
+    gfloat          a;
+
+    if ( x < 0 || y < 0 || x >= job->src_width || y >= job->src_height ) return;
+    p = job->src + y * job->src_stride + x * 4;
+    a = p[3] * w;
+    acc[0] += p[0] * a;
+    acc[1] += p[1] * a;
+    acc[2] += p[2] * a;
+    acc[3] += a;
+}
+
+static inline void
+store ( guchar *d, const gfloat *acc )
+{
+    gfloat  a = acc[3];
+    gint    c;
+
+    if ( a < 0.5f )
+    {
+        d[0] = d[1] = d[2] = d[3] = 0;
+        return;
+    }
+    for ( c = 0; c < 3; c++ )
+    {
+        gfloat v = acc[c] / a + 0.5f;
+        d[c] = (guchar)CLAMP ( v, 0.0f, 255.0f );
+    }
+    a += 0.5f;
+    d[3] = (guchar)MIN ( a, 255.0f );
+}
+
+/* Catmull-Rom weights of the four taps around t in [0, 1) */
+static inline void
+cubic_weights ( gfloat t, gfloat *w )
+{
+    gfloat t2 = t * t;
+    gfloat t3 = t2 * t;
+
+    w[0] = 0.5f * ( -t3 + 2.0f * t2 - t );
+    w[1] = 0.5f * ( 3.0f * t3 - 5.0f * t2 + 2.0f );
+    w[2] = 0.5f * ( -3.0f * t3 + 4.0f * t2 + t );
+    w[3] = 0.5f * ( t3 - t2 );
+}
+
+static void
+transform_row ( const transform_job *job, gint y )
+{
+    const gp_affine *inv    = &job->inv;
+    guchar          *d      = job->dst + y * job->dst_stride;
+    /*pixel centres map to pixel centres, integer source coordinates
+     *are the centre of that source pixel*/
+    gdouble         sx      = inv->xx * 0.5 + inv->xy * ( y + 0.5 ) + inv->x0 - 0.5;
+    gdouble         sy      = inv->yx * 0.5 + inv->yy * ( y + 0.5 ) + inv->y0 - 0.5;
+    gint            x;
+
+    for ( x = 0; x < job->dst_width; x++, d += 4, sx += inv->xx, sy += inv->yx )
+    {
+        gfloat  acc[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+        gint    ix, iy, i, j;
+
+        /*the widest filter reaches two pixels out*/
+        if ( sx < -2.0 || sy < -2.0 ||
+             sx > job->src_width + 1.0 || sy > job->src_height + 1.0 )
+        {
+            *(guint32 *)d = 0;
+            continue;
+        }
+        switch ( job->filter )
+        {
+            case GP_FILTER_NEAREST:
+            {
+                ix = (gint)floor ( sx + 0.5 );
+                iy = (gint)floor ( sy + 0.5 );
+                if ( ix >= 0 && iy >= 0 &&
+                     ix < job->src_width && iy < job->src_height )
+                {
+                    *(guint32 *)d = *(const guint32 *)( job->src + iy * job->src_stride + ix * 4 );
+                }
+                else
+                {
+                    *(guint32 *)d = 0;
+                }
+                continue;
+            }
+            case GP_FILTER_BICUBIC:
+            {
+                gfloat wx[4], wy[4];
+
+                ix = (gint)floor ( sx );
+                iy = (gint)floor ( sy );
+                cubic_weights ( (gfloat)( sx - ix ), wx );
+                cubic_weights ( (gfloat)( sy - iy ), wy );
+                for ( j = 0; j < 4; j++ )
+                {
+                    for ( i = 0; i < 4; i++ )
+                    {
+                        tap ( job, ix - 1 + i, iy - 1 + j, wx[i] * wy[j], acc );
+                    }
+                }
+                break;
+            }
+            case GP_FILTER_BILINEAR:
+            default:
+            {
+                gfloat fx, fy;
+
+                ix = (gint)floor ( sx );
+                iy = (gint)floor ( sy );
+                fx = (gfloat)( sx - ix );
+                fy = (gfloat)( sy - iy );
+                tap ( job, ix,     iy,     ( 1.0f - fx ) * ( 1.0f - fy ), acc );
+                tap ( job, ix + 1, iy,     fx * ( 1.0f - fy ),            acc );
+                tap ( job, ix,     iy + 1, ( 1.0f - fx ) * fy,            acc );
+                tap ( job, ix + 1, iy + 1, fx * fy,                       acc );
+                break;
+            }
+        }
+        store ( d, acc );
+    }
+}
+
+static void
+transform_band ( const transform_job *job, gint band )
+{
+    gint    y0  = band * BAND_HEIGHT;
+    gint    y1  = MIN ( y0 + BAND_HEIGHT, job->dst_height );
+    gint    y;
+
+    for ( y = y0; y < y1; y++ )
+    {
+        transform_row ( job, y );
+    }
+}
+
+/* thread pool task: the last band of a job wakes up its caller */
+static void
+pool_band ( gpointer data, gpointer user_data )
+{
+    band_task       *task   = data;
+    transform_job   *job    = task->job;
+
+    transform_band ( job, task->band );
+    g_mutex_lock ( job->lock );
+    if ( --job->pending == 0 )
+    {
+        g_cond_signal ( job->done );
+    }
+    g_mutex_unlock ( job->lock );
+}
+
+GdkPixbuf *
+gp_transform_pixbuf ( const GdkPixbuf *src, const gp_affine *m, gp_filter filter )
+{
+    GdkPixbuf       *rgba, *dst;
+    transform_job   job;
+    gdouble         x0, y0, x1, y1, det;
+    gint            w, h, i, n_bands;
+
+    g_return_val_if_fail ( GDK_IS_PIXBUF ( src ), NULL );
+
+    w = gdk_pixbuf_get_width ( src );
+    h = gdk_pixbuf_get_height ( src );
+    det = m->xx * m->yy - m->xy * m->yx;
+    if ( !transform_box ( w, h, m, &x0, &y0, &x1, &y1 ) ) return NULL;
+
+    dst = gdk_pixbuf_new ( GDK_COLORSPACE_RGB, TRUE, 8,
+                           (gint)( x1 - x0 ), (gint)( y1 - y0 ) );
+    if ( dst == NULL ) return NULL;
+    if ( gdk_pixbuf_get_has_alpha ( src ) )
+    {
+        rgba = g_object_ref ( (GdkPixbuf *)src );
+    }
+    else
+    {
+        rgba = gdk_pixbuf_add_alpha ( src, FALSE, 0, 0, 0 );
+    }
+
+    job.src         = gdk_pixbuf_get_pixels ( rgba );
+    job.src_width   = w;
+    job.src_height  = h;
+    job.src_stride  = gdk_pixbuf_get_rowstride ( rgba );
+    job.dst         = gdk_pixbuf_get_pixels ( dst );
+    job.dst_width   = gdk_pixbuf_get_width ( dst );
+    job.dst_height  = gdk_pixbuf_get_height ( dst );
+    job.dst_stride  = gdk_pixbuf_get_rowstride ( dst );
+    job.filter      = filter;
+    /*inverse of m, moved so the box starts at 0, 0*/
+    job.inv.xx      =  m->yy / det;
+    job.inv.xy      = -m->xy / det;
+    job.inv.yx      = -m->yx / det;
+    job.inv.yy      =  m->xx / det;
+    job.inv.x0      = -( job.inv.xx * ( m->x0 - x0 ) + job.inv.xy * ( m->y0 - y0 ) );
+    job.inv.y0      = -( job.inv.yx * ( m->x0 - x0 ) + job.inv.yy * ( m->y0 - y0 ) );
+
+    n_bands = ( job.dst_height + BAND_HEIGHT - 1 ) / BAND_HEIGHT;
+    if ( !g_thread_supported () || n_workers () == 1 ||
+         (gdouble)job.dst_width * job.dst_height <= SERIAL_MAX )
+    {
+        for ( i = 0; i < n_bands; i++ )
+        {
+            transform_band ( &job, i );
+        }
+    }
+    else
+    {
+        band_task *tasks = g_new ( band_task, n_bands );
+
+        if ( m_pool == NULL )
+        {
+            /*threads shared with the rest of glib, kept between jobs*/
+            m_pool = g_thread_pool_new ( pool_band, NULL, n_workers (), FALSE, NULL );
+        }
+        job.pending = n_bands;
+        job.lock    = g_mutex_new ();
+        job.done    = g_cond_new ();
+        for ( i = 0; i < n_bands; i++ )
+        {
+            tasks[i].job    = &job;
+            tasks[i].band   = i;
+            g_thread_pool_push ( m_pool, &tasks[i], NULL );
+        }
+        g_mutex_lock ( job.lock );
+        while ( job.pending > 0 )
+        {
+            g_cond_wait ( job.done, job.lock );
+        }
+        g_mutex_unlock ( job.lock );
+        g_cond_free ( job.done );
+        g_mutex_free ( job.lock );
+        g_free ( tasks );
+    }
+
+    g_object_unref ( rgba );
+    return dst;
+}
@@ -0,0 +1,68 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor Boston, MA 02110-1301,  USA
+ */
+
+#ifndef __GP_TRANSFORM_H__
+#define __GP_TRANSFORM_H__
+
+#include <gtk/gtk.h>
+
+/*
+ * Affine resampling of pixbufs. Every destination pixel is mapped back
+ * into the source and filtered there; the output rows are cut in bands
+ * shared out to a thread pool.
+ */
+
+typedef enum
+{
+    GP_FILTER_NEAREST,
+    GP_FILTER_BILINEAR,
+    GP_FILTER_BICUBIC
+} gp_filter;
+
+/* x' = xx * x + xy * y + x0,  y' = yx * x + yy * y + y0 */
+typedef struct
+{
+    gdouble xx, yx;
+    gdouble xy, yy;
+    gdouble x0, y0;
+} gp_affine;
+
+/* scale by sx, sy then slant by skew_x, skew_y degrees */
+void        gp_affine_stretch_skew  ( gp_affine *m,
+                                      gdouble sx, gdouble sy,
+                                      gdouble skew_x, gdouble skew_y );
+
+/* turn by degrees counterclockwise, about the origin */
+void        gp_affine_rotate        ( gp_affine *m, gdouble degrees );
+
+/* m = a * b, b applied first; m may be a or b */
+void        gp_affine_multiply      ( gp_affine *m, const gp_affine *a,
+                                      const gp_affine *b );
+
+/* The size gp_transform_pixbuf gives a w x h source mapped through m,
+ * FALSE when it would return NULL. */
+gboolean    gp_transform_get_size   ( gint w, gint h,
+                                      const gp_affine *m,
+                                      gint *width, gint *height );
+
+/* A new RGBA pixbuf just big enough for src mapped through m, its
+ * origin at the top left of that box. What no source pixel covers is
+ * transparent. NULL if m is degenerate or the result too big. */
+GdkPixbuf * gp_transform_pixbuf     ( const GdkPixbuf *src,
+                                      const gp_affine *m,
+                                      gp_filter filter );
+
+#endif /*__GP_TRANSFORM_H__*/
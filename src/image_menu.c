@@ -47,6 +47,9 @@ typedef struct{
 	gint			degrees;
 }GPFlipRotateDlg;
 
+/* degrees of GPFlipRotateDlg when the angle comes from the spin button */
+#define GP_ROTATE_ANGLE	(-1)
+
 //typedef struct{
 //	gdouble w; /* Image width in pixels */
 //	gdouble h; /* Image height in pixels */
@@ -59,6 +62,9 @@ static void get_dpi(gint *x, gint *y);
 static void attributes_dlg_display_size(guint type, gboolean from_drawable);
 static gdouble entry_get_number(GtkWidget *widget);
 static gdouble convert_units (int from, int to, gdouble d, guint Dpi);
+static void set_rotate_sensitive (gboolean sensitive);
+static gdouble rotate_angle (void);
+static void transform_canvas (const gp_affine *m, gp_filter filter, gint tool);
 
 static GPFlipRotateDlg m_fr = {NULL, GP_FILP_HORZ, GDK_PIXBUF_ROTATE_COUNTERCLOCKWISE};
 
@@ -71,30 +77,15 @@ on_menu_flip_rotate_activate ( GtkMenuItem *menuitem, gpointer user_data )
 {
 	gint response;
 	GtkWidget *dialog;
-	GtkWidget *widget90, *widget180, *widget270;
-	GtkWidget *flip_vert, *flip_horz, *rotate;
+	GtkWidget *rotate;
 	gp_canvas *cv;
 	
 	printf("show_flip_rotate_dialog()\n");
 	
     cv = (gp_canvas *)cv_get_canvas ( );
 
-	widget90  = GTK_WIDGET (g_object_get_data(G_OBJECT(cv->widget), "radiobutton_rotate_90"));
-	widget180 = GTK_WIDGET (g_object_get_data(G_OBJECT(cv->widget), "radiobutton_rotate_180"));
-	widget270 = GTK_WIDGET (g_object_get_data(G_OBJECT(cv->widget), "radiobutton_rotate_270"));
 	rotate    = GTK_WIDGET (g_object_get_data(G_OBJECT(cv->widget), "radiobutton_rotate"));
-
-    if(!gtk_toggle_button_get_active ( GTK_TOGGLE_BUTTON( rotate )))
-    {
-	    gtk_widget_set_sensitive (widget90, FALSE);
-		gtk_widget_set_sensitive (widget180, FALSE);
-		gtk_widget_set_sensitive (widget270, FALSE);
-	}
-	else{
-		gtk_widget_set_sensitive (widget90, TRUE);
-		gtk_widget_set_sensitive (widget180, TRUE);
-		gtk_widget_set_sensitive (widget270, TRUE);
-	}
+	set_rotate_sensitive (gtk_toggle_button_get_active ( GTK_TOGGLE_BUTTON( rotate )));
     
     dialog = g_object_get_data(G_OBJECT(cv->widget), "flip_roate_dialog");
 
@@ -112,11 +103,27 @@ on_menu_flip_rotate_activate ( GtkMenuItem *menuitem, gpointer user_data )
 	    			gp_selection_flip(m_fr.effect);
 	    			break;
 	    		case GP_ROTATE:
-	    			gp_selection_rotate(m_fr.degrees);
+	    			if(GP_ROTATE_ANGLE == m_fr.degrees)
+	    			{
+	    				gp_affine m;
+	    				gp_affine_rotate (&m, rotate_angle ());
+	    				gp_selection_transform (&m, GP_FILTER_BICUBIC);
+	    			}
+	    			else
+	    			{
+	    				gp_selection_rotate(m_fr.degrees);
+	    			}
 	    			break;
     		}
     		gtk_widget_queue_draw ( cv->widget );
     	}
+    	else if(GP_ROTATE == m_fr.effect && GP_ROTATE_ANGLE == m_fr.degrees)
+    	{
+    		/* the canvas grows to hold the turned image */
+    		gp_affine m;
+    		gp_affine_rotate (&m, rotate_angle ());
+    		transform_canvas (&m, GP_FILTER_BICUBIC, TOOL_ROTATE_CANVAS);
+    	}
     	else
     	{
     		/* Apply effect to canvas */
@@ -177,27 +184,15 @@ void on_radiobutton_flip_vertical_toggled (GtkRadioButton *object, gpointer user
 
 void on_radiobutton_rotate_toggled (GtkRadioButton *object, gpointer user_data)
 {
-	GtkWidget *widget90, *widget180, *widget270;
-	gp_canvas *cv = cv_get_canvas();
-
-	widget90 = GTK_WIDGET (g_object_get_data(G_OBJECT(cv->widget), "radiobutton_rotate_90"));
-	widget180 = GTK_WIDGET (g_object_get_data(G_OBJECT(cv->widget), "radiobutton_rotate_180"));
-	widget270 = GTK_WIDGET (g_object_get_data(G_OBJECT(cv->widget), "radiobutton_rotate_270"));
-
 	printf("on_radiobutton_rotate_toggled()\n");
 	if ( gtk_toggle_button_get_active ( GTK_TOGGLE_BUTTON( object ) ) )
 	{
 		m_fr.effect = GP_ROTATE;
-		
-		gtk_widget_set_sensitive (widget90, TRUE);
-		gtk_widget_set_sensitive (widget180, TRUE);
-		gtk_widget_set_sensitive (widget270, TRUE);
+		set_rotate_sensitive (TRUE);
 	}
 	else
 	{
-		gtk_widget_set_sensitive (widget90, FALSE);
-		gtk_widget_set_sensitive (widget180, FALSE);
-		gtk_widget_set_sensitive (widget270, FALSE);
+		set_rotate_sensitive (FALSE);
 	}
 }
 
@@ -231,18 +226,117 @@ void on_radiobutton_rotate_270_toggled (GtkRadioButton *object, gpointer user_da
 	}
 }
 
+void on_radiobutton_rotate_angle_toggled (GtkRadioButton *object, gpointer user_data)
+{
+	gp_canvas *cv = cv_get_canvas();
+	GtkWidget *spin;
+
+	spin = GTK_WIDGET (g_object_get_data(G_OBJECT(cv->widget), "spin_rotate_angle"));
+	if ( gtk_toggle_button_get_active ( GTK_TOGGLE_BUTTON( object ) ) )
+	{
+		m_fr.degrees = GP_ROTATE_ANGLE;
+	}
+	gtk_widget_set_sensitive (spin, gtk_toggle_button_get_active ( GTK_TOGGLE_BUTTON( object ) ));
+}
+
+/* the angle radio and its spin button follow the other angles */
+static void
+set_rotate_sensitive (gboolean sensitive)
+{
+	gp_canvas *cv = cv_get_canvas();
+	GtkWidget *angle;
+
+	gtk_widget_set_sensitive (GTK_WIDGET (g_object_get_data(G_OBJECT(cv->widget), "radiobutton_rotate_90")), sensitive);
+	gtk_widget_set_sensitive (GTK_WIDGET (g_object_get_data(G_OBJECT(cv->widget), "radiobutton_rotate_180")), sensitive);
+	gtk_widget_set_sensitive (GTK_WIDGET (g_object_get_data(G_OBJECT(cv->widget), "radiobutton_rotate_270")), sensitive);
+	angle = GTK_WIDGET (g_object_get_data(G_OBJECT(cv->widget), "radiobutton_rotate_angle"));
+	gtk_widget_set_sensitive (angle, sensitive);
+	gtk_widget_set_sensitive (GTK_WIDGET (g_object_get_data(G_OBJECT(cv->widget), "spin_rotate_angle")),
+	                          sensitive && gtk_toggle_button_get_active ( GTK_TOGGLE_BUTTON( angle ) ));
+}
+
+/* degrees counterclockwise */
+static gdouble
+rotate_angle (void)
+{
+	gp_canvas *cv = cv_get_canvas();
+
+	return gtk_spin_button_get_value (GTK_SPIN_BUTTON (
+	           g_object_get_data(G_OBJECT(cv->widget), "spin_rotate_angle")));
+}
+
+/* Replace the canvas with itself mapped through m, resized to fit;
+ * what the source does not cover is background. */
+static void
+transform_canvas (const gp_affine *m, gp_filter filter, gint tool)
+{
+	gp_canvas *cv = cv_get_canvas ( );
+	GdkPixbuf *pixbuf, *result;
+	GdkRectangle rect = {0, 0, 0, 0};
+	gint w, h;
+
+	pixbuf = cv_get_pixbuf();
+	result = gp_transform_pixbuf (pixbuf, m, filter);
+	g_object_unref ( pixbuf );
+	g_return_if_fail ( result != NULL );
+
+	gdk_drawable_get_size (cv->pixmap, &rect.width, &rect.height);
+	undo_add (&rect, NULL, NULL, tool );
+
+	w = gdk_pixbuf_get_width (result);
+	h = gdk_pixbuf_get_height (result);
+	cv_resize_pixmap (w, h);
+	gdk_draw_rectangle (cv->pixmap, cv->gc_bg, TRUE, 0, 0, w, h);
+	gdk_draw_pixbuf (cv->pixmap, cv->gc_fg, result, 0, 0, 0, 0, w, h,
+	                 GDK_RGB_DITHER_NORMAL, 0, 0);
+	g_object_unref ( result );
+	gtk_widget_queue_draw ( cv->widget );
+}
+
 /************** Stretch/Skew stuff *****************************************/
 void on_menu_stretch_skew_activate ( GtkMenuItem *menuitem, gpointer user_data )
 {
-	gint width, height, percent = 100;
-	/* Resize formula */
-	if(100 != percent)
-		width = percent / 100 * width;
+	gint response;
+	GtkWidget *dialog;
+	gp_canvas *cv = cv_get_canvas ( );
+	gdouble sx, sy, kx, ky;
+	gp_filter filter;
+	gp_affine m;
 
-	if(100 != percent)
-		height = percent / 100 * height;
+	dialog = g_object_get_data(G_OBJECT(cv->widget), "stretch_skew_dialog");
+	response = gtk_dialog_run (GTK_DIALOG (dialog));
+	gtk_widget_hide( dialog );
+	if(GTK_RESPONSE_OK != response)
+	{
+		return;
+	}
 
-	printf("stretch/skew not implemented\n");
+	sx = gtk_spin_button_get_value (GTK_SPIN_BUTTON (
+	         g_object_get_data(G_OBJECT(cv->widget), "spin_stretch_horizontal")));
+	sy = gtk_spin_button_get_value (GTK_SPIN_BUTTON (
+	         g_object_get_data(G_OBJECT(cv->widget), "spin_stretch_vertical")));
+	kx = gtk_spin_button_get_value (GTK_SPIN_BUTTON (
+	         g_object_get_data(G_OBJECT(cv->widget), "spin_skew_horizontal")));
+	ky = gtk_spin_button_get_value (GTK_SPIN_BUTTON (
+	         g_object_get_data(G_OBJECT(cv->widget), "spin_skew_vertical")));
+	filter = gtk_combo_box_get_active (GTK_COMBO_BOX (
+	         g_object_get_data(G_OBJECT(cv->widget), "combo_stretch_skew_filter")));
+	if(sx == 100 && sy == 100 && kx == 0 && ky == 0)
+	{
+		return;
+	}
+	gp_affine_stretch_skew (&m, sx / 100.0, sy / 100.0, kx, ky);
+
+	if(gp_selection_query())
+	{
+		gp_selection_transform (&m, filter);
+		gtk_widget_queue_draw ( cv->widget );
+	}
+	else
+	{
+		/* Apply effect to canvas */
+		transform_canvas (&m, filter, TOOL_STRETCH_CANVAS);
+	}
 }
 
 /************** Invert menu item *******************************************/
@@ -21,6 +21,8 @@ void on_radiobutton_rotate_180_toggled		( GtkRadioButton *object,
 											  gpointer user_data );
 void on_radiobutton_rotate_270_toggled		( GtkRadioButton *object,
 											  gpointer user_data );
+void on_radiobutton_rotate_angle_toggled	( GtkRadioButton *object,
+											  gpointer user_data );
 void on_menu_clear_image_activate			( GtkMenuItem *menuitem,
 											  gpointer user_data );
 void on_menu_draw_opaque_activate           ( GtkMenuItem *menuitem,
@@ -31,6 +31,7 @@
 
 #include "cv_eraser_tool.h"
 #include "cv_paintbrush_tool.h"
+#include "gp_brush_library.h"
 
 #include <glib/gi18n.h>
 #include <gtk/gtk.h>
@@ -46,6 +47,7 @@ void		on_menu_about_activate  ( GtkMenuItem *menuitem, gpointer user_data );
 
 static void init_eraser				(GtkBuilder *builder);
 static void init_paint_brush		(GtkBuilder *builder);
+static void fill_brush_images		(gpointer combo);
 static void save_the_children		(GtkBuilder *builder);
 
 void		
@@ -81,6 +83,8 @@ main (int argc, char *argv[])
 	textdomain (GETTEXT_PACKAGE);
 	
 	gtk_set_locale ();
+	/* stretch/skew resamples on a thread pool */
+	if (!g_thread_supported ()) g_thread_init (NULL);
 	gtk_init (&argc, &argv);
 
 	/* Add application specific icons to search path */
@@ -99,6 +103,7 @@ main (int argc, char *argv[])
 		            G_CALLBACK (color_picker_released), NULL);
 	
 	gtk_main ();
+	gp_brush_library_free ();
 
 //	g_mem_profile ();
 	
@@ -277,6 +282,22 @@ static void init_paint_brush(GtkBuilder *builder)
 		g_signal_connect (brush, "toggled",
 		            G_CALLBACK (on_brush_size_toggled), (gpointer)&(size[i]));
 	}
+
+	/* Image brushes are listed once the window is up */
+	brush = GTK_WIDGET (gtk_builder_get_object (builder, "combo_brush_image"));
+	gp_brush_library_load_idle (fill_brush_images, brush);
+}
+
+static void fill_brush_images(gpointer combo)
+{
+	gint i, n;
+
+	n = gp_brush_library_get_size ();
+	for(i = 0; i < n; i++)
+	{
+		gtk_combo_box_append_text (GTK_COMBO_BOX (combo),
+		                           gp_brush_library_get_name (i));
+	}
 }
 
 static void save_the_children (GtkBuilder *builder)
@@ -296,6 +317,24 @@ static void save_the_children (GtkBuilder *builder)
 	g_object_set_data(G_OBJECT(drawing), "radiobutton_rotate_180", (gpointer)child);
 	child = GTK_WIDGET (gtk_builder_get_object (builder, "radiobutton_rotate_270"));
 	g_object_set_data(G_OBJECT(drawing), "radiobutton_rotate_270", (gpointer)child);
+	child = GTK_WIDGET (gtk_builder_get_object (builder, "radiobutton_rotate_angle"));
+	g_object_set_data(G_OBJECT(drawing), "radiobutton_rotate_angle", (gpointer)child);
+	child = GTK_WIDGET (gtk_builder_get_object (builder, "spin_rotate_angle"));
+	g_object_set_data(G_OBJECT(drawing), "spin_rotate_angle", (gpointer)child);
+
+	/* Stretch skew dlg */
+	child = GTK_WIDGET (gtk_builder_get_object (builder, "stretch_skew_dialog"));
+	g_object_set_data(G_OBJECT(drawing), "stretch_skew_dialog", (gpointer)child);
+	child = GTK_WIDGET (gtk_builder_get_object (builder, "spin_stretch_horizontal"));
+	g_object_set_data(G_OBJECT(drawing), "spin_stretch_horizontal", (gpointer)child);
+	child = GTK_WIDGET (gtk_builder_get_object (builder, "spin_stretch_vertical"));
+	g_object_set_data(G_OBJECT(drawing), "spin_stretch_vertical", (gpointer)child);
+	child = GTK_WIDGET (gtk_builder_get_object (builder, "spin_skew_horizontal"));
+	g_object_set_data(G_OBJECT(drawing), "spin_skew_horizontal", (gpointer)child);
+	child = GTK_WIDGET (gtk_builder_get_object (builder, "spin_skew_vertical"));
+	g_object_set_data(G_OBJECT(drawing), "spin_skew_vertical", (gpointer)child);
+	child = GTK_WIDGET (gtk_builder_get_object (builder, "combo_stretch_skew_filter"));
+	g_object_set_data(G_OBJECT(drawing), "combo_stretch_skew_filter", (gpointer)child);
 
 	/* Attributes dlg */
 	child = GTK_WIDGET (gtk_builder_get_object (builder, "dialog_attributes"));
@@ -21,6 +21,8 @@
 
 #include <gtk/gtk.h>
 #include <glib/gprintf.h>
+#include <math.h>
+#include <string.h>
 #include "pixbuf_util.h"
 
 struct fillinfo
@@ -33,6 +35,8 @@ struct fillinfo
    unsigned char or, og, ob, oa;
    unsigned char r, g, b, a;
    int gx, gw, gy, gh;
+   int tolerance;		/* per channel, 0 matches the seed colour only */
+   unsigned char *mask;	/* width * height, 1 where the fill reaches */
 };
 
 //static gint gx, gw, gy, gh;
@@ -43,9 +47,32 @@ static gint fill_shape(GdkPixbuf *pixbuf, guint x, guint y, guint nc);
 
 static void
 flood_fill_algo(struct fillinfo *info, int x, int y);
+static void
+fill_apply_style(struct fillinfo *info, const gp_fill_style *style,
+                 const GdkRectangle *rect);
+static void
+match_pixels(guchar *mask, const guchar *src, gint n, const guchar *ref,
+             guchar tolerance);
+static gboolean
+mask_bounds(const guchar *mask, gint width, gint height, GdkRectangle *rect);
 
 
 GdkRectangle fill_draw(GdkDrawable *drawable, GdkGC *gc, guint fill_color, guint x, guint y)
+{
+	gp_fill_style style;
+
+	style.mode		= FILL_FLAT;
+	style.color1	= fill_color;
+	style.color2	= fill_color;
+	style.p0.x		= x;
+	style.p0.y		= y;
+	style.p1		= style.p0;
+	style.pattern	= NULL;
+	return fill_draw_style(drawable, gc, &style, x, y);
+}
+
+GdkRectangle fill_draw_style(GdkDrawable *drawable, GdkGC *gc,
+                             const gp_fill_style *style, guint x, guint y)
 {
 	GdkPixbuf *pixbuf;
 	gint width, height;
@@ -53,11 +80,10 @@ GdkRectangle fill_draw(GdkDrawable *drawable, GdkGC *gc, guint fill_color, guint
 	guchar *p;
 	GdkRectangle rect = {0, 0, 0, 0};
 	
-	//printf("fill_draw fill_color: %.08X\n", fill_color);
-	//printf("fill_draw x: %d, y: %d\n", x, y);
-	
 	gdk_drawable_get_size(drawable, &width, &height);
-	//printf("fill_draw w: %d, h: %d\n", width, height);
+	if(x >= (guint)width || y >= (guint)height){
+		return rect;
+	}
 	pixbuf = gdk_pixbuf_new(GDK_COLORSPACE_RGB, TRUE, 8, width, height);
 
 	gdk_pixbuf_fill(pixbuf, 0);
@@ -70,48 +96,134 @@ GdkRectangle fill_draw(GdkDrawable *drawable, GdkGC *gc, guint fill_color, guint
 	fillinfo.gy = y;
 	fillinfo.gh = y;
 
-	/* 2 draw on pixbuf */
-	//fill_shape(pixbuf, x, y, fill_color);
+	/* 2 find the area to fill */
 	fillinfo.rgb = gdk_pixbuf_get_pixels (pixbuf);
     fillinfo.width = gdk_pixbuf_get_width (pixbuf);
     fillinfo.height = gdk_pixbuf_get_height (pixbuf);
     fillinfo.rowstride = gdk_pixbuf_get_rowstride (pixbuf);
     fillinfo.pixelsize = gdk_pixbuf_get_n_channels (pixbuf);
-    fillinfo.r = getr(fill_color);
-    fillinfo.g = getg(fill_color);
-    fillinfo.b = getb(fill_color);
-    fillinfo.a = geta(fill_color);
+    fillinfo.r = getr(style->color1);
+    fillinfo.g = getg(style->color1);
+    fillinfo.b = getb(style->color1);
+    fillinfo.a = geta(style->color1);
     p = fillinfo.rgb + y * fillinfo.rowstride + x * fillinfo.pixelsize;
     fillinfo.or = *p;
     fillinfo.og = *(p + 1);
     fillinfo.ob = *(p + 2);
     fillinfo.oa = *(p + 3);
+    fillinfo.tolerance = 0;
+    fillinfo.mask = g_new0(guchar, width * height);
     
-    printf("     new color: %.02X%.02X%.02X%.02X\n", fillinfo.r, fillinfo.g, fillinfo.b, fillinfo.a);
-    printf("original color: %.02X%.02X%.02X%.02X\n", fillinfo.or, fillinfo.og, fillinfo.ob, fillinfo.oa);
+    if ((style->mode == FILL_FLAT) && (fillinfo.or == fillinfo.r) &&
+        (fillinfo.og == fillinfo.g) && (fillinfo.ob == fillinfo.b))
+    {
+        /* nothing would change */
+        g_free(fillinfo.mask);
+        g_object_unref(pixbuf);
+        rect.x = x; rect.y = y;
+        rect.width = 1; rect.height = 1;
+        return rect;
+    }
 
     flood_fill_algo(&fillinfo, x, y);
 
-	/* 3 draw pixbuf back onto drawable.  */
-	gdk_draw_pixbuf(drawable, gc, pixbuf, 0, 0, 0, 0, gdk_pixbuf_get_width(pixbuf),
-					gdk_pixbuf_get_height(pixbuf), GDK_RGB_DITHER_NONE, 0, 0);
-	
-	/* clean up */
-	g_object_unref(pixbuf);
-    
     fillinfo.gw = ABS(fillinfo.gw - fillinfo.gx);
 	fillinfo.gh = ABS(fillinfo.gh - fillinfo.gy);
-	
-	/*g_printf("fillinfo.gx: %d, fillinfo.gy: %d, fillinfo.gw: %d, fillinfo.
-	fillinfo.gh: %d\n", fillinfo.gx, fillinfo.gy, fillinfo.gw, fillinfo.gh);
-	*/
 	rect.x = fillinfo.gx; rect.y = fillinfo.gy;
 	rect.width = fillinfo.gw + 1; rect.height = fillinfo.gh + 1;
+
+	/* 3 paint the masked area */
+	fill_apply_style(&fillinfo, style, &rect);
+
+	/* 4 draw the changed part of the pixbuf back onto drawable.  */
+	gdk_draw_pixbuf(drawable, gc, pixbuf, rect.x, rect.y, rect.x, rect.y,
+	                rect.width, rect.height, GDK_RGB_DITHER_NONE, 0, 0);
+	
+	/* clean up */
+	g_free(fillinfo.mask);
+	g_object_unref(pixbuf);
 	
 	/* Return bounding rect of fill */
 	return rect;
 }
 
+/* Selection by colour: marks the pixels that match the one at (x,y)
+ * within 'tolerance' on every channel.  Contiguous uses the flood fill
+ * span search, so it finds exactly what the bucket would paint; else
+ * the whole canvas is matched in one pass.  Returns a width * height
+ * mask of the drawable, 1 where selected, to be freed with g_free(),
+ * and its bounding box in 'rect'; NULL if (x,y) is off the drawable.
+ */
+guchar *fill_select(GdkDrawable *drawable, guint x, guint y, guint tolerance,
+                    gboolean contiguous, GdkRectangle *rect)
+{
+	GdkPixbuf *pixbuf;
+	gint width, height;
+	struct fillinfo fillinfo;
+	guchar *p;
+
+	gdk_drawable_get_size(drawable, &width, &height);
+	if(x >= (guint)width || y >= (guint)height){
+		return NULL;
+	}
+	pixbuf = gdk_pixbuf_new(GDK_COLORSPACE_RGB, TRUE, 8, width, height);
+	gdk_pixbuf_fill(pixbuf, 0);
+	gdk_pixbuf_get_from_drawable(pixbuf, drawable, NULL, 0, 0, 0, 0, width, height);
+
+	fillinfo.rgb = gdk_pixbuf_get_pixels (pixbuf);
+	fillinfo.width = width;
+	fillinfo.height = height;
+	fillinfo.rowstride = gdk_pixbuf_get_rowstride (pixbuf);
+	fillinfo.pixelsize = gdk_pixbuf_get_n_channels (pixbuf);
+	fillinfo.tolerance = MIN(tolerance, 255);
+	p = fillinfo.rgb + y * fillinfo.rowstride + x * fillinfo.pixelsize;
+	fillinfo.or = p[0];
+	fillinfo.og = p[1];
+	fillinfo.ob = p[2];
+	fillinfo.oa = p[3];
+	fillinfo.mask = g_new0(guchar, width * height);
+
+	if (contiguous)
+	{
+		fillinfo.gx = x;
+		fillinfo.gw = x;
+		fillinfo.gy = y;
+		fillinfo.gh = y;
+		flood_fill_algo(&fillinfo, x, y);
+		rect->x = fillinfo.gx;
+		rect->y = fillinfo.gy;
+		rect->width = fillinfo.gw - fillinfo.gx + 1;
+		rect->height = fillinfo.gh - fillinfo.gy + 1;
+	}
+	else
+	{
+		guchar ref[4];
+		gint row;
+
+		memcpy(ref, p, 4);
+		if (fillinfo.rowstride == width * 4)
+		{
+			/* rows are packed: the whole canvas is one run */
+			match_pixels(fillinfo.mask, fillinfo.rgb, width * height,
+			             ref, fillinfo.tolerance);
+		}
+		else
+		{
+			for (row = 0; row < height; row++)
+			{
+				match_pixels(fillinfo.mask + row * width,
+				             fillinfo.rgb + row * fillinfo.rowstride,
+				             width, ref, fillinfo.tolerance);
+			}
+		}
+		/* the seed pixel always matches, there is a box */
+		mask_bounds(fillinfo.mask, width, height, rect);
+	}
+
+	g_object_unref(pixbuf);
+	return fillinfo.mask;
+}
+
 /* Get a pixel's value at (x,y)
  * For pixbufs with alpha channel only.
  * Sets 'color' as rgb value
@@ -262,12 +374,18 @@ is_old_pixel_value(struct fillinfo *info, int x, int y)
 {
     unsigned char *p = info->rgb + y * info->rowstride + x * info->pixelsize;
     unsigned char or, og, ob, oa;
+    if (info->mask[y * info->width + x])
+    {
+        return 0;
+    }
     or = *p;
     og = *(p + 1);
     ob = *(p + 2);
     oa = *(p + 3);
-    if ((or == info->or) && (og == info->og) && 
-    	(ob == info->ob) && (oa == info->oa))
+    if ((ABS(or - info->or) <= info->tolerance) &&
+        (ABS(og - info->og) <= info->tolerance) &&
+        (ABS(ob - info->ob) <= info->tolerance) &&
+        (ABS(oa - info->oa) <= info->tolerance))
     {
         return 1;
     }
@@ -278,12 +396,7 @@ is_old_pixel_value(struct fillinfo *info, int x, int y)
 static __inline__ void
 set_new_pixel_value(struct fillinfo *info, int x, int y)
 {
-    unsigned char *p = info->rgb + y * info->rowstride + x * info->pixelsize;
-    
-    *p		 = info->r;
-    *(p + 1) = info->g;
-    *(p + 2) = info->b;
-    *(p + 3) = info->a;
+    info->mask[y * info->width + x] = 1;
     
     if (x <= info->gx)info->gx=x;
 	if (x > info->gw)info->gw=x;
@@ -305,10 +418,6 @@ flood_fill_algo(struct fillinfo *info, int x, int y)
       
     if ((x >= 0) && (x < info->width) && (y >= 0) && (y < info->height))
     {
-        if ((info->or == info->r) && (info->og == info->g) && (info->ob == info->b))
-        {
-            return;
-        }
         PUSH(y, x, x, 1);
         PUSH(y + 1, x, x, -1);
         while (sp > stack)  
@@ -350,3 +459,262 @@ skip:
     }
 }  
 
+
+/*
+ * Global colour selection.  One branch free loop over packed RGBA so
+ * the compiler can vectorize it: unsigned differences through the
+ * compare, no abs() and no early exit per channel.
+ */
+static void
+match_pixels(guchar *mask, const guchar *src, gint n, const guchar *ref,
+             guchar tolerance)
+{
+    gint i, c;
+    for (i = 0; i < n; i++, src += 4)
+    {
+        guchar hit = 1;
+        for (c = 0; c < 4; c++)
+        {
+            guchar d = (src[c] > ref[c]) ? src[c] - ref[c] : ref[c] - src[c];
+            hit &= (d <= tolerance);
+        }
+        mask[i] = hit;
+    }
+}
+
+/* bounding box of the non zero bytes, FALSE if there are none */
+static gboolean
+mask_bounds(const guchar *mask, gint width, gint height, GdkRectangle *rect)
+{
+    gint x0 = width, x1 = -1, y0 = height, y1 = -1;
+    gint x, y;
+
+    for (y = 0; y < height; y++)
+    {
+        const guchar *row = mask + y * width;
+        for (x = 0; x < width && !row[x]; x++)
+        {
+            /* empty */ ;
+        }
+        if (x == width) continue;
+        x0 = MIN(x0, x);
+        for (x = width - 1; !row[x]; x--)
+        {
+            /* empty */ ;
+        }
+        x1 = MAX(x1, x);
+        y0 = MIN(y0, y);
+        y1 = y;
+    }
+    if (y1 < 0) return FALSE;
+    rect->x = x0;
+    rect->y = y0;
+    rect->width = x1 - x0 + 1;
+    rect->height = y1 - y0 + 1;
+    return TRUE;
+}
+
+
+/*
+ * Fill styles.
+ * The flood fill only marks info->mask, the style is painted afterwards
+ * one row of the bounding box at a time.  Each row goes through small
+ * branch free loops over plain arrays (gradient parameter, then colour +
+ * dither, then masked store) so the compiler can vectorize them.
+ */
+
+/* 4x4 ordered dither matrix */
+static const gint bayer4[4][4] =
+{
+    {  0,  8,  2, 10 },
+    { 12,  4, 14,  6 },
+    {  3, 11,  1,  9 },
+    { 15,  7, 13,  5 }
+};
+
+#define GRAD_ONE    65536
+
+/* t[i] = base + i * step, clamped to [0, GRAD_ONE] */
+static void
+gradient_row_linear(gint32 *t, gint n, gfloat base, gfloat step)
+{
+    gint i;
+    for (i = 0; i < n; i++)
+    {
+        gfloat v = base + step * (gfloat)i;
+        v = (v < 0.0f) ? 0.0f : v;
+        v = (v > (gfloat)GRAD_ONE) ? (gfloat)GRAD_ONE : v;
+        t[i] = (gint32)v;
+    }
+}
+
+/* t[i] = distance of (x0 + i, y) from the centre / radius */
+static void
+gradient_row_radial(gint32 *t, gint n, gfloat dx0, gfloat dy, gfloat scale)
+{
+    gint i;
+    gfloat dy2 = dy * dy;
+    for (i = 0; i < n; i++)
+    {
+        gfloat dx = dx0 + (gfloat)i;
+        gfloat v  = sqrtf(dx * dx + dy2) * scale;
+        v = (v > (gfloat)GRAD_ONE) ? (gfloat)GRAD_ONE : v;
+        t[i] = (gint32)v;
+    }
+}
+
+/* One channel of the gradient: c0 + (c1 - c0) * t in 16.16 fixed point
+ * plus the ordered dither threshold for this pixel, then truncate. */
+static void
+gradient_row_channel(guchar *out, const gint32 *t, const gint32 *dither,
+                     gint n, gint c0, gint c1)
+{
+    gint i;
+    gint32 base  = c0 << 16;
+    gint32 delta = c1 - c0;
+    for (i = 0; i < n; i++)
+    {
+        gint32 v = (base + delta * t[i] + dither[i]) >> 16;
+        v = (v < 0) ? 0 : v;
+        v = (v > 255) ? 255 : v;
+        out[i * 4] = (guchar)v;
+    }
+}
+
+/* store the rgba row in 'src' where the mask is set */
+static void
+masked_store_row(guint32 *dst, const guint32 *src, const guchar *mask, gint n)
+{
+    gint i;
+    for (i = 0; i < n; i++)
+    {
+        dst[i] = mask[i] ? src[i] : dst[i];
+    }
+}
+
+static void
+pattern_row(guchar *out, GdkPixbuf *pattern, gint x, gint y, gint n)
+{
+    gint    pw          = gdk_pixbuf_get_width (pattern);
+    gint    ph          = gdk_pixbuf_get_height (pattern);
+    gint    nc          = gdk_pixbuf_get_n_channels (pattern);
+    guchar  *row;
+    gint    px, i;
+
+    y   = ((y % ph) + ph) % ph;
+    px  = ((x % pw) + pw) % pw;
+    row = gdk_pixbuf_get_pixels (pattern) + y * gdk_pixbuf_get_rowstride (pattern);
+    for (i = 0; i < n; i++)
+    {
+        guchar *s = row + px * nc;
+        out[i * 4]     = s[0];
+        out[i * 4 + 1] = s[1];
+        out[i * 4 + 2] = s[2];
+        out[i * 4 + 3] = (nc == 4) ? s[3] : 0xFF;
+        if (++px == pw) px = 0;
+    }
+}
+
+/* pattern pixels may be translucent: blend them over the canvas */
+static void
+blend_row(guchar *dst, const guchar *src, const guchar *mask, gint n)
+{
+    gint i, c;
+    for (i = 0; i < n; i++)
+    {
+        gint a = mask[i] ? src[i * 4 + 3] : 0;
+        for (c = 0; c < 3; c++)
+        {
+            gint d = dst[i * 4 + c];
+            dst[i * 4 + c] = (guchar)(d + ((src[i * 4 + c] - d) * a + 127) / 255);
+        }
+        dst[i * 4 + 3] = (guchar)MAX(dst[i * 4 + 3], a);
+    }
+}
+
+static void
+fill_apply_style(struct fillinfo *info, const gp_fill_style *style,
+                 const GdkRectangle *rect)
+{
+    gint        n       = rect->width;
+    gint32      *t      = g_new (gint32, n);
+    gint32      *dither = g_new (gint32, n);
+    guint32     *row    = g_new (guint32, n);
+    guchar      *out    = (guchar *)row;
+    gfloat      gdx     = (gfloat)(style->p1.x - style->p0.x);
+    gfloat      gdy     = (gfloat)(style->p1.y - style->p0.y);
+    gfloat      len2    = gdx * gdx + gdy * gdy;
+    gfloat      scale   = 0.0f;
+    gint        x, y, i;
+
+    if (len2 < 1.0f) len2 = 1.0f;
+    if (style->mode == FILL_RADIAL)
+    {
+        scale = (gfloat)GRAD_ONE / sqrtf(len2);
+    }
+
+    for (y = rect->y; y < rect->y + rect->height; y++)
+    {
+        guchar  *mask   = info->mask + y * info->width + rect->x;
+        guchar  *dst    = info->rgb + y * info->rowstride + rect->x * info->pixelsize;
+
+        switch (style->mode)
+        {
+            case FILL_LINEAR:
+            case FILL_RADIAL:
+            {
+                if (style->mode == FILL_LINEAR)
+                {
+                    gfloat base = ((rect->x - style->p0.x) * gdx +
+                                   (y - style->p0.y) * gdy) * GRAD_ONE / len2;
+                    gradient_row_linear (t, n, base, gdx * GRAD_ONE / len2);
+                }
+                else
+                {
+                    gradient_row_radial (t, n, (gfloat)(rect->x - style->p0.x),
+                                         (gfloat)(y - style->p0.y), scale);
+                }
+                for (i = 0, x = rect->x; i < n; i++, x++)
+                {
+                    dither[i] = (2 * bayer4[y & 3][x & 3] + 1) << 11;
+                }
+                gradient_row_channel (out,     t, dither, n,
+                                      getr(style->color1), getr(style->color2));
+                gradient_row_channel (out + 1, t, dither, n,
+                                      getg(style->color1), getg(style->color2));
+                gradient_row_channel (out + 2, t, dither, n,
+                                      getb(style->color1), getb(style->color2));
+                gradient_row_channel (out + 3, t, dither, n,
+                                      geta(style->color1), geta(style->color2));
+                masked_store_row ((guint32 *)dst, row, mask, n);
+                break;
+            }
+            case FILL_PATTERN:
+            {
+                if (GDK_IS_PIXBUF (style->pattern))
+                {
+                    pattern_row (out, style->pattern, rect->x - style->p0.x,
+                                 y - style->p0.y, n);
+                    blend_row (dst, out, mask, n);
+                    break;
+                }
+                /* no pattern: fall back to a flat fill */
+            }
+            case FILL_FLAT:
+            default:
+            {
+                guchar *c = (guchar *)&row[0];
+                c[0] = getr(style->color1);
+                c[1] = getg(style->color1);
+                c[2] = getb(style->color1);
+                c[3] = geta(style->color1);
+                for (i = 1; i < n; i++) row[i] = row[0];
+                masked_store_row ((guint32 *)dst, row, mask, n);
+                break;
+            }
+        }
+    }
+    g_free (t);
+    g_free (dither);
+    g_free (row);
+}
@@ -16,8 +16,35 @@
 #define getb(x) (((x >> 8) & 0x0FF))
 #define geta(x) ((x & 0x0FF))
 
+typedef enum
+{
+	FILL_FLAT,
+	FILL_LINEAR,
+	FILL_RADIAL,
+	FILL_PATTERN
+} gp_fill_mode;
+
+/* How the area found by the flood fill is painted.
+ * color1/color2 are col_rgba() values; the gradient runs from
+ * color1 at p0 to color2 at p1 (for radial, p1 is on the rim).
+ * For FILL_PATTERN, 'pattern' is tiled with its origin at p0.
+ */
+typedef struct
+{
+	gp_fill_mode	mode;
+	guint			color1;
+	guint			color2;
+	GdkPoint		p0;
+	GdkPoint		p1;
+	GdkPixbuf		*pattern;
+} gp_fill_style;
+
 GdkRectangle fill_draw(GdkDrawable *drawable, GdkGC *gc, guint fill_color,
 					   guint x, guint y);
+GdkRectangle fill_draw_style(GdkDrawable *drawable, GdkGC *gc,
+                             const gp_fill_style *style, guint x, guint y);
+guchar *fill_select(GdkDrawable *drawable, guint x, guint y, guint tolerance,
+                    gboolean contiguous, GdkRectangle *rect);
 gboolean get_pixel_from_pixbuf(GdkPixbuf *pixbuf, guint *color,
                                guint x, guint y);
 
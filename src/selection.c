@@ -25,7 +25,13 @@
 #include "selection.h"
 #include "cv_drawing.h"
 #include "gp-image.h"
+#include "gp_mask.h"
+#include "pixbuf_util.h"
 #include "undo.h"
+#include <math.h>
+
+/* longest side of the image turned while the rotate handle is dragged */
+#define ROTATE_PREVIEW_SIDE     512
 
 typedef enum {
     SEL_TOP_LEFT,
@@ -36,6 +42,7 @@ typedef enum {
     SEL_BOTTOM_MID,
     SEL_BOTTOM_LEFT,
     SEL_MID_LEFT,
+    SEL_ROTATE,
     SEL_CLIPBOX,
     SEL_NONE
 } GpSelBoxEnum;
@@ -57,6 +64,18 @@ typedef struct {
     gint            floating : 1;
     gboolean		transparent;
     GdkPixbuf		*pb_clipboard;
+    gp_mask         *mask;      /* NULL for a rectangle              */
+    GdkPoint        *outline;   /* of the mask, from its top left    */
+    gint            n_outline;
+    GpImage         *rot_image; /* as it was when the rotate handle    *
+                                 * was grabbed, NULL otherwise         */
+    GpImage         *rot_proxy; /* small copy of it for the preview    */
+    gdouble         rot_cx;     /* turned about this point             */
+    gdouble         rot_cy;
+    gdouble         rot_start;  /* pointer angle at the press, radians */
+    gdouble         rot_degrees;
+    gint            rot_w;      /* clipbox size at the press, which    */
+    gint            rot_h;      /* the image may be resized to         */
 } PrivData;
 
 static gboolean gp_selection_get_bg_color_rgb(guchar *r, guchar *g, guchar *b);
@@ -83,6 +102,23 @@ destroy_image ( void )
         g_object_unref ( m_priv->image );
         m_priv->image = NULL;
     }
+    if ( m_priv->rot_image != NULL )
+    {
+        g_object_unref ( m_priv->rot_image );
+        g_object_unref ( m_priv->rot_proxy );
+        m_priv->rot_image = NULL;
+        m_priv->rot_proxy = NULL;
+    }
+}
+
+static void
+destroy_mask ( void )
+{
+    gp_mask_free ( m_priv->mask );
+    g_free ( m_priv->outline );
+    m_priv->mask        = NULL;
+    m_priv->outline     = NULL;
+    m_priv->n_outline   = 0;
 }
 
 static void
@@ -91,6 +127,7 @@ destroy_private_data( void )
     if ( m_priv != NULL )
     {
         destroy_image ();
+        destroy_mask ();
 	    g_slice_free (PrivData, m_priv);
 	    m_priv = NULL;
         g_print ("clear\n");
@@ -177,6 +214,16 @@ update_borders ( void )
                        xm-s/2,yb-s,xm+s/2,yb);
         set_sel_box ( &m_priv->boxes[SEL_BOTTOM_RIGHT],
                        xr-s,yb-s,xr,yb);
+        /*only a lifted image turns, and it needs room for the handle*/
+        if ( m_priv->image != NULL && yb - yt > 6*s )
+        {
+            set_sel_box ( &m_priv->boxes[SEL_ROTATE],
+                           xm-s/2,yt+2*s,xm+s/2,yt+3*s);
+        }
+        else
+        {
+            set_sel_box ( &m_priv->boxes[SEL_ROTATE], -1,-1,-2,-2);
+        }
     }
 }
 
@@ -208,6 +255,126 @@ get_box_in ( GdkPoint *point )
     return box;
 }
 
+/* put the clipbox, w x h, around the rotation centre */
+static void
+rotate_place ( gint w, gint h )
+{
+    GpSelBox *clipbox = &m_priv->boxes[SEL_CLIPBOX];
+
+    clipbox->p0.x = (gint)floor ( m_priv->rot_cx - w / 2.0 + 0.5 );
+    clipbox->p0.y = (gint)floor ( m_priv->rot_cy - h / 2.0 + 0.5 );
+    clipbox->p1.x = clipbox->p0.x + w - 1;
+    clipbox->p1.y = clipbox->p0.y + h - 1;
+}
+
+/* m scaled from the size of image to a w x h clipbox first */
+static void
+apply_clip_scale ( gp_affine *m, GpImage *image, gint w, gint h )
+{
+    gp_affine s;
+
+    gp_affine_stretch_skew ( &s,
+                             (gdouble)w / gp_image_get_width ( image ),
+                             (gdouble)h / gp_image_get_height ( image ),
+                             0.0, 0.0 );
+    gp_affine_multiply ( m, m, &s );
+}
+
+/* the turn so far, after the resize pending at the press */
+static void
+rotate_affine ( gp_affine *m )
+{
+    gp_affine_rotate ( m, m_priv->rot_degrees );
+    apply_clip_scale ( m, m_priv->rot_image, m_priv->rot_w, m_priv->rot_h );
+}
+
+/*
+ * The rotate handle was grabbed: keep the image as it is, every motion
+ * turns a small copy of it with the nearest filter, which is drawn
+ * scaled to the size the real result will have. Releasing the button
+ * turns the kept image once, bicubic.
+ */
+static void
+rotate_begin ( GdkPoint *p )
+{
+    GpSelBox    *clipbox = &m_priv->boxes[SEL_CLIPBOX];
+    gint        w, h, side;
+
+    m_priv->rot_cx      = ( clipbox->p0.x + clipbox->p1.x + 1 ) / 2.0;
+    m_priv->rot_cy      = ( clipbox->p0.y + clipbox->p1.y + 1 ) / 2.0;
+    m_priv->rot_start   = atan2 ( p->y - m_priv->rot_cy, p->x - m_priv->rot_cx );
+    m_priv->rot_degrees = 0.0;
+    m_priv->rot_w       = ABS ( clipbox->p1.x - clipbox->p0.x ) + 1;
+    m_priv->rot_h       = ABS ( clipbox->p1.y - clipbox->p0.y ) + 1;
+    m_priv->rot_image   = g_object_ref ( m_priv->image );
+    m_priv->rot_proxy   = gp_image_copy ( m_priv->image );
+
+    w       = gp_image_get_width ( m_priv->image );
+    h       = gp_image_get_height ( m_priv->image );
+    side    = MAX ( w, h );
+    if ( side > ROTATE_PREVIEW_SIDE )
+    {
+        gp_affine m;
+        gdouble scale = (gdouble)ROTATE_PREVIEW_SIDE / side;
+        gp_affine_stretch_skew ( &m, scale, scale, 0.0, 0.0 );
+        gp_image_transform ( m_priv->rot_proxy, &m, GP_FILTER_BILINEAR );
+    }
+    /*the image alpha carries the mask, which will not fit any more*/
+    destroy_mask ();
+}
+
+static void
+rotate_preview ( GdkPoint *p )
+{
+    GpImage     *preview;
+    gp_affine   m;
+    gdouble     a;
+    gint        w, h;
+
+    a = atan2 ( p->y - m_priv->rot_cy, p->x - m_priv->rot_cx );
+    /*screen angles grow clockwise*/
+    m_priv->rot_degrees = ( m_priv->rot_start - a ) * 180.0 / G_PI;
+    rotate_affine ( &m );
+    if ( !gp_transform_get_size ( gp_image_get_width ( m_priv->rot_image ),
+                                  gp_image_get_height ( m_priv->rot_image ),
+                                  &m, &w, &h ) )
+    {
+        return;
+    }
+    preview = gp_image_copy ( m_priv->rot_proxy );
+    gp_image_transform ( preview, &m, GP_FILTER_NEAREST );
+    gp_image_set_draft ( preview, TRUE );
+    g_object_unref ( m_priv->image );
+    m_priv->image = preview;
+    rotate_place ( w, h );
+}
+
+static void
+rotate_end ( void )
+{
+    GpImage *image = m_priv->rot_image;
+
+    if ( m_priv->rot_degrees != 0.0 )
+    {
+        gp_affine m;
+        rotate_affine ( &m );
+        gp_image_transform ( image, &m, GP_FILTER_BICUBIC );
+    }
+    m_priv->rot_image = NULL;
+    g_object_unref ( m_priv->image );
+    g_object_unref ( m_priv->rot_proxy );
+    m_priv->rot_proxy = NULL;
+    m_priv->image = image;
+    if ( m_priv->rot_degrees != 0.0 )
+    {
+        rotate_place ( gp_image_get_width ( image ), gp_image_get_height ( image ) );
+    }
+    else
+    {
+        /*not turned, a pending resize stays pending*/
+        rotate_place ( m_priv->rot_w, m_priv->rot_h );
+    }
+}
 
 void
 gp_selection_init ( void )
@@ -251,9 +418,75 @@ gp_selection_set_borders ( gboolean borders )
 {
     g_return_if_fail ( m_priv != NULL );
     m_priv->show_borders = borders;
+    if ( borders && m_priv->rot_image != NULL )
+    {
+        rotate_end ();
+    }
+    /*the borders are hidden while a button is down: draw a resized
+     *image fast until the drag is over*/
+    if ( m_priv->image != NULL )
+    {
+        gp_image_set_draft ( m_priv->image, !borders );
+    }
     update_borders ();
 }
 
+/*
+ * Make mask the shape of the selection, the clipbox becomes its
+ * bounding box. The selection owns mask; outline is the path it was
+ * made from, in canvas coordinates. A NULL mask goes back to a plain
+ * rectangle.
+ */
+void
+gp_selection_set_mask ( gp_mask *mask, const GdkPoint *outline, gint n_points )
+{
+    gint i;
+
+    g_return_if_fail ( m_priv != NULL );
+    destroy_mask ();
+    if ( mask == NULL ) return;
+
+    m_priv->mask        = mask;
+    m_priv->outline     = g_new ( GdkPoint, MAX ( n_points, 1 ) );
+    m_priv->n_outline   = n_points;
+    for ( i = 0; i < n_points; i++ )
+    {
+        m_priv->outline[i].x = outline[i].x - mask->x;
+        m_priv->outline[i].y = outline[i].y - mask->y;
+    }
+    m_priv->sp.x = mask->x;
+    m_priv->sp.y = mask->y;
+    m_priv->ep.x = mask->x + mask->width - 1;
+    m_priv->ep.y = mask->y + mask->height - 1;
+    update_clipbox ();
+}
+
+/*
+ * The mask of a selection not lifted yet, placed where the clipbox
+ * has moved it. NULL for a rectangle, or once the lifted image was
+ * scaled away from the mask size.
+ */
+const gp_mask *
+gp_selection_get_mask ( void )
+{
+    GpSelBox *clipbox;
+
+    g_return_val_if_fail ( m_priv != NULL, NULL );
+    if ( !m_priv->active || m_priv->mask == NULL || m_priv->image != NULL )
+    {
+        return NULL;
+    }
+    clipbox = &m_priv->boxes[SEL_CLIPBOX];
+    if ( ABS ( clipbox->p1.x - clipbox->p0.x ) + 1 != m_priv->mask->width ||
+         ABS ( clipbox->p1.y - clipbox->p0.y ) + 1 != m_priv->mask->height )
+    {
+        return NULL;
+    }
+    m_priv->mask->x = MIN ( clipbox->p0.x, clipbox->p1.x );
+    m_priv->mask->y = MIN ( clipbox->p0.y, clipbox->p1.y );
+    return m_priv->mask;
+}
+
 /* If pixbuf is NULL, a selection is created from the two points
  * 's' is the top left point of a rectangle and 'e' is the bottom
  * right. If pixbuf is not NULL a selection is created from the pixbuf
@@ -274,9 +507,12 @@ gboolean gp_selection_create (GdkPoint *s, GdkPoint *e, GdkPixbuf *pixbuf)
 	}
 	
 	S = *s ; E = *e ;
+	destroy_mask ();
 	
 	if(GDK_IS_PIXBUF(pixbuf)){
-		m_priv->pb_clipboard = gdk_pixbuf_copy(pixbuf);
+		/* No copy: the selection image adopts the pixels, the caller
+		 * just drops its reference */
+		m_priv->pb_clipboard = g_object_ref(pixbuf);
 		w = gdk_pixbuf_get_width(m_priv->pb_clipboard);
 		h = gdk_pixbuf_get_height(m_priv->pb_clipboard);
 		if(ABS(S.x - E.x) != w){
@@ -348,19 +584,8 @@ gp_selection_set_floating ( gboolean floating )
             /* Create selection from a pixbuf */
             if(GDK_IS_PIXBUF(m_priv->pb_clipboard))
             {
-            	GdkPixmap *pm;
-            	gint w, h;
-
-            	w = gdk_pixbuf_get_width(m_priv->pb_clipboard);
-				h = gdk_pixbuf_get_height(m_priv->pb_clipboard);
-            	
-            	pm = gdk_pixmap_new (cv->widget->window, w, h, -1);
-            	gdk_draw_pixbuf (pm, cv->gc_fg, m_priv->pb_clipboard, 0, 0,
-								 0, 0, w, h, GDK_RGB_DITHER_NONE, 0, 0);
-				
-				m_priv->image = gp_image_new_from_pixmap ( pm, &rect, TRUE );
-            	g_object_unref(pm);
-            	g_object_unref(m_priv->pb_clipboard);
+            	/* the image takes the reference, and the pasted alpha */
+            	m_priv->image = gp_image_new_for_pixbuf ( m_priv->pb_clipboard );
             	m_priv->pb_clipboard = NULL;
             }
             /* Create selection */
@@ -368,6 +593,13 @@ gp_selection_set_floating ( gboolean floating )
             {
             	GdkRectangle undo_area = {0, 0, 0, 0};
 
+            	if ( m_priv->mask != NULL )
+            	{
+            	    /*the mask keeps its size, only the clipbox moves it*/
+            	    rect.width  = m_priv->mask->width;
+            	    rect.height = m_priv->mask->height;
+            	}
+
             	/* Save all pixmap so redraw where selection was copied from
             	 * and where sel will be pasted - which we don't know where
             	 * that will be. */
@@ -379,8 +611,24 @@ gp_selection_set_floating ( gboolean floating )
             	printf("   x: %d, y: %d, w: %d, h: %d\n", rect.x, rect.y,
             											  rect.width, rect.height);
 
-            	gdk_draw_rectangle ( cv->pixmap, cv->gc_bg, TRUE, 
-                                     rect.x, rect.y, rect.width, rect.height ); 
+            	if ( m_priv->mask != NULL )
+            	{
+            	    guchar r, g, b;
+
+            	    /*lift only the masked pixels, edges keep their share*/
+            	    gp_image_set_alpha ( m_priv->image, m_priv->mask->data,
+            	                         m_priv->mask->width );
+            	    gp_selection_get_bg_color_rgb ( &r, &g, &b );
+            	    m_priv->mask->x = rect.x;
+            	    m_priv->mask->y = rect.y;
+            	    gp_mask_fill ( m_priv->mask, cv->pixmap, NULL, cv->gc_fg, NULL,
+            	                   rect.x, rect.y, col_rgba ( r, g, b, 0xFF ) );
+            	}
+            	else
+            	{
+            	    gdk_draw_rectangle ( cv->pixmap, cv->gc_bg, TRUE, 
+                                         rect.x, rect.y, rect.width, rect.height ); 
+            	}
             }       
         	/* Add transparancy if necessary */
         	if(cv->transparent)
@@ -389,7 +637,7 @@ gp_selection_set_floating ( gboolean floating )
 
             	m_priv->transparent = cv->transparent;
             	gp_selection_get_bg_color_rgb(&r, &g, &b);
-            	gp_image_make_color_transparent( m_priv->image, r, g, b, 0);
+            	gp_image_set_color_key ( m_priv->image, TRUE, r, g, b );
             	
             }
         }
@@ -418,6 +666,8 @@ gp_selection_get_cursor ( GdkPoint *p )
             return GDK_BOTTOM_SIDE;
         case SEL_BOTTOM_RIGHT:
             return GDK_BOTTOM_RIGHT_CORNER;
+        case SEL_ROTATE:
+            return GDK_EXCHANGE;
         case SEL_CLIPBOX:
             return GDK_FLEUR;
         default:
@@ -432,6 +682,24 @@ gp_selection_start_action ( GdkPoint *p )
     if ( m_priv->active )
     {
         m_priv->action = get_box_in ( p );
+        if ( m_priv->mask != NULL && m_priv->image == NULL &&
+             m_priv->action != SEL_NONE )
+        {
+            /*the mask is only scaled along with the lifted image,
+             *until then the handles just move it*/
+            m_priv->action = SEL_CLIPBOX;
+        }
+        if ( m_priv->action == SEL_ROTATE )
+        {
+            if ( m_priv->image != NULL )
+            {
+                rotate_begin ( p );
+            }
+            else
+            {
+                m_priv->action = SEL_CLIPBOX;
+            }
+        }
         m_priv->p_drag.x = p->x;
         m_priv->p_drag.y = p->y;
 
@@ -477,6 +745,9 @@ gp_selection_do_action ( GdkPoint *p )
         case SEL_MID_RIGHT:
             clipbox->p1.x  += dx;
             break;   
+        case SEL_ROTATE:
+            rotate_preview ( p );
+            break;
     }    
     m_priv->p_drag.x += dx;
     m_priv->p_drag.y += dy;
@@ -548,16 +819,41 @@ static void
 draw_borders ( GdkDrawable *drawing, GdkGC *gc )
 {
     GpSelBoxEnum box;
-    for ( box = SEL_TOP_LEFT; box < SEL_CLIPBOX; box++ )
+    GpSelBox *rtbox = &m_priv->boxes[SEL_ROTATE];
+    for ( box = SEL_TOP_LEFT; box < SEL_ROTATE; box++ )
     {
         draw_sel_box ( drawing, gc, &m_priv->boxes[box] );
     }
+    if ( rtbox->p1.x >= rtbox->p0.x )
+    {
+        GpSelBox *tmbox = &m_priv->boxes[SEL_TOP_MID];
+        gint xm = ( rtbox->p0.x + rtbox->p1.x ) / 2;
+        draw_sel_box ( drawing, gc, rtbox );
+        gdk_draw_line ( drawing, gc, xm, tmbox->p1.y+1, xm, rtbox->p0.y-1 );
+    }
     draw_top_line       ( drawing, gc );
     draw_right_line     ( drawing, gc );
     draw_bottom_line    ( drawing, gc );
     draw_left_line      ( drawing, gc );
 }
 
+/* the path the mask came from, stretched along with the clipbox */
+static void
+draw_outline ( GdkDrawable *drawing, GdkGC *gc, gint x, gint y, gint w, gint h )
+{
+    GdkPoint    *points;
+    gint        i;
+
+    if ( m_priv->n_outline < 2 ) return;
+    points = g_new ( GdkPoint, m_priv->n_outline );
+    for ( i = 0; i < m_priv->n_outline; i++ )
+    {
+        points[i].x = x + m_priv->outline[i].x * w / m_priv->mask->width;
+        points[i].y = y + m_priv->outline[i].y * h / m_priv->mask->height;
+    }
+    gdk_draw_polygon ( drawing, gc, FALSE, points, m_priv->n_outline );
+    g_free ( points );
+}
 
 void
 gp_selection_draw ( GdkDrawable *gdkd )
@@ -584,7 +880,13 @@ gp_selection_draw ( GdkDrawable *gdkd )
         h = ABS(clipbox->p1.y - clipbox->p0.y)+1;
 
 
-        if ( m_priv->floating )
+        if ( m_priv->floating && m_priv->mask != NULL )
+        {
+            /*same tint as the rectangle, through the mask*/
+            gp_mask_fill ( m_priv->mask, cv->drawing, cv->pixmap, cv->gc_fg,
+                           cv->expose, x, y, col_rgba ( 0xB3, 0xE6, 0xFF, 0x4D ) );
+        }
+        else if ( m_priv->floating )
         {
             cairo_t     *cr;
             cr  =   gdk_cairo_create ( cv->drawing );
@@ -594,21 +896,18 @@ gp_selection_draw ( GdkDrawable *gdkd )
             cairo_fill (cr);
             cairo_destroy (cr);
         }
-        else
+        else if ( !m_priv->floating )
         {
             /* Make transparent/opaque */
             if(cv->transparent != m_priv->transparent)
             {
-            	guchar r, g, b, a = 0xFF;
+            	guchar r, g, b;
 
+            	/*the image keeps its own alpha, the mask's for a free
+            	 *selection: only the keyed variant shown changes*/
             	m_priv->transparent = cv->transparent;
             	gp_selection_get_bg_color_rgb ( &r, &g, &b );
-            	if(cv->transparent)
-            	{
-            		a = 0;
-            	}
-            	gp_image_make_color_transparent ( m_priv->image, r, g, b, a );
-            	
+            	gp_image_set_color_key ( m_priv->image, cv->transparent, r, g, b );
             }
             
             /* Had to add this here because the selection
@@ -632,6 +931,10 @@ gp_selection_draw ( GdkDrawable *gdkd )
         }
 
 
+        if ( m_priv->mask != NULL )
+        {
+            draw_outline ( cv->drawing, gc, x, y, w, h );
+        }
         if ( m_priv->show_borders )
         {
             draw_borders ( cv->drawing, gc );
@@ -699,6 +1002,17 @@ void gp_selection_flip(gboolean flip)
 	if(m_priv){
 		if(m_priv->image){
 			gp_image_flip ( m_priv->image, flip );
+			if ( m_priv->mask != NULL )
+			{
+				gint i;
+				gp_mask_flip ( m_priv->mask, flip );
+				for ( i = 0; i < m_priv->n_outline; i++ )
+				{
+					GdkPoint *o = &m_priv->outline[i];
+					if ( flip ) o->x = m_priv->mask->width - 1 - o->x;
+					else        o->y = m_priv->mask->height - 1 - o->y;
+				}
+			}
 		}
 	}
 }
@@ -707,20 +1021,40 @@ void gp_selection_rotate(GdkPixbufRotation angle)
 {
 	if(m_priv){
 		if(m_priv->image){
-			GdkPixbuf *pixbuf;
 			GdkPoint s, e;
 			GpSelBox *clipbox;
 			GpImage *new_image;
 			gp_canvas *cv = cv_get_canvas ();
 
 			gp_image_rotate ( m_priv->image, angle );
-			pixbuf = gp_image_get_pixbuf(m_priv->image);
+			if ( m_priv->mask != NULL )
+			{
+				gint i, w = m_priv->mask->width, h = m_priv->mask->height;
+				gp_mask_rotate ( m_priv->mask, angle );
+				for ( i = 0; i < m_priv->n_outline; i++ )
+				{
+					GdkPoint *o = &m_priv->outline[i];
+					GdkPoint t  = *o;
+					if ( angle == GDK_PIXBUF_ROTATE_COUNTERCLOCKWISE )
+					{
+						o->x = t.y; o->y = w - 1 - t.x;
+					}
+					else if ( angle == GDK_PIXBUF_ROTATE_CLOCKWISE )
+					{
+						o->x = h - 1 - t.y; o->y = t.x;
+					}
+					else if ( angle == GDK_PIXBUF_ROTATE_UPSIDEDOWN )
+					{
+						o->x = w - 1 - t.x; o->y = h - 1 - t.y;
+					}
+				}
+			}
 
 			clipbox = &m_priv->boxes[SEL_CLIPBOX];
 			s.x = MIN(clipbox->p0.x,clipbox->p1.x);
         	s.y = MIN(clipbox->p0.y,clipbox->p1.y);
-        	e.x = gdk_pixbuf_get_width(pixbuf);
-        	e.y = gdk_pixbuf_get_height(pixbuf);
+        	e.x = gp_image_get_width ( m_priv->image );
+        	e.y = gp_image_get_height ( m_priv->image );
         	
         	clipbox->p0.x = s.x;
         	clipbox->p0.y = s.y;
@@ -729,15 +1063,38 @@ void gp_selection_rotate(GdkPixbufRotation angle)
         	clipbox->p1.y = clipbox->p0.y + e.y - 1;
 
         	update_borders ( );
-        	
-        	g_object_unref ( m_priv->image );
-			m_priv->image = gp_image_new_from_pixbuf ( pixbuf, TRUE );
-
-			g_object_unref(pixbuf);
 		}
 	}
 }
 
+/* Resample the lifted image through m, the clipbox keeps its top left
+ * corner and takes the new size. The image alpha already carries the
+ * mask, which would no longer fit: the selection becomes its box. */
+void gp_selection_transform ( const gp_affine *m, gp_filter filter )
+{
+	GpSelBox *clipbox;
+	gp_affine mc = *m;
+	gint x, y;
+
+	g_return_if_fail ( gp_selection_query () );
+
+	clipbox = &m_priv->boxes[SEL_CLIPBOX];
+	/*a resized selection is transformed at its new size*/
+	apply_clip_scale ( &mc, m_priv->image,
+	                   ABS ( clipbox->p1.x - clipbox->p0.x ) + 1,
+	                   ABS ( clipbox->p1.y - clipbox->p0.y ) + 1 );
+	gp_image_transform ( m_priv->image, &mc, filter );
+	destroy_mask ();
+
+	x = MIN ( clipbox->p0.x, clipbox->p1.x );
+	y = MIN ( clipbox->p0.y, clipbox->p1.y );
+	clipbox->p0.x = x;
+	clipbox->p0.y = y;
+	clipbox->p1.x = x + gp_image_get_width ( m_priv->image ) - 1;
+	clipbox->p1.y = y + gp_image_get_height ( m_priv->image ) - 1;
+	update_borders ( );
+}
+
 /* Return a copy of selection's image pixbuf */
 GdkPixbuf *gp_selection_get_pixbuf(void)
 {
@@ -765,6 +1122,7 @@ void gp_selection_draw_and_clear (gboolean draw)
 	pt.y = pt.x;
 	
 	if(!draw){ g_object_unref (m_priv->image) ; m_priv->image = NULL ; }
+	destroy_mask ();
 
 	gp_selection_set_floating ( TRUE );
 	gp_selection_set_active ( FALSE );
@@ -26,6 +26,8 @@
 #define __SELECTION_H__
 
 #include <gtk/gtk.h>
+#include "gp_mask.h"
+#include "gp_transform.h"
 
 void            gp_selection_init                       ( void );
 void            gp_selection_clear                      ( void );
@@ -34,6 +36,10 @@ void            gp_selection_clipbox_set_end_point      ( GdkPoint *p );
 void            gp_selection_set_active                 ( gboolean active );
 void            gp_selection_set_borders                ( gboolean borders );
 void            gp_selection_set_floating               ( gboolean floating );
+void            gp_selection_set_mask                   ( gp_mask *mask,
+                                                          const GdkPoint *outline,
+                                                          gint n_points );
+const gp_mask * gp_selection_get_mask                   ( void );
 GdkCursorType   gp_selection_get_cursor                 ( GdkPoint *p );
 gboolean        gp_selection_start_action               ( GdkPoint *p );
 void            gp_selection_do_action                  ( GdkPoint *p );
@@ -44,6 +50,8 @@ gboolean		gp_selection_create						( GdkPoint *s,
 														  GdkPoint *e,
 														  GdkPixbuf *pixbuf );
 void			gp_selection_draw_and_clear				( gboolean draw );
+void			gp_selection_transform					( const gp_affine *m,
+														  gp_filter filter );
 
 #endif /*__SELECTION_H__*/
 
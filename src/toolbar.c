@@ -112,11 +112,6 @@ on_tool_pencil_realize (GtkToggleToolButton *button, gpointer user_data)
 void
 on_tool_free_select_toggled	(GtkToggleToolButton *button, gpointer user_data)
 {
-    if(gtk_toggle_tool_button_get_active(button))
-    {
-    	quick_message (GTK_WIDGET(button), "Sorry, but the free selection feature has\n"
-				   "not yet been implemented.");
-    }
     tool_toggled ( button, TOOL_FREE_SELECT );
 }
 
@@ -264,6 +259,38 @@ on_line4_toggled (GtkToggleToolButton *button, gpointer user_data)
 	}
 }
 
+/* in the order of liststore_line_cap */
+void
+on_line_cap_changed (GtkComboBox *combo, gpointer user_data)
+{
+	static const GdkCapStyle caps[] =
+	{
+		GDK_CAP_ROUND, GDK_CAP_BUTT, GDK_CAP_PROJECTING
+	};
+	gint i = gtk_combo_box_get_active ( combo );
+
+	if ( i >= 0 && i < G_N_ELEMENTS ( caps ) )
+	{
+		cv_set_line_cap ( caps[i] );
+	}
+}
+
+/* in the order of liststore_line_join */
+void
+on_line_join_changed (GtkComboBox *combo, gpointer user_data)
+{
+	static const GdkJoinStyle joins[] =
+	{
+		GDK_JOIN_ROUND, GDK_JOIN_MITER, GDK_JOIN_BEVEL
+	};
+	gint i = gtk_combo_box_get_active ( combo );
+
+	if ( i >= 0 && i < G_N_ELEMENTS ( joins ) )
+	{
+		cv_set_line_join ( joins[i] );
+	}
+}
+
 void 
 on_rect0_toggled (GtkToggleToolButton *button, gpointer user_data)
 {
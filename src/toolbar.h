@@ -50,7 +50,8 @@ typedef enum {
     TOOL_CLEAR_CANVAS,
     TOOL_INVERT_CANVAS,
     TOOL_FLIP_CANVAS,
-    TOOL_ROTATE_CANVAS
+    TOOL_ROTATE_CANVAS,
+    TOOL_STRETCH_CANVAS
 } gp_tool_enum;
 
 
@@ -124,6 +125,8 @@ void on_line1_toggled					(GtkToggleToolButton *button, gpointer user_data);
 void on_line2_toggled					(GtkToggleToolButton *button, gpointer user_data);
 void on_line3_toggled					(GtkToggleToolButton *button, gpointer user_data);
 void on_line4_toggled					(GtkToggleToolButton *button, gpointer user_data);
+void on_line_cap_changed				(GtkComboBox *combo, gpointer user_data);
+void on_line_join_changed				(GtkComboBox *combo, gpointer user_data);
 /*Rectangle toolbar toggled functions*/
 void on_rect0_toggled					(GtkToggleToolButton *button, gpointer user_data);
 void on_rect1_toggled					(GtkToggleToolButton *button, gpointer user_data);
@@ -34,7 +34,9 @@
 typedef enum
 {
 	UNDO_IMAGE,
-	UNDO_RESIZE
+	UNDO_RESIZE,
+	UNDO_TILES,
+	UNDO_SHAPE
 } undo_type;
 
 typedef struct
@@ -53,6 +55,19 @@ typedef struct
 	gint		height;
 } GpUndoResize;
 
+typedef struct
+{
+	GSList          *images;    /* GpUndoImage, one per canvas tile */
+    gp_tool_enum    tool;
+} GpUndoTiles;
+
+typedef struct
+{
+	gp_span_runs    *cover;     /* every pixel the shape touched      */
+	guchar          *pixels;    /* packed RGB under cover             */
+    gp_tool_enum    tool;
+} GpUndoShape;
+
 typedef struct
 {
 	gpointer	t_data;
@@ -73,6 +88,10 @@ static GpUndo * 	undo_image_new	   	( GpImage *image,
                                           gint x, gint y, 
                                           gp_tool_enum  tool );
 static GpUndo *     undo_resize_new     ( gp_canvas	*cv, gint width, gint height );
+static GpUndo *     undo_tiles_new      ( GSList *images, gp_tool_enum tool );
+static GpUndoImage *undo_tile_new       ( GpImage *image, gint x, gint y );
+static GpUndo *     undo_shape_new      ( gp_span_runs *cover, guchar *pixels,
+                                          gp_tool_enum tool );
 static void			undo_free	        ( GpUndo *undo );
 static GpUndo *     draw_undo           ( GpUndo *undo );
 static GpImage *    get_redo_image      ( GpImage *image, gint x, gint y );
@@ -135,6 +154,47 @@ undo_add (GdkRectangle *rect, GdkBitmap * mask, GdkPixmap *background, gp_tool_e
     free_redo_queue ();
 }
 
+void
+undo_add_tiles ( GdkPixmap *background, const GdkRectangle *tiles,
+                 gint n_tiles, gp_tool_enum tool )
+{
+	GSList		*images = NULL;
+	gp_canvas	*cv	    = cv_get_canvas();
+    gint        i;
+
+    for ( i = n_tiles - 1; i >= 0; i-- )
+    {
+        GdkRectangle    rect  = tiles[i];
+        GpImage         *image;
+        image = gp_image_new_from_pixmap ( background, &rect, TRUE );
+        gp_image_set_diff_pixmap ( image, cv->pixmap, rect.x, rect.y );
+        images = g_slist_prepend ( images, undo_tile_new ( image, rect.x, rect.y ) );
+        g_object_unref (image);
+    }
+	g_queue_push_head	( undo_queue, undo_tiles_new ( images, tool ) );
+    free_redo_queue ();
+}
+
+/*
+ * Outline shapes only keep the pixels they cover, uncompressed, with
+ * the runs they lie in; for a thin band that is far smaller than a
+ * masked image of the bounding box. Call before the shape is drawn.
+ */
+void
+undo_add_shape ( const gp_span_list *fill, const gp_span_list *outline,
+                 gp_tool_enum tool )
+{
+	gp_canvas	    *cv	    = cv_get_canvas();
+    gp_span_runs    *cover  = gp_span_runs_new ( fill, outline );
+
+    if ( cover == NULL ) return;
+	g_queue_push_head	( undo_queue, 
+	                      undo_shape_new ( cover, 
+	                                       gp_span_runs_read_pixels ( cover, cv->pixmap ),
+	                                       tool ) );
+    free_redo_queue ();
+}
+
 void 
 undo_add_resize ( gint width, gint height )
 {
@@ -253,6 +313,43 @@ undo_resize_new	( gp_canvas	*cv, gint width, gint height )
 	return undo;		
 }
 
+static GpUndoImage *
+undo_tile_new ( GpImage *image, gint x, gint y )
+{
+	GpUndoImage	*t_data   =	g_slice_new (GpUndoImage);
+    t_data->im_data =   gp_image_get_data ( image );
+	t_data->x	    =	x;
+	t_data->y		=	y;
+    t_data->tool    =   TOOL_NONE;
+    return t_data;
+}
+
+static GpUndo *
+undo_tiles_new ( GSList *images, gp_tool_enum tool )
+{
+	GpUndo	    *undo	=	g_slice_new (GpUndo);
+    GpUndoTiles *t_data =   g_slice_new (GpUndoTiles);
+    t_data->images  =   images;
+    t_data->tool    =   tool;
+	undo->t_data	=	(gpointer)t_data;
+	undo->type		=	UNDO_TILES;
+    if ( file_is_save() ) undo_saved = undo;
+	return undo;
+}
+
+static GpUndo *
+undo_shape_new ( gp_span_runs *cover, guchar *pixels, gp_tool_enum tool )
+{
+	GpUndo	    *undo	=	g_slice_new (GpUndo);
+    GpUndoShape *t_data =   g_slice_new (GpUndoShape);
+    t_data->cover   =   cover;
+    t_data->pixels  =   pixels;
+    t_data->tool    =   tool;
+	undo->t_data	=	(gpointer)t_data;
+	undo->type		=	UNDO_SHAPE;
+    if ( file_is_save() ) undo_saved = undo;
+	return undo;
+}
 
 static void
 undo_free ( GpUndo *undo )
@@ -276,6 +373,28 @@ undo_free ( GpUndo *undo )
             gp_image_data_free ( t_data->im_data_height );
         }
     	g_slice_free (GpUndoResize, undo->t_data);
+    }
+    else
+    if (undo->type == UNDO_TILES)
+    {
+        GpUndoTiles     *t_data	=	(GpUndoTiles*)undo->t_data;
+        GSList          *l;
+        for ( l = t_data->images; l != NULL; l = l->next )
+        {
+            GpUndoImage *tile = (GpUndoImage*)l->data;
+            gp_image_data_free ( tile->im_data );
+            g_slice_free (GpUndoImage, tile);
+        }
+        g_slist_free ( t_data->images );
+    	g_slice_free (GpUndoTiles, undo->t_data);
+    }
+    else
+    if (undo->type == UNDO_SHAPE)
+    {
+        GpUndoShape     *t_data	=	(GpUndoShape*)undo->t_data;
+        gp_span_runs_free ( t_data->cover );
+        g_free ( t_data->pixels );
+    	g_slice_free (GpUndoShape, undo->t_data);
     }
 	g_slice_free (GpUndo,undo);
 	return;
@@ -339,22 +458,29 @@ draw_undo ( GpUndo *undo )
         GpImage     *image, *redo_image;
         image       =   gp_image_new_from_data ( t_data->im_data );
 
-        /* Need resize canvas on undo rotate.
-         * cv_set_pixbuf() automagically does this for us */
-        if(TOOL_ROTATE_CANVAS == t_data->tool)
+        /* Need resize canvas on undo rotate or stretch.
+         * cv_set_pixbuf() automagically does this for us, so the
+         * redo image is the whole canvas, taken before at its
+         * current size */
+        if(TOOL_ROTATE_CANVAS == t_data->tool ||
+           TOOL_STRETCH_CANVAS == t_data->tool)
         {
         	GdkPixbuf *pb = gp_image_get_pixbuf(image);
+        	redo_image  =   gp_image_new_from_pixmap ( cv->pixmap, NULL, FALSE );
         	cv_set_pixbuf(pb);
         	g_object_unref(pb);
         }
-        if(TOOL_RECT_SELECT == t_data->tool){
-        	if(gp_selection_query () )
-        	{
-        		/* Don't draw selection. Clear the selection frame */
-        		gp_selection_draw_and_clear ( FALSE );
+        else
+        {
+        	if(TOOL_RECT_SELECT == t_data->tool){
+        		if(gp_selection_query () )
+        		{
+        			/* Don't draw selection. Clear the selection frame */
+        			gp_selection_draw_and_clear ( FALSE );
+        		}
         	}
+        	redo_image  =   get_redo_image ( image, t_data->x, t_data->y );
         }
-        redo_image  =   get_redo_image ( image, t_data->x, t_data->y );
         ret_undo	=	undo_image_new (redo_image, t_data->x, t_data->y, t_data->tool );
         g_object_unref (redo_image);
         gp_image_draw ( image, cv->pixmap, cv->gc_fg, t_data->x, t_data->y, -1, -1 );
@@ -383,6 +509,45 @@ draw_undo ( GpUndo *undo )
             g_object_unref ( image );
         }
     }
+    else
+    if (undo->type == UNDO_TILES)
+    {
+        GpUndoTiles     *t_data	=	(GpUndoTiles*)undo->t_data;
+        GSList          *redo   =   NULL;
+        GSList          *l;
+        /* grab every tile before drawing any of them */
+        for ( l = t_data->images; l != NULL; l = l->next )
+        {
+            GpUndoImage *tile = (GpUndoImage*)l->data;
+            GpImage     *image, *redo_image;
+            image       =   gp_image_new_from_data ( tile->im_data );
+            redo_image  =   get_redo_image ( image, tile->x, tile->y );
+            redo        =   g_slist_prepend ( redo, 
+                                undo_tile_new ( redo_image, tile->x, tile->y ) );
+            g_object_unref ( redo_image );
+            g_object_unref ( image );
+        }
+        ret_undo    =   undo_tiles_new ( g_slist_reverse ( redo ), t_data->tool );
+        for ( l = t_data->images; l != NULL; l = l->next )
+        {
+            GpUndoImage *tile = (GpUndoImage*)l->data;
+            GpImage     *image;
+            image   =   gp_image_new_from_data ( tile->im_data );
+            gp_image_draw ( image, cv->pixmap, cv->gc_fg, tile->x, tile->y, -1, -1 );
+            g_object_unref ( image );
+        }
+    }
+    else
+    if (undo->type == UNDO_SHAPE)
+    {
+        GpUndoShape     *t_data	=	(GpUndoShape*)undo->t_data;
+        guchar          *redo;
+        redo    =   gp_span_runs_read_pixels ( t_data->cover, cv->pixmap );
+        gp_span_runs_write_pixels ( t_data->cover, cv->pixmap, cv->gc_fg, t_data->pixels );
+        /* the redo record takes over the runs */
+        ret_undo        =   undo_shape_new ( t_data->cover, redo, t_data->tool );
+        t_data->cover   =   NULL;
+    }
     if ( undo_saved == undo )   file_set_save();
     else                        file_set_unsave();
     
@@ -23,6 +23,7 @@
  */
 #include <gtk/gtk.h>
 #include "toolbar.h"
+#include "gp_shape.h"
 
 
 void undo_create_mask   ( gint        width, 
@@ -35,6 +36,15 @@ void undo_add           ( GdkRectangle  *rect,
                           GdkPixmap     *background,
                           gp_tool_enum  tool );
 
+void undo_add_tiles     ( GdkPixmap             *background,
+                          const GdkRectangle    *tiles,
+                          gint                  n_tiles,
+                          gp_tool_enum          tool );
+
+void undo_add_shape     ( const gp_span_list    *fill,
+                          const gp_span_list    *outline,
+                          gp_tool_enum          tool );
+
 void undo_add_resize    ( gint width, gint height );
 void undo_clear          ( void );
 